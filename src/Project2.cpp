@@ -30,6 +30,10 @@
  
  */
 
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/video/tracking.hpp>
@@ -39,12 +43,27 @@
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
-#include "cinder/Capture.h" //add - needed for capture
 #include "cinder/Log.h" //add - needed to log errors
 #include "Rectangle.hpp"
+#include "Grid.hpp"
+#include "CornerResponse.hpp"
+#include "Lens.hpp"
+#include "LucasKanade.hpp"
+#include "MemoryTags.hpp"
+#include "FluidSimulation.hpp"
+#include "Particles.hpp"
+#include "FramePipeline.hpp"
+#include "FrameSource.hpp"
+#include "Regression.hpp"
+#include "FlowEvaluation.hpp"
+#include "Soak.hpp"
+#include "StreamTest.hpp"
 
-#define SAMPLE_WINDOW_MOD 300 //how often we find new features -- that is 1/300 frames we will find some features
-#define MAX_FEATURES 300 //The maximum number of features to track. Experiment with changing this number
+#define GRID_BENCHMARK 0 //set to 1 to log fixed vs dynamic grid timings at startup
+#define CORNER_BENCHMARK 0 //set to 1 to log fused vs OpenCV corner detection timings at startup
+#define LK_BENCHMARK 0 //set to 1 to log fixed-point vs OpenCV Lucas-Kanade timings at startup
+#define PYRAMID_BENCHMARK 0 //set to 1 to log streaming vs separate-pass LK pyramid timings at startup
+#define PARTICLE_BENCHMARK 0 //set to 1 to log particle update rates at startup
 
 
 using namespace cinder;
@@ -55,130 +74,532 @@ class FeatureTrackingApp : public App {
   public:
     void setup() override;
     void mouseDown( MouseEvent event ) override;
+    void keyDown( KeyEvent event ) override;
     void update() override;
     void draw() override;
+    void cleanup() override;
 protected:
-    CaptureRef                 mCapture; //uses video camera to capture frames of data.
+    void drawMetrics(); //the 'm' overlay
+    void drawParticles();
+    void uploadGray( const cv::Mat &gray, gl::Texture2dRef &texture ); //8-bit gray into a GL_R8 texture, (re)made at gray's size
+    void updateDisplayLuma(); //tells the pipeline whether to hand back luma for the grayscale display
+    
+
+    unique_ptr<FrameSource>    mSource; //camera, movie file or synthetic frames
     gl::TextureRef             mTexture; //the current frame of visual data in OpenGL format.
+    bool                       mShowVideo = true; //'v' toggles -- with it off, file and synthetic sources never make RGB
+    bool                       mGrayDisplay = false; //'g' toggles -- upload just the tracked luma plane instead of an RGB surface
+    int                        mDisplayScale = 1; //'d' cycles 1, 2, 4 -- the grayscale display is uploaded at 1/this size
+    gl::Texture2dRef           mLumaTexture; //single channel (GL_R8), for the grayscale display
+    gl::GlslProgRef            mGrayShader; //draws mLumaTexture's one channel as gray
     
     //for optical flow
-    vector<cv::Point2f>        mPrevFeatures, //the features that we found in the last frame
-                               mFeatures; //the feature that we found in the current frame
-    cv::Mat                    mPrevFrame; //the last frame
-    ci::SurfaceRef             mSurface; //the current frame of visual data in CInder format.
-    vector<uint8_t>            mFeatureStatuses; //a map of previous features to current features
+    unique_ptr<FramePipeline>  mPipeline; //converts and tracks frames on worker threads
+    SourceFrame                mFrame; //the current frame as the source gave it (luma and/or surface)
+    bool                       mNewFrame = false; //mFrame hasn't been uploaded to mTexture yet
+    
+    //features go to the GPU as one buffer (see FeatureVertices.hpp) instead of a draw call per point
+    gl::VboRef                 mFeatureVbo;
+    gl::VaoRef                 mFeatureVao;
+    gl::GlslProgRef            mDotShader; //round point sprites for the feature circles
+    bool                       mNewVertices = false; //the pipeline's latest vertices haven't been copied into mFeatureVbo yet
+    bool                       mInterpolate = true; //'i' toggles -- features glide from the last tracked frame to this one instead of jumping
+    double                     mResultTime = 0; //getElapsedSeconds() when the pipeline's latest result was picked up
+    bool                       mFeatureLod = true; //'l' toggles -- dense frames draw one arrow per tile instead of every feature
+    bool                       mShowField = false; //'w' toggles the flow field (FlowField.hpp), one arrow per cell
+    gl::VboRef                 mFieldVbo; //the field's arrows, packed on the tracking thread
+    GLsizei                    mFieldVertices = 0;
+    
+    //'s' toggles particles carried along by the flow (see Particles.hpp), all drawn with one GL_POINTS call
+    ParticleSystem             mParticles;
+    int                        mParticleCount = PARTICLE_DEFAULT; //--particles n
+    bool                       mShowParticles = false;
+    double                     mParticleMs = 0; //last update, for the overlay
+    double                     mLastUpdate = 0; //getElapsedSeconds() at the last update(), for the particles' time step
+    gl::VboRef                 mParticleVbo; //all the x, then all the y, then all the life -- the arrays as they are
+    gl::VaoRef                 mParticleVao;
+    gl::GlslProgRef            mParticleShader;
+    
+    //'f' toggles a fluid stirred by the motion (see FluidSimulation.hpp), drawn as a texture behind the overlay
+    FluidSimulation            mFluid;
+    int                        mFluidSize = FLUID_SIZE; //--fluid n, cells across
+    bool                       mShowFluid = false;
+    double                     mFluidMs = 0; //last update, for the overlay
+    gl::Texture2dRef           mFluidTexture; //the dye, GL_R8
     
-    void findOpticalFlow(); //finds the optical flow -- the visual or apparent motion of features (or persons or things or what you can detect/measure) through video
+    //draw() runs at display rate, tracking at camera rate -- see FramePipeline.hpp
+    shared_ptr<ClipRecorder>   mRecorder; //only with --dvr
+    shared_ptr<FlightRecorder> mFlight; //only with --flight
+    shared_ptr<TrackSender>    mSender; //only with --send
+    RateMeter                  mRenderRate; //missed = a frame that took more than 1.5x the usual
+    bool                       mShowMetrics = false; //'m' toggles the overlay
+    bool                       mPerfCounters = false; //'p' (or --perf) toggles hardware counters per stage in the overlay (Linux only, PerfCounters.hpp)
+    bool                       mLowLight = false; //'n' (or --low-light) toggles contrast normalization before tracking
+    bool                       mDenoise = false; //'t' (or --denoise) toggles temporal denoise before tracking
+    
+    //for the grid (from Project1)
+    int                        n = 5; //number of squares across and down
 
 };
 
+//headless runs -- no camera needed, see Regression.hpp, FlowEvaluation.hpp, Soak.hpp and StreamTest.hpp.
+//called from prepareSettings, so they run and exit before the app makes a window
+static void runHeadless( const vector<string> &args )
+{
+    for( size_t i=0; i<args.size(); i++ )
+    {
+        if( args[i] == "--check-denoise" )
+            exit( checkDenoise() ? 0 : 1 );
+        if( args[i] == "--check-lod" )
+            exit( checkFeatureLod() ? 0 : 1 );
+        if( args[i] == "--check-handoff" )
+            exit( checkHandOff() ? 0 : 1 );
+    }
+    for( size_t i=0; i+1<args.size(); i++ )
+    {
+        if( args[i] == "--record-golden" )
+            exit( recordGolden( args[i+1], i+2<args.size() && args[i+2] == "opencv" ) ? 0 : 1 );
+        if( args[i] == "--record-budget" )
+            exit( recordBudget( args[i+1], i+2<args.size() && args[i+2] == "opencv" ) ? 0 : 1 );
+        if( args[i] == "--check-golden" && i+2<args.size() )
+            exit( checkGolden( args[i+1], args[i+2] ) ? 0 : 1 );
+        if( args[i] == "--evaluate-flow" )
+            exit( reportFlowScores( evaluateFlow(), args[i+1] ) ? 0 : 1 );
+        if( args[i] == "--soak" )
+            exit( runSoak( atoll( args[i+1].c_str() ), i+2<args.size() ? args[i+2] : "" ) ? 0 : 1 );
+        if( args[i] == "--stream-test" )
+            exit( runStreamTest( args[0], atoi( args[i+1].c_str() ), i+2<args.size() ? atof( args[i+2].c_str() ) : 10 ) ? 0 : 1 );
+        if( args[i] == "--stream-host" && i+3<args.size() )
+            exit( runStreamHost( args[i+1], atoi( args[i+2].c_str() ), atof( args[i+3].c_str() ) ) ? 0 : 1 );
+        if( args[i] == "--aggregate" ) //runs until killed, see TrackStream.hpp
+            exit( runAggregator( atoi( args[i+1].c_str() ), i+2<args.size() ? args[i+2] : "", i+3<args.size() ? args[i+3] : "" ) ? 0 : 1 );
+    }
+}
+
 void FeatureTrackingApp::setup()
 {
-    //set up our camera
-    try {
-        mCapture = Capture::create(640, 480); //first default camera
-        mCapture->start();
+    const vector<string> &args = getCommandLineArgs();
+    
+    //set up our frame source -- --file <movie> or --synthetic, otherwise the camera
+    for( size_t i=0; i<args.size(); i++ )
+    {
+        if( args[i] == "--file" && i+1<args.size() )
+        {
+            unique_ptr<FileSource> file( new FileSource( args[i+1] ) );
+            if( file->isOpen() )
+                mSource = move( file );
+            else
+                CI_LOG_E( "Failed to open " << args[i+1] );
+        }
+        if( args[i] == "--synthetic" )
+            mSource.reset( new SyntheticFrameSource( 640, 480 ) );
     }
-    catch( ci::Exception &exc)
+    
+    if( !mSource )
+    {
+        try {
+            mSource.reset( new CameraSource( 640, 480 ) ); //first default camera
+        }
+        catch( ci::Exception &exc)
+        {
+            CI_LOG_EXCEPTION( "Failed to init capture ", exc ); //oh no!!
+        }
+    }
+    
+    mPipeline.reset( new FramePipeline() ); //the previous frame and features live in the pipeline's tracker now
+    gl::enableVerticalSync(); //with the frame rate uncapped, this is what paces draw()
+    
+#if PERF_COUNTERS_SUPPORTED
+    //--perf reads hardware counters around each tracking stage (Linux only, see PerfCounters.hpp)
+    for( size_t i=0; i<args.size(); i++ )
+        if( args[i] == "--perf" )
+            mPerfCounters = true;
+    mPipeline->setPerfCounters( mPerfCounters );
+#endif
+    
+    //--low-light stretches and equalizes each frame before it is tracked, see Contrast.hpp
+    for( size_t i=0; i<args.size(); i++ )
+        if( args[i] == "--low-light" )
+            mLowLight = true;
+    mPipeline->setContrast( mLowLight );
+    
+    //--denoise averages sensor noise out over frames before they are differenced, see Denoise.hpp
+    for( size_t i=0; i<args.size(); i++ )
+        if( args[i] == "--denoise" )
+            mDenoise = true;
+    mPipeline->setDenoise( mDenoise );
+    
+    //--fused-corners picks features with the one-pass detector in CornerResponse.hpp rather than cv::goodFeaturesToTrack
+    for( size_t i=0; i<args.size(); i++ )
+        if( args[i] == "--fused-corners" )
+            mPipeline->setFusedCorners( true );
+    
+    //--lens <calibration> corrects the flow and what goes out on the stream for lens distortion, see Lens.hpp
+    for( size_t i=0; i+1<args.size(); i++ )
+        if( args[i] == "--lens" )
+        {
+            LensCalibration lens;
+            if( loadLensCalibration( args[i+1], lens ) )
+                mPipeline->setLens( make_shared<LensCalibration>( lens ) );
+            else
+                CI_LOG_E( "Failed to read a lens calibration from " << args[i+1] );
+        }
+    
+    //--dvr <directory> keeps the last few seconds in memory and saves clips around motion, see ClipRecorder.hpp.
+    //--dvr-zone x y w h (fractions of the frame) limits which grid cells trigger it
+    cv::Rect2f zone( 0, 0, 1, 1 );
+    for( size_t i=0; i+4<args.size(); i++ )
+        if( args[i] == "--dvr-zone" )
+            zone = cv::Rect2f( atof( args[i+1].c_str() ), atof( args[i+2].c_str() ), atof( args[i+3].c_str() ), atof( args[i+4].c_str() ) );
+    for( size_t i=0; i+1<args.size(); i++ )
+        if( args[i] == "--dvr" )
+        {
+            mRecorder = make_shared<ClipRecorder>( args[i+1] );
+            mPipeline->setRecorder( mRecorder, zone );
+        }
+    
+    //--flight <directory> keeps the last FLIGHT_SECONDS of timings and thumbnails and dumps them when a
+    //frame takes FLIGHT_LATENCY_FACTOR x the median or frames get dropped, see FlightRecorder.hpp.
+    //--flight-factor x changes the latency trigger (0 turns it off)
+    double flightFactor = FLIGHT_LATENCY_FACTOR;
+    for( size_t i=0; i+1<args.size(); i++ )
+        if( args[i] == "--flight-factor" )
+            flightFactor = atof( args[i+1].c_str() );
+    for( size_t i=0; i+1<args.size(); i++ )
+        if( args[i] == "--flight" )
+        {
+            mFlight = make_shared<FlightRecorder>( args[i+1], flightFactor );
+            mPipeline->setFlightRecorder( mFlight );
+        }
+    
+    //--send host:port camera streams every tracked frame to an aggregator (--aggregate), see TrackStream.hpp.
+    //--send-field as well sends the flow field with it
+    bool sendField = false;
+    for( size_t i=0; i<args.size(); i++ )
+        if( args[i] == "--send-field" )
+            sendField = true;
+    for( size_t i=0; i+2<args.size(); i++ )
+        if( args[i] == "--send" )
+        {
+            mSender = make_shared<TrackSender>( args[i+1], atoi( args[i+2].c_str() ), sendField );
+            mPipeline->setSender( mSender );
+        }
+    
+    //--fluid n sets the fluid's resolution across, up to FLUID_MAX_SIZE
+    for( size_t i=0; i+1<args.size(); i++ )
+        if( args[i] == "--fluid" )
+            mFluidSize = max( 16, min( atoi( args[i+1].c_str() ), FLUID_MAX_SIZE ) );
+    
+    //--particles n sets how many particles 's' shows, up to PARTICLE_MAX
+    for( size_t i=0; i+1<args.size(); i++ )
+        if( args[i] == "--particles" )
+            mParticleCount = max( 1, min( atoi( args[i+1].c_str() ), PARTICLE_MAX ) );
+    
+    //the grayscale display keeps luma in the red channel only and spreads it to gray here
+    mGrayShader = gl::GlslProg::create( gl::GlslProg::Format()
+        .vertex( CI_GLSL( 150,
+            uniform mat4 ciModelViewProjection;
+            in vec4 ciPosition;
+            in vec2 ciTexCoord0;
+            in vec4 ciColor;
+            out vec2 vTexCoord0;
+            out vec4 vColor;
+            void main() {
+                gl_Position = ciModelViewProjection * ciPosition;
+                vTexCoord0 = ciTexCoord0;
+                vColor = ciColor;
+            }
+        ) )
+        .fragment( CI_GLSL( 150,
+            uniform sampler2D uTex0;
+            in vec2 vTexCoord0;
+            in vec4 vColor;
+            out vec4 oColor;
+            void main() {
+                oColor = vec4( vec3( texture( uTex0, vTexCoord0 ).r ), 1.0 ) * vColor;
+            }
+        ) ) );
+    
+    //feature circles are GL_POINTS cut round in the fragment shader; uInner > 0 leaves just a ring
+    mFeatureVbo = gl::Vbo::create( GL_ARRAY_BUFFER, MAX_FEATURES*4*sizeof(cv::Point2f), nullptr, GL_STREAM_DRAW );
+    mFeatureVao = gl::Vao::create();
+    mFieldVbo = gl::Vbo::create( GL_ARRAY_BUFFER, 6*1200*sizeof(cv::Point2f), nullptr, GL_STREAM_DRAW ); //every cell of a 640x480 field
+    //aFrom is the same feature a tracked frame earlier; uBlend says how far from there to draw it
+    mDotShader = gl::GlslProg::create( gl::GlslProg::Format()
+        .vertex( CI_GLSL( 150,
+            uniform mat4 ciModelViewProjection;
+            uniform float uPointSize;
+            uniform float uBlend;
+            in vec4 ciPosition;
+            in vec2 aFrom;
+            void main() {
+                gl_Position = ciModelViewProjection * vec4( mix( aFrom, ciPosition.xy, uBlend ), 0.0, 1.0 );
+                gl_PointSize = uPointSize;
+            }
+        ) )
+        .fragment( CI_GLSL( 150,
+            uniform vec4 uColor;
+            uniform float uInner;
+            out vec4 oColor;
+            void main() {
+                float r = length( gl_PointCoord * 2.0 - 1.0 );
+                if( r > 1.0 || r < uInner )
+                    discard;
+                oColor = uColor;
+            }
+        ) ) );
+    
+    //particles are soft round point sprites, fading out over their last second
+    mParticleVao = gl::Vao::create();
+    mParticleShader = gl::GlslProg::create( gl::GlslProg::Format()
+        .vertex( CI_GLSL( 150,
+            uniform mat4 ciModelViewProjection;
+            uniform float uPointSize;
+            in float aX;
+            in float aY;
+            in float aLife;
+            out float vAlpha;
+            void main() {
+                gl_Position = ciModelViewProjection * vec4( aX, aY, 0.0, 1.0 );
+                gl_PointSize = uPointSize;
+                vAlpha = clamp( aLife, 0.0, 1.0 );
+            }
+        ) )
+        .fragment( CI_GLSL( 150,
+            uniform vec4 uColor;
+            in float vAlpha;
+            out vec4 oColor;
+            void main() {
+                float r = length( gl_PointCoord * 2.0 - 1.0 );
+                if( r > 1.0 )
+                    discard;
+                oColor = vec4( uColor.rgb, uColor.a * vAlpha * ( 1.0 - r ) );
+            }
+        ) ) );
+    
+#if GRID_BENCHMARK
+    for( int size : { 5, 9, 24 } )
     {
-        CI_LOG_EXCEPTION( "Failed to init capture ", exc ); //oh no!!
+        benchmarkGrid( size, 640, 480, 500 );
+        benchmarkGrid( size, 1920, 1080, 100 );
     }
+#endif
     
-    mPrevFrame.data = NULL; //initialize our previous frame to null since in the beginning... there no previous frames!
+#if CORNER_BENCHMARK
+    benchmarkCorners( 640, 480, 50 );
+    benchmarkCorners( 1920, 1080, 20 );
+    benchmarkCorners( 3840, 2160, 5 );
+#endif
+    
+#if LK_BENCHMARK
+    benchmarkLK( 640, 480 );
+    benchmarkLK( 1920, 1080 );
+#endif
+    
+#if PYRAMID_BENCHMARK
+    benchmarkPyramid( 640, 480, 3, 50 );
+    benchmarkPyramid( 1920, 1080, 3, 20 );
+    benchmarkPyramid( 3840, 2160, 3, 5 );
+#endif
+    
+#if PARTICLE_BENCHMARK
+    benchmarkParticles( 100000, 100 );
+    benchmarkParticles( PARTICLE_MAX, 50 );
+#endif
+}
+
+void FeatureTrackingApp::cleanup()
+{
+    mPipeline->stop(); //cancel frames still in flight before the app goes away
+    if( mRecorder )
+        mRecorder->stop(); //finishes writing a clip in progress
+    if( mFlight )
+        mFlight->stop();
 }
 
 //maybe you will add mouse functionality!
 void FeatureTrackingApp::mouseDown( MouseEvent event )
 {
-    //CODE FROM PROJECT1
-//    if(event.getChar() == 'a')  //changes square number to 5  to form a 5x5 grid when key a is pressed
-//       {
-//           n=5;
-//       }
-//
-//       if(event.getChar() == 'b')  //changes square number to 9  to form a 9x9 grid when key b is pressed
-//
-//          {
-//              n=9;
-//          }
-//
-//       if(event.getChar() == 'c')  //changes square number to 24  to form a 24x24 grid when key c is pressed
-//
-//             {
-//                 n=24;
-//             }
 }
 
-void FeatureTrackingApp::update()
+void FeatureTrackingApp::keyDown( KeyEvent event )
 {
-    //update the current frame from camera
-    if(mCapture && mCapture->checkNewFrame()) //is there a new frame???? (& did camera get created?)
+    int oldN = n;
+    
+    if(event.getChar() == 'a')  //changes square number to 5  to form a 5x5 grid when key a is pressed
     {
-        mSurface = mCapture->getSurface(); //get the current frame and put in the Cinder datatype.
-        
-        //translate the cinder frame (Surface) into the OpenGL one (Texture)
-        if(! mTexture)
-            mTexture = gl::Texture::create(*mSurface);
-        else
-            mTexture->update(*mSurface);
+        n=5;
     }
     
-    //just what it says -- the meat of the program
-    findOpticalFlow();
-
+    if(event.getChar() == 'b')  //changes square number to 9  to form a 9x9 grid when key b is pressed
+    {
+        n=9;
+    }
+    
+    if(event.getChar() == 'c')  //changes square number to 24  to form a 24x24 grid when key c is pressed
+    {
+        n=24;
+    }
+    
+    if(event.getChar() == 'v')  //shows or hides the video behind the features
+    {
+        mShowVideo = !mShowVideo;
+        mNewFrame = mShowVideo;
+        updateDisplayLuma();
+    }
+    
+    if(event.getChar() == 'g')  //grayscale display: uploads the luma plane only
+    {
+        mGrayDisplay = !mGrayDisplay;
+        mNewFrame = mShowVideo && !mGrayDisplay;
+        updateDisplayLuma();
+    }
+    
+    if(event.getChar() == 'd')  //grayscale display resolution: full, half, quarter
+    {
+        mDisplayScale = mDisplayScale >= 4 ? 1 : mDisplayScale*2;
+        updateDisplayLuma();
+    }
+    
+    if(event.getChar() == 'm')  //shows or hides the rates overlay
+    {
+        mShowMetrics = !mShowMetrics;
+    }
+    
+#if PERF_COUNTERS_SUPPORTED
+    if(event.getChar() == 'p')  //hardware counters per stage, shown in the 'm' overlay
+    {
+        mPerfCounters = !mPerfCounters;
+        mPipeline->setPerfCounters( mPerfCounters );
+    }
+#endif
+    
+    if(event.getChar() == 'n')  //low light: contrast stretch and CLAHE before tracking
+    {
+        mLowLight = !mLowLight;
+        mPipeline->setContrast( mLowLight );
+    }
+    
+    if(event.getChar() == 't')  //temporal denoise: fewer cells fired by sensor noise
+    {
+        mDenoise = !mDenoise;
+        mPipeline->setDenoise( mDenoise );
+    }
+    
+    if(event.getChar() == 'l')  //dense frames: one arrow per tile, or every feature anyway
+    {
+        mFeatureLod = !mFeatureLod;
+    }
+    
+    if(event.getChar() == 'i')  //features glide between tracked frames, or jump to each one
+    {
+        mInterpolate = !mInterpolate;
+    }
+    
+    if(event.getChar() == 'w')  //the flow field as arrows
+    {
+        mShowField = !mShowField;
+    }
+    
+    if(event.getChar() == 'f')  //fluid stirred by the motion
+    {
+        mShowFluid = !mShowFluid;
+    }
+    
+    if(event.getChar() == 's')  //particles carried along by the motion
+    {
+        mShowParticles = !mShowParticles;
+    }
+    
+    if(n != oldN)
+        mPipeline->setGridSize(n);
 }
 
-void FeatureTrackingApp::findOpticalFlow()
+void FeatureTrackingApp::update()
 {
-    if(!mSurface) return; //don't go through with the rest if we can't get a camera frame!
-    
-    //convert gl::Texturer to the cv::Mat(rix) --> Channel() -- converts, makes sure it is 8-bit
-    cv::Mat curFrame = toOcv(Channel(*mSurface));
-    
+    //hand new frames to the pipeline -- this never waits on tracking
+    if(mSource && mSource->next(mFrame)) //is there a new frame???? (& did the source get created?)
+    {
+        mPipeline->submit( mFrame, getElapsedFrames() ); //finds the optical flow -- the visual or apparent motion of features through video
+        mNewFrame = true;
+    }
     
-    //if we have a previous sample, then we can actually find the optical flow.
-    if( mPrevFrame.data ) {
-        
-        // pick new features once every SAMPLE_WINDOW_MOD frames, or the first frame
-        
-        //note: this means we are abandoning all our previous features every SAMPLE_WINDOW_MOD frames that we
-        //had updated and kept track of via our optical flow operations.
-        
-        if( mFeatures.empty() || getElapsedFrames() % SAMPLE_WINDOW_MOD == 0 ){
-            
-            /*
-             parameters for the  call to cv::goodFeaturesToTrack:
-             curFrame - img,
-             mFeatures - output of corners,
-             MAX_FEATURES - the max # of features,
-             0.005 - quality level (percentage of best found),
-             3.0 - min distance
-             
-             note: its terrible to use these hard-coded values for the last two parameters. perhaps you will fix your projects.
-             
-             note: remember we're finding corners/edges using these functions
-             */
-            cv::goodFeaturesToTrack( curFrame, mFeatures, MAX_FEATURES, 0.005, 3.0 );
+    //translate the cinder frame (Surface) into the OpenGL one (Texture) -- only if we're showing it in colour
+    if(mShowVideo && !mGrayDisplay && mNewFrame)
+    {
+        SurfaceRef surface = mSource->getSurface(); //file and synthetic sources only make RGB here
+        if(surface)
+        {
+            if(! mTexture)
+                mTexture = gl::Texture::create(*surface);
+            else
+                mTexture->update(*surface);
         }
+        mNewFrame = false;
+    }
+    
+    //pick up whatever the pipeline has finished since last time -- never waits, draw() uses the previous one if nothing is new
+    if( mPipeline->poll() )
+    {
+        mNewVertices = true;
+        mResultTime = getElapsedSeconds();
         
-        vector<float> errors; //there could be errors whilst calculating optical flow
-        
-        mPrevFeatures = mFeatures; //save our current features as previous one
-        
-        //This operation will now update our mFeatures & mPrevFeatures based on calculated optical flow patterns between frames UNTIL we choose all new features again in the above operation every SAMPLE_WINDOW_MOD frames. We choose all new features every couple frames, because we lose features as they move in and out frames and become occluded, etc.
-        if( ! mFeatures.empty() )
-            cv::calcOpticalFlowPyrLK( mPrevFrame, curFrame, mPrevFeatures, mFeatures, mFeatureStatuses, errors );
-        
+        //grayscale display: the luma the tracker just used, one byte a pixel (and 1/4 or 1/16 of that at 'd' 2 or 4)
+        const cv::Mat &luma = mPipeline->getResult().display;
+        if( mShowVideo && mGrayDisplay && ! luma.empty() )
+            uploadGray( luma, mLumaTexture );
     }
     
-    //set previous frame
-    mPrevFrame = curFrame;
+    //particles move every update, between tracked frames too -- the field is per tracked frame, the track rate makes it per second
+    double now = getElapsedSeconds();
+    float dt = (float) min( now - mLastUpdate, 0.1 ); //a stall shouldn't fling them across the frame
+    mLastUpdate = now;
+    const TrackResult &tracked = mPipeline->getResult();
+    if( mShowParticles && tracked.frameSize.area() > 0 )
+    {
+        if( mParticles.getCount() != mParticleCount || mParticles.getBounds() != tracked.frameSize )
+            mParticles.reset( mParticleCount, tracked.frameSize );
+        auto start = chrono::steady_clock::now();
+        mParticles.update( tracked.flow, (float) mPipeline->getTrackRate().getRate(), dt );
+        mParticleMs = chrono::duration<double, milli>( chrono::steady_clock::now()-start ).count();
+    }
     
+    //the fluid steps every update too; its grid keeps the frame's aspect
+    if( mShowFluid && tracked.frameSize.area() > 0 )
+    {
+        int rows = max( 1, mFluidSize*tracked.frameSize.height/tracked.frameSize.width );
+        if( mFluid.getCols() != mFluidSize || mFluid.getRows() != rows )
+            mFluid.reset( mFluidSize, rows );
+        auto start = chrono::steady_clock::now();
+        mFluid.addMotion( tracked.flow, tracked.frameSize, (float) mPipeline->getTrackRate().getRate(), dt );
+        mFluid.step( dt );
+        mFluidMs = chrono::duration<double, milli>( chrono::steady_clock::now()-start ).count();
+        uploadGray( mFluid.getDensityImage(), mFluidTexture );
+    }
+}
+
+void FeatureTrackingApp::uploadGray( const cv::Mat &gray, gl::Texture2dRef &texture )
+{
+    if( ! texture || texture->getWidth() != gray.cols || texture->getHeight() != gray.rows )
+        texture = gl::Texture2d::create( gray.cols, gray.rows, gl::Texture2d::Format().internalFormat( GL_R8 ) );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ); //rows are packed bytes, not 4-byte aligned
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, (GLint) gray.step );
+    texture->update( gray.data, GL_RED, GL_UNSIGNED_BYTE, 0, gray.cols, gray.rows );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+}
+
+void FeatureTrackingApp::updateDisplayLuma()
+{
+    mPipeline->setDisplayLuma( mShowVideo && mGrayDisplay ? mDisplayScale : 0 );
 }
 
 
 void FeatureTrackingApp::draw()
 {
+    mRenderRate.tick();
+    const TrackResult &tracked = mPipeline->getResult(); //the last frame the pipeline finished -- features, statuses and grid sums
+    
     gl::clear( Color( 0, 0, 0 ) );
     
     //color the camera frame normally
@@ -186,76 +607,295 @@ void FeatureTrackingApp::draw()
 
     
     //draw the camera frame
-    if( mTexture )
+    if( mShowVideo && mGrayDisplay && mLumaTexture && tracked.frameSize.area() > 0 )
+    {
+        //stretched back up to the frame size, whatever size it was uploaded at
+        gl::ScopedGlslProg shader( mGrayShader );
+        gl::ScopedTextureBind texture( mLumaTexture, 0 );
+        mGrayShader->uniform( "uTex0", 0 );
+        gl::drawSolidRect( Rectf( 0, 0, tracked.frameSize.width, tracked.frameSize.height ), vec2( 0, 0 ), vec2( 1, 1 ) );
+    }
+    else if( mTexture && mShowVideo && ! mGrayDisplay )
     {
         gl::draw( mTexture );
     }
     
-    // draw all the old points @ 0.5 alpha (transparency) as a circle outline
-    gl::color( 1, 0, 0, 0.55 );
-    for( int i=0; i<mPrevFeatures.size(); i++ )
-        gl::drawStrokedCircle( fromOcv( mPrevFeatures[i] ), 3 );
+    //the fluid's dye over the video, tinted, behind everything else
+    if( mShowFluid && mFluidTexture && tracked.frameSize.area() > 0 )
+    {
+        gl::ScopedGlslProg shader( mGrayShader );
+        gl::ScopedTextureBind texture( mFluidTexture, 0 );
+        gl::ScopedBlendAdditive blend;
+        gl::ScopedColor color( 0.2f, 0.5f, 1.0f, 1.0f );
+        mGrayShader->uniform( "uTex0", 0 );
+        gl::drawSolidRect( Rectf( 0, 0, tracked.frameSize.width, tracked.frameSize.height ), vec2( 0, 0 ), vec2( 1, 1 ) );
+    }
+    
+    if( mShowParticles && mParticles.getCount() > 0 )
+        drawParticles();
+    
+    //the same for the flow field's arrows, when they are shown
+    const vector<cv::Point2f> &fieldArrows = tracked.flow.arrows;
+    if( mNewVertices && mShowField )
+    {
+        size_t bytes = fieldArrows.size()*sizeof(cv::Point2f);
+        if( bytes > 0 )
+        {
+            if( mFieldVbo->getSize() < bytes )
+                mFieldVbo->bufferData( bytes, nullptr, GL_STREAM_DRAW );
+            memcpy( mFieldVbo->mapReplace(), fieldArrows.data(), bytes );
+            mFieldVbo->unmap();
+        }
+        mFieldVertices = (GLsizei) fieldArrows.size();
+    }
+    
+    //copy this frame's features into the vertex buffer -- they were already packed on the tracking thread
+    const FeatureVertices &packed = tracked.vertices;
+    if( mNewVertices && packed.features > 0 )
+    {
+        if( mFeatureVbo->getSize() < packed.bytes() )
+            mFeatureVbo->bufferData( packed.bytes(), nullptr, GL_STREAM_DRAW );
+        memcpy( mFeatureVbo->mapReplace(), packed.vertices.data(), packed.bytes() );
+        mFeatureVbo->unmap();
+        mNewVertices = false;
+    }
+    
+    {
+        //draws count vertices from the buffer, starting at vertex first, every stride bytes
+        gl::ScopedVao vao( mFeatureVao );
+        gl::ScopedBuffer buffer( mFeatureVbo );
+        auto drawVertices = [&]( const gl::GlslProgRef &shader, GLenum mode, size_t first, GLsizei stride, GLsizei count ){
+            gl::ScopedGlslProg scopedShader( shader );
+            GLint position = shader->getAttribSemanticLocation( geom::Attrib::POSITION );
+            gl::enableVertexAttribArray( position );
+            gl::vertexAttribPointer( position, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)( first*sizeof(cv::Point2f) ) );
+            gl::setDefaultShaderVars();
+            gl::drawArrays( mode, 0, count );
+        };
+        
+        //the circles: each one drawn between the feature's previous position (the odd vertices) and
+        //vertex first, blend of the way along
+        auto drawDots = [&]( size_t first, float blend ){
+            GLint from = mDotShader->getAttribLocation( "aFrom" );
+            gl::ScopedGlslProg scopedShader( mDotShader );
+            gl::enableVertexAttribArray( from );
+            gl::vertexAttribPointer( from, 2, GL_FLOAT, GL_FALSE, 2*sizeof(cv::Point2f), (const GLvoid*)( 1*sizeof(cv::Point2f) ) );
+            mDotShader->uniform( "uBlend", blend );
+            drawVertices( mDotShader, GL_POINTS, first, 2*sizeof(cv::Point2f), packed.features );
+            gl::disableVertexAttribArray( from );
+        };
+        
+        //draw() runs several times per tracked frame, so rather than jump to the newest positions and sit
+        //there, the new points move from the previous tracked frame's positions to this one's over one
+        //tracking interval -- always between the last two tracked frames, a tracked frame behind
+        double trackRate = mPipeline->getTrackRate().getRate();
+        float blend = mInterpolate && trackRate > 0 ? (float) min( 1.0, ( getElapsedSeconds() - mResultTime )*trackRate ) : 1.0f;
+    
+        //too many features to see individually -- draw the per-tile arrows instead, at most LOD_MAX_ARROWS of them
+        bool lod = mFeatureLod && packed.arrows > 0;
+        if( lod )
+        {
+            gl::color( 0, 1, 0, 0.75f );
+            drawVertices( gl::getStockShader( gl::ShaderDef().color() ), GL_LINES, packed.arrowOffset(), sizeof(cv::Point2f), 6*packed.arrows );
+        }
+        
+        if( ! lod && packed.features > 0 )
+        {
+            gl::ScopedState pointSize( GL_PROGRAM_POINT_SIZE, true );
+            mDotShader->uniform( "uPointSize", 6.0f*getWindowContentScale() ); //radius 3, like the old circles
+        
+            // draw all the old points @ 0.5 alpha (transparency) as a circle outline
+            mDotShader->uniform( "uColor", ColorA( 1, 0, 0, 0.55f ) );
+            mDotShader->uniform( "uInner", 0.6f );
+            drawDots( 1, 1.0f );
+        
+            // draw all the new points @ 0.5 alpha (transparency)
+            mDotShader->uniform( "uColor", ColorA( 0, 0, 1, 0.5f ) );
+            mDotShader->uniform( "uInner", 0.0f );
+            drawDots( 0, blend );
+        }
+    
+        //the regular field filled in from the features, drawn from its own buffer
+        if( mShowField && mFieldVertices > 0 )
+        {
+            gl::ScopedBuffer fieldBuffer( mFieldVbo );
+            gl::color( 1, 0.8f, 0, 0.6f );
+            drawVertices( gl::getStockShader( gl::ShaderDef().color() ), GL_LINES, 0, sizeof(cv::Point2f), mFieldVertices );
+        }
+    
+        //draw lines from the previous features to the new features
+        //you will only see these lines if the current features are relatively far from the previous
+        if( ! lod && packed.lines > 0 )
+        {
+            gl::color( 0, 1, 0, 0.5f );
+            drawVertices( gl::getStockShader( gl::ShaderDef().color() ), GL_LINES, packed.lineOffset(), sizeof(cv::Point2f), 2*packed.lines );
+        }
+    }
+    
+    
+    //draw the squares where there was enough movement (from Project1)
+    int gridN = tracked.n; //the grid size the pipeline actually used for these sums
+    if( tracked.frameSize.area() > 0 && tracked.cellSums.size() == gridN*gridN )
+    {
+        int cols = tracked.frameSize.width;
+        int rows = tracked.frameSize.height;
+        float scaleX = (float) getWindowWidth() / cols; //frame to window
+        float scaleY = (float) getWindowHeight() / rows;
+        
+        gl::color( 0, 1, 0, .5 ); //sets rectangle color to green
+        for(int j=0;j<gridN;j++){
+            for(int i=0;i<gridN;i++){
+                if(tracked.cellSums[j*gridN+i]>CELL_THRESHOLD){  //if there are multiple white pixels, display rectangle
+                    int x1=i*cols/gridN*scaleX;
+                    int y1=j*rows/gridN*scaleY;
+                    int x2=(i+1)*cols/gridN*scaleX;
+                    int y2=(j+1)*rows/gridN*scaleY;
+                    Rectangle rr(x1,y1,x2,y2);  //initializes rectangle
+                    rr.display();   //displays rectangle
+                }
+            }
+        }
+    }
+    
+    if( mShowMetrics )
+        drawMetrics();
+}
+
+void FeatureTrackingApp::drawParticles()
+{
+    //the x, y and life arrays go into the buffer as three ranges, one copy each, no interleaving
+    size_t count = mParticles.getCount(), bytes = 3*count*sizeof(float);
+    if( ! mParticleVbo || mParticleVbo->getSize() < bytes )
+        mParticleVbo = gl::Vbo::create( GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW );
+    float *mapped = (float*) mParticleVbo->mapReplace();
+    memcpy( mapped, mParticles.getX(), count*sizeof(float) );
+    memcpy( mapped+count, mParticles.getY(), count*sizeof(float) );
+    memcpy( mapped+2*count, mParticles.getLife(), count*sizeof(float) );
+    mParticleVbo->unmap();
+    
+    gl::ScopedVao vao( mParticleVao );
+    gl::ScopedBuffer buffer( mParticleVbo );
+    gl::ScopedGlslProg shader( mParticleShader );
+    gl::ScopedBlendAdditive blend;
+    gl::ScopedState pointSize( GL_PROGRAM_POINT_SIZE, true );
+    const char *attribs[] = { "aX", "aY", "aLife" };
+    for( int k=0; k<3; k++ )
+    {
+        GLint location = mParticleShader->getAttribLocation( attribs[k] );
+        gl::enableVertexAttribArray( location );
+        gl::vertexAttribPointer( location, 1, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)( k*count*sizeof(float) ) );
+    }
+    mParticleShader->uniform( "uPointSize", 3.0f*getWindowContentScale() );
+    mParticleShader->uniform( "uColor", ColorA( 0.3f, 0.6f, 1, 0.6f ) );
+    gl::setDefaultShaderVars();
+    gl::drawArrays( GL_POINTS, 0, (GLsizei) count );
+}
 
+void FeatureTrackingApp::drawMetrics()
+{
+    vec2 position( 10, 10 );
+    auto line = [&]( const stringstream &text ){
+        gl::drawString( text.str(), position, Color( 1, 1, 1 ) );
+        position.y += 16;
+    };
+    
+    const RateMeter &source = mPipeline->getSourceRate(), &track = mPipeline->getTrackRate();
+    stringstream render, tracking;
+    render << fixed << setprecision( 1 ) << "render " << mRenderRate.getRate() << " fps, missed " << mRenderRate.getMissed();
+    tracking << fixed << setprecision( 1 ) << "camera " << source.getRate() << " fps, tracking " << track.getRate() << " fps, missed "
+             << track.getMissed() << ", dropped " << mPipeline->getDropped() << ", in flight " << mPipeline->getInFlight();
+    line( render );
+    line( tracking );
     
-    // draw all the new points @ 0.5 alpha (transparency)
-    gl::color( 0, 0, 1, 0.5f );
-    for( int i=0; i<mFeatures.size(); i++ )
-        gl::drawSolidCircle( fromOcv( mFeatures[i] ), 3 );
-    
-    //draw lines from the previous features to the new features
-    //you will only see these lines if the current features are relatively far from the previous
-    gl::color( 0, 1, 0, 0.5f );
-    gl::begin( GL_LINES );
-    for( size_t idx = 0; idx < mFeatures.size(); ++idx ) {
-        if( mFeatureStatuses[idx] ) {
-            gl::vertex( fromOcv( mFeatures[idx] ) );
-            gl::vertex( fromOcv( mPrevFeatures[idx] ) );
+    //where the last tracked frame's time went, and with 'p' (Linux) what the cpu was doing meanwhile
+    const StageTimes &stages = mPipeline->getResult().stages;
+    stringstream times;
+    times << fixed << setprecision( 2 ) << "detect " << stages.detectMs << " ms, flow " << stages.flowMs << " ms, grid " << stages.gridMs
+          << " ms, field " << stages.fieldMs << " ms";
+    if( mDenoise )
+        times << ", denoise " << stages.denoiseMs << " ms (" << denoisePath() << ")";
+    if( mLowLight )
+        times << ", contrast " << stages.contrastMs << " ms (" << stages.contrastReused << " tiles kept)";
+    line( times );
+#if PERF_COUNTERS_SUPPORTED
+    if( mPerfCounters )
+    {
+        if( ! stages.flowPerf.valid() )
+        {
+            stringstream status;
+            status << "counters " << perfCountersStatus();
+            line( status );
         }
+        else
+        {
+            const char *names[] = { "detect", "flow", "grid" };
+            const PerfSample *samples[] = { &stages.detectPerf, &stages.flowPerf, &stages.gridPerf };
+            for( int k=0; k<3; k++ )
+            {
+                if( ! samples[k]->valid() )
+                    continue; //detect only runs every so often
+                stringstream counters;
+                counters << fixed << setprecision( 2 ) << names[k] << ": " << samples[k]->cycles/1e6 << "M cycles, IPC " << samples[k]->ipc()
+                         << ", " << samples[k]->cacheMisses/1e3 << "k cache misses, " << samples[k]->branchMisses/1e3 << "k branch misses";
+                line( counters );
+            }
+        }
+    }
+#endif
+    
+    //where memory goes, per subsystem. a tag that keeps allocating in a steady state isn't reusing its buffers
+    for( int tag=0; tag<MEMORY_TAGS; tag++ )
+    {
+        MemoryStats stats = getMemoryStats( (MemoryTag)tag );
+        stringstream memory;
+        memory << fixed << setprecision( 1 ) << memoryTagName( (MemoryTag)tag ) << " " << stats.liveBytes/1048576.0 << " MB, peak "
+               << stats.peakBytes/1048576.0 << " MB, " << stats.allocationRate << " allocs/s";
+        line( memory );
+    }
+    
+    if( mShowFluid )
+    {
+        stringstream fluid;
+        fluid << fixed << setprecision( 2 ) << "fluid " << mFluid.getCols() << "x" << mFluid.getRows() << ", update " << mFluidMs << " ms";
+        line( fluid );
+    }
+    
+    if( mShowParticles )
+    {
+        stringstream particles;
+        particles << fixed << setprecision( 2 ) << "particles " << mParticles.getCount() << " (" << particlesPath() << "), update "
+                  << mParticleMs << " ms";
+        line( particles );
+    }
+    
+    if( mRecorder )
+    {
+        stringstream dvr;
+        dvr << fixed << setprecision( 1 ) << "dvr " << mRecorder->getRingBytes()/1048576.0 << " MB, " << mRecorder->getRingFrames()
+            << " frames, clips " << mRecorder->getClips() << ( mRecorder->isRecording() ? " (recording)" : "" ) << ", written "
+            << mRecorder->getWritten() << ", dropped " << mRecorder->getDropped();
+        line( dvr );
+    }
+    
+    if( mFlight )
+    {
+        stringstream flight;
+        flight << fixed << setprecision( 1 ) << "flight recorder " << mFlight->getFrames() << " frames, median latency "
+               << mFlight->getMedianMs() << " ms, dumps " << mFlight->getDumps();
+        line( flight );
+    }
+    
+    if( mSender )
+    {
+        stringstream sent;
+        sent << fixed << setprecision( 1 ) << "streaming camera " << mSender->getCamera() << ": " << mSender->getFrames() << " frames, "
+             << mSender->getBytes()/1048576.0 << " MB, dropped " << mSender->getDropped() << " packets";
+        line( sent );
     }
-    gl::end();
-    
-    
-    //CODE FROM PROJECT 1 TO BE INTEGRATED
-//    int width=getWindowWidth()/n;   //divides width by n
-//       int height=getWindowHeight()/n; //divides height by n
-//      cv::Mat pixel = mFrameDifference;    //set pixel matrix to frame difference matrix
-//
-//
-//
-//       //if the frame difference isn't null, draw it.
-//       if( mFrameDifference.data )
-//       {
-//           gl::draw( gl::Texture::create(fromOcv(mFrameDifference) ) );
-//
-//           for(int i=0;i<=n;i++){  //makes nxn grid of rectangles
-//               for(int j=0;j<=n;j++){
-//
-//                   int x1=i*width;
-//                   int y1=j*height;
-//                   int x2=width*(i+1);
-//                   int y2=height*(j+1);
-//                   Rectangle rr(x1,y1,x2,y2);  //initializes rectangle
-//
-//                   int sum=0;  //initializes sum and sets it equal to 0
-//
-//                   for(int o=x1; o<x2; o++){       //gets square boundaries
-//                       for(int q=y1; q<y2;q++){
-//
-//                          sum=sum+pixel.at<uint8_t>(q,o);  //adds together all the pixel values
-//                      }
-//
-//
-//                   }
-//                  if(sum>3500){  //if there are multiple white pixels, change color and display rectangle
-//                      gl::color( 0, 1,0, .5 ); //sets rectangle color to green
-//                       rr.display();   //displays rectangle
-//
-//                                                                    }
-//               }}
-//
-//           }
-//
-//       }
 }
 
-CINDER_APP( FeatureTrackingApp, RendererGl )
+//no frame rate cap: draw() runs at the display's refresh (vsync), independent of the camera
+CINDER_APP( FeatureTrackingApp, RendererGl, []( App::Settings *settings ) {
+    runHeadless( settings->getCommandLineArgs() );
+    settings->disableFrameRate();
+} )
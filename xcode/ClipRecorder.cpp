@@ -0,0 +1,173 @@
+//
+//  ClipRecorder.cpp
+//  Project2
+//
+
+#include "ClipRecorder.hpp"
+
+#include <fstream>
+#include <sys/stat.h>
+#include <opencv2/imgcodecs.hpp>
+
+#include "cinder/Log.h"
+
+using namespace std;
+
+ClipRecorder::ClipRecorder(const string &directory, size_t budgetBytes, double preSeconds, double postSeconds)
+: mDirectory(directory), mBudgetBytes(budgetBytes), mPreSeconds(preSeconds), mPostSeconds(postSeconds),
+  mStopping(false), mClip(-1), mEncoderDone(false), mRingBytes(0), mRingFrames(0), mClips(0), mWritten(0),
+  mDropped(0), mRecording(false)
+{
+    mkdir(mDirectory.c_str(), 0755); //fine if it already exists
+    mEncoder=thread(&ClipRecorder::encodeLoop, this);
+    mWriter=thread(&ClipRecorder::writeLoop, this);
+}
+
+ClipRecorder::~ClipRecorder()
+{
+    stop();
+}
+
+void ClipRecorder::stop()
+{
+    {
+        lock_guard<mutex> lock(mInputMutex);
+        mStopping=true;
+    }
+    mInputReady.notify_all();
+    if(mEncoder.joinable())
+        mEncoder.join();
+    if(mWriter.joinable())
+        mWriter.join();
+}
+
+void ClipRecorder::add(const cv::Mat &gray, int frameNumber, bool triggered)
+{
+    {
+        lock_guard<mutex> lock(mInputMutex);
+        if(mStopping)
+            return;
+        if(mInput.size() >= DVR_MAX_QUEUED){ //encoder is behind; losing a frame beats stalling tracking
+            mDropped++;
+            return;
+        }
+        mInput.push_back(Pending{ gray, frameNumber, chrono::steady_clock::now(), triggered });
+    }
+    mInputReady.notify_one();
+}
+
+void ClipRecorder::encodeLoop()
+{
+    vector<int> params={ cv::IMWRITE_JPEG_QUALITY, DVR_JPEG_QUALITY };
+    vector<uint8_t> jpeg; //imencode's buffer, reused; each frame keeps a copy trimmed to size
+    while(true){
+        Pending pending;
+        {
+            unique_lock<mutex> lock(mInputMutex);
+            mInputReady.wait(lock, [this]{ return mStopping || !mInput.empty(); });
+            if(mInput.empty()) //stopping, and everything queued is encoded
+                break;
+            pending=move(mInput.front());
+            mInput.pop_front();
+        }
+
+        shared_ptr<Encoded> encoded=make_shared<Encoded>();
+        encoded->frameNumber=pending.frameNumber;
+        encoded->time=pending.time;
+        if(!cv::imencode(".jpg", pending.gray, jpeg, params))
+            continue;
+        encoded->jpeg.assign(jpeg.begin(), jpeg.end());
+        pending.gray.release(); //the pipeline's frame can go now
+
+        //ring: drop the oldest until we are back under budget. frames a clip still needs stay
+        //alive in the write queue until they are on disk
+        mRing.push_back(encoded);
+        mRingBytes+=encoded->jpeg.size();
+        while(mRingBytes > mBudgetBytes && mRing.size() > 1){
+            mRingBytes-=mRing.front()->jpeg.size();
+            mRing.pop_front();
+        }
+        mRingFrames=(int)mRing.size();
+
+        chrono::duration<double> post(mPostSeconds);
+        if(pending.triggered){
+            if(mClip < 0){ //new clip: everything in the ring from the pre-trigger window, this frame included
+                mClip=pending.frameNumber;
+                mTrigger=pending.time;
+                mClips++;
+                mRecording=true;
+                chrono::duration<double> pre(mPreSeconds);
+                for(const EncodedRef &frame : mRing)
+                    if(pending.time-frame->time <= pre)
+                        queueWrite(frame);
+            }
+            else
+                queueWrite(encoded);
+            mPostUntil=pending.time+chrono::duration_cast<chrono::steady_clock::duration>(post);
+        }
+        else if(mClip >= 0){
+            if(pending.time <= mPostUntil)
+                queueWrite(encoded);
+            else{
+                mClip=-1;
+                mRecording=false;
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(mWriteMutex);
+        mEncoderDone=true;
+    }
+    mWriteReady.notify_all();
+    mRecording=false;
+}
+
+void ClipRecorder::queueWrite(const EncodedRef &frame)
+{
+    {
+        lock_guard<mutex> lock(mWriteMutex);
+        mWrites.push_back(Write{ frame, mClip, mTrigger });
+    }
+    mWriteReady.notify_one();
+}
+
+void ClipRecorder::writeLoop()
+{
+    int openClip=-1;
+    string clipDirectory;
+    ofstream index;
+    while(true){
+        Write write;
+        {
+            unique_lock<mutex> lock(mWriteMutex);
+            mWriteReady.wait(lock, [this]{ return mEncoderDone || !mWrites.empty(); });
+            if(mWrites.empty())
+                break;
+            write=move(mWrites.front());
+            mWrites.pop_front();
+        }
+
+        if(write.clip!=openClip){
+            openClip=write.clip;
+            clipDirectory=mDirectory+"/clip_"+to_string(openClip);
+            mkdir(clipDirectory.c_str(), 0755);
+            index.close();
+            index.clear();
+            index.open(clipDirectory+"/frames.csv");
+            index << "frame,ms_from_trigger\n";
+            CI_LOG_I( "dvr: writing " << clipDirectory );
+        }
+
+        string path=clipDirectory+"/"+to_string(write.frame->frameNumber)+".jpg";
+        ofstream out(path, ios::binary);
+        out.write((const char*)write.frame->jpeg.data(), write.frame->jpeg.size());
+        if(!out){
+            CI_LOG_E( "dvr: couldn't write " << path );
+            continue;
+        }
+        index << write.frame->frameNumber << "," << chrono::duration<double, milli>(write.frame->time-write.trigger).count() << "\n";
+        index.flush();
+        mWritten++;
+    }
+}
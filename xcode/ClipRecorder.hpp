@@ -0,0 +1,115 @@
+//
+//  ClipRecorder.hpp
+//  Project2
+//
+//  A DVR for motion events. Every tracked frame is JPEG encoded into an in-memory ring that
+//  holds the last few seconds, capped at a byte budget. When a trigger fires (a grid cell in the
+//  trigger zone lit up), the frames from DVR_PRE_SECONDS before it onwards are handed to a writer
+//  thread, followed by every frame until DVR_POST_SECONDS after the last trigger.
+//
+//  Frames are shared between the ring and the writer, never copied, so a clip being written
+//  costs no extra memory beyond frames that already fell out of the ring. add() only queues the
+//  frame; encoding and writing each have their own thread, so the frame loop never waits on
+//  either.
+//
+//  Clips go to <directory>/clip_<trigger frame>/ as <frame>.jpg plus frames.csv (frame number,
+//  milliseconds from the trigger).
+//
+
+#ifndef ClipRecorder_hpp
+#define ClipRecorder_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "MemoryTags.hpp"
+
+#define DVR_BUDGET_BYTES (64 << 20) //ring size cap -- about 30 s of 640x480 gray at quality 80
+#define DVR_PRE_SECONDS 5.0 //footage kept from before the trigger
+#define DVR_POST_SECONDS 5.0 //footage kept after the last trigger
+#define DVR_JPEG_QUALITY 80
+#define DVR_MAX_QUEUED 8 //frames waiting to be encoded before add() starts dropping them
+
+class ClipRecorder {
+public:
+    ClipRecorder(const std::string &directory, size_t budgetBytes = DVR_BUDGET_BYTES,
+                 double preSeconds = DVR_PRE_SECONDS, double postSeconds = DVR_POST_SECONDS);
+    ~ClipRecorder(); //calls stop()
+
+    //gray must not be written afterwards (pipeline frames never are). never blocks
+    void add(const cv::Mat &gray, int frameNumber, bool triggered);
+
+    //encodes what is queued, finishes writing any clip in progress, and joins the threads
+    void stop();
+
+    size_t getRingBytes() const { return mRingBytes; }
+    int getRingFrames() const { return mRingFrames; }
+    int getClips() const { return mClips; } //clips started
+    int getWritten() const { return mWritten; } //frames written to disk
+    int getDropped() const { return mDropped; } //frames add() had to skip because encoding was behind
+    bool isRecording() const { return mRecording; } //a clip is still collecting post-trigger frames
+
+private:
+    typedef std::chrono::steady_clock::time_point Time;
+
+    struct Encoded {
+        int                     frameNumber;
+        Time                    time;
+        std::vector<uint8_t, TaggedAllocator<uint8_t, MEMORY_RECORDINGS>> jpeg; //exactly the encoded size
+    };
+    typedef std::shared_ptr<const Encoded> EncodedRef;
+
+    struct Pending { //waiting to be encoded
+        cv::Mat     gray;
+        int         frameNumber;
+        Time        time;
+        bool        triggered;
+    };
+
+    struct Write { //waiting to be written
+        EncodedRef  frame;
+        int         clip; //trigger frame number, names the directory
+        Time        trigger;
+    };
+
+    void encodeLoop();
+    void writeLoop();
+    void queueWrite(const EncodedRef &frame);
+
+    std::string                 mDirectory;
+    size_t                      mBudgetBytes;
+    double                      mPreSeconds, mPostSeconds;
+
+    //add() -> encoder
+    std::mutex                  mInputMutex;
+    std::condition_variable     mInputReady;
+    std::deque<Pending>         mInput;
+    bool                        mStopping;
+
+    //encoder only
+    std::deque<EncodedRef>      mRing;
+    int                         mClip; //trigger frame of the clip being collected
+    Time                        mTrigger, mPostUntil;
+
+    //encoder -> writer
+    std::mutex                  mWriteMutex;
+    std::condition_variable     mWriteReady;
+    std::deque<Write>           mWrites;
+    bool                        mEncoderDone;
+
+    std::atomic<size_t>         mRingBytes;
+    std::atomic<int>            mRingFrames, mClips, mWritten, mDropped;
+    std::atomic<bool>           mRecording;
+
+    std::thread                 mEncoder, mWriter;
+};
+
+#endif /* ClipRecorder_hpp */
@@ -0,0 +1,221 @@
+//
+//  Contrast.cpp
+//  Project2
+//
+
+#include "Contrast.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+void ContrastNormalizer::layout(const cv::Size &size)
+{
+    mSize=size;
+    int tiles=max(1, min(CLAHE_TILES, min(size.width, size.height)/CLAHE_SAMPLE_STEP));
+    mTiles.assign(tiles*tiles, Tile());
+    for(int j=0; j<tiles; j++)
+        for(int i=0; i<tiles; i++){
+            Tile &tile=mTiles[j*tiles+i];
+            tile.x0=i*size.width/tiles;
+            tile.x1=(i+1)*size.width/tiles;
+            tile.y0=j*size.height/tiles;
+            tile.y1=(j+1)*size.height/tiles;
+        }
+
+    //a pixel blends the tiles whose centres are either side of it; before the first centre and
+    //after the last it takes that tile alone
+    auto blend=[tiles](int length, vector<int> &tile, vector<int> &weight){
+        tile.resize(length);
+        weight.resize(length);
+        for(int p=0; p<length; p++){
+            float at=(p+0.5f)*tiles/length-0.5f; //in tile centres
+            int t=(int)floor(at);
+            float w=at-t;
+            if(t<0){
+                t=0;
+                w=0;
+            }
+            if(t>=tiles-1){
+                t=tiles-1;
+                w=0;
+            }
+            tile[p]=t;
+            weight[p]=(int)lround(w*256);
+        }
+    };
+    blend(size.width, mColumnTile, mColumnWeight);
+    blend(size.height, mRowTile, mRowWeight);
+    mSmoothed=false;
+}
+
+void ContrastNormalizer::histogram(const cv::Mat &gray, Tile &tile) const
+{
+    //unchanged since its histogram was made? compare a sparse sample first, it is 1/16 of the work
+    size_t count=0;
+    int difference=0;
+    for(int y=tile.y0; y<tile.y1; y+=CLAHE_SAMPLE_STEP){
+        const uint8_t *row=gray.ptr<uint8_t>(y);
+        for(int x=tile.x0; x<tile.x1; x+=CLAHE_SAMPLE_STEP, count++)
+            if(tile.valid)
+                difference+=abs(row[x]-tile.samples[count]);
+    }
+    tile.reused= tile.valid && difference<CLAHE_REUSE_DIFFERENCE*count;
+    if(tile.reused)
+        return;
+
+    tile.samples.resize(count);
+    count=0;
+    for(int y=tile.y0; y<tile.y1; y+=CLAHE_SAMPLE_STEP){
+        const uint8_t *row=gray.ptr<uint8_t>(y);
+        for(int x=tile.x0; x<tile.x1; x+=CLAHE_SAMPLE_STEP)
+            tile.samples[count++]=row[x];
+    }
+
+    //four partial histograms, so consecutive equal pixels don't wait on each other's increment
+    uint32_t partial[4][256];
+    memset(partial, 0, sizeof(partial));
+    for(int y=tile.y0; y<tile.y1; y++){
+        const uint8_t *row=gray.ptr<uint8_t>(y);
+        int x=tile.x0;
+        for(; x+4<=tile.x1; x+=4){
+            partial[0][row[x]]++;
+            partial[1][row[x+1]]++;
+            partial[2][row[x+2]]++;
+            partial[3][row[x+3]]++;
+        }
+        for(; x<tile.x1; x++)
+            partial[0][row[x]]++;
+    }
+    for(int v=0; v<256; v++)
+        tile.histogram[v]=partial[0][v]+partial[1][v]+partial[2][v]+partial[3][v];
+    tile.valid=true;
+}
+
+void ContrastNormalizer::buildStretch()
+{
+    uint64_t total[256]={ 0 }, pixels=0, sum=0;
+    for(const Tile &tile : mTiles)
+        for(int v=0; v<256; v++)
+            total[v]+=tile.histogram[v];
+    for(int v=0; v<256; v++){
+        pixels+=total[v];
+        sum+=total[v]*v;
+    }
+    if(pixels==0)
+        return;
+
+    //black and white points at the percentiles, never closer than CONTRAST_MIN_RANGE
+    uint64_t seen=0;
+    int low=0, high=255;
+    for(int v=0; v<256; v++){
+        seen+=total[v];
+        if(seen<=pixels*CONTRAST_LOW_PERCENTILE)
+            low=v;
+        if(seen<pixels*CONTRAST_HIGH_PERCENTILE)
+            high=v+1;
+    }
+    if(high-low<CONTRAST_MIN_RANGE){
+        high=min(255, low+CONTRAST_MIN_RANGE);
+        low=high-CONTRAST_MIN_RANGE;
+    }
+
+    //gamma that puts the stretched mean at mid grey
+    double mean=min(max(((double)sum/pixels-low)/(high-low), 0.01), 0.99);
+    double gamma=min(1.0, max(CONTRAST_MIN_GAMMA, log(0.5)/log(mean)));
+
+    if(!mSmoothed){
+        mLow=low;
+        mHigh=high;
+        mGamma=gamma;
+        mSmoothed=true;
+    }
+    else{
+        mLow+=(low-mLow)*CONTRAST_SMOOTHING;
+        mHigh+=(high-mHigh)*CONTRAST_SMOOTHING;
+        mGamma+=(gamma-mGamma)*CONTRAST_SMOOTHING;
+    }
+
+    for(int v=0; v<256; v++){
+        double t=min(max((v-mLow)/(mHigh-mLow), 0.0), 1.0);
+        mStretch[v]=(uint8_t)lround(pow(t, mGamma)*255);
+    }
+}
+
+void ContrastNormalizer::equalize(Tile &tile) const
+{
+    if(!mClahe){
+        memcpy(tile.lut, mStretch, 256);
+        return;
+    }
+
+    //the tile's histogram as it will be after the stretch
+    uint32_t stretched[256]={ 0 };
+    for(int v=0; v<256; v++)
+        stretched[mStretch[v]]+=tile.histogram[v];
+
+    //clip, and share what was cut off evenly between all bins
+    uint32_t area=(uint32_t)((tile.x1-tile.x0)*(tile.y1-tile.y0));
+    uint32_t limit=max(1u, (uint32_t)(CLAHE_CLIP*area/256));
+    uint32_t excess=0;
+    for(int v=0; v<256; v++)
+        if(stretched[v]>limit){
+            excess+=stretched[v]-limit;
+            stretched[v]=limit;
+        }
+    uint32_t share=excess/256, remainder=excess%256;
+
+    uint8_t equalized[256];
+    uint32_t cdf=0;
+    for(int v=0; v<256; v++){
+        cdf+=stretched[v]+share+(v<(int)remainder ? 1 : 0);
+        equalized[v]=(uint8_t)min(255u, (cdf*255+area/2)/max(1u, area));
+    }
+    for(int v=0; v<256; v++)
+        tile.lut[v]=equalized[mStretch[v]];
+}
+
+void ContrastNormalizer::apply(const cv::Mat &gray, cv::Mat &out)
+{
+    if(gray.empty() || gray.type()!=CV_8UC1)
+        return;
+    out.create(gray.size(), CV_8UC1); //nothing to do when out is gray
+    if(gray.cols!=mSize.width || gray.rows!=mSize.height || mTiles.empty())
+        layout(gray.size());
+
+    cv::parallel_for_(cv::Range(0, (int)mTiles.size()), [&](const cv::Range &range){
+        for(int t=range.start; t<range.end; t++)
+            histogram(gray, mTiles[t]);
+    });
+    mReused=(int)count_if(mTiles.begin(), mTiles.end(), [](const Tile &tile){ return tile.reused; });
+
+    buildStretch();
+    for(Tile &tile : mTiles) //256 steps a tile, not worth the threads
+        equalize(tile);
+
+    //every pixel through the LUTs of the four tiles around it, bands of rows in parallel
+    int tiles=(int)lround(sqrt((double)mTiles.size()));
+    int bands=max(1, min(cv::getNumThreads(), gray.rows/16));
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range){
+        for(int b=range.start; b<range.end; b++)
+            for(int y=gray.rows*b/bands; y<gray.rows*(b+1)/bands; y++){
+                const uint8_t *row=gray.ptr<uint8_t>(y);
+                uint8_t *outRow=out.ptr<uint8_t>(y);
+                int ty=mRowTile[y], wy=mRowWeight[y], ty1=min(ty+1, tiles-1);
+                if(!mClahe){ //every tile has the stretch, one LUT does
+                    for(int x=0; x<gray.cols; x++)
+                        outRow[x]=mStretch[row[x]];
+                    continue;
+                }
+                for(int x=0; x<gray.cols; x++){
+                    int tx=mColumnTile[x], wx=mColumnWeight[x], tx1=min(tx+1, tiles-1);
+                    int v=row[x];
+                    int top=mTiles[ty*tiles+tx].lut[v]*(256-wx)+mTiles[ty*tiles+tx1].lut[v]*wx;
+                    int bottom=mTiles[ty1*tiles+tx].lut[v]*(256-wx)+mTiles[ty1*tiles+tx1].lut[v]*wx;
+                    outRow[x]=(uint8_t)((top*(256-wy)+bottom*wy+32768) >> 16);
+                }
+            }
+    });
+}
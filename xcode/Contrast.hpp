@@ -0,0 +1,84 @@
+//
+//  Contrast.hpp
+//  Project2
+//
+//  Low light pre-processing ('n', or --low-light). At night the frame uses a sliver of the grey
+//  range, corner responses all fall under goodFeaturesToTrack's quality level and features keep
+//  getting lost, so before tracking each frame is normalized:
+//
+//      stretch    the 1st to 99th percentile of the frame spread over 0-255, with a gamma that
+//                 brings the mean up to mid grey (never darker). black point, white point and
+//                 gamma are smoothed over frames so the picture doesn't pump
+//      CLAHE      contrast limited adaptive histogram equalization over CLAHE_TILES x CLAHE_TILES
+//                 tiles: each tile's histogram, clipped at CLAHE_CLIP times its mean bin, becomes
+//                 a LUT, and every pixel blends the LUTs of the four tiles around it
+//
+//  Both run off the tiles' histograms of the frame as it came in. The stretch is one 256 entry
+//  LUT, found from the tiles' histograms summed; each tile's CLAHE LUT is built from its
+//  histogram re-binned through the stretch and then composed with it, so the pixels are read once
+//  for the histograms and written once at the end, whichever steps are on.
+//
+//  Tiles run in parallel (cv::parallel_for_), and a tile whose picture hasn't changed keeps its
+//  histogram: every CLAHE_SAMPLE_STEP-th pixel of every CLAHE_SAMPLE_STEP-th row is compared with
+//  the samples taken when its histogram was made, and if they differ by less than
+//  CLAHE_REUSE_DIFFERENCE grey levels on average the tile is skipped. A still camera at night
+//  rebuilds only the tiles where something moves.
+//
+
+#ifndef Contrast_hpp
+#define Contrast_hpp
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#define CONTRAST_LOW_PERCENTILE 0.01 //black point
+#define CONTRAST_HIGH_PERCENTILE 0.99 //white point
+#define CONTRAST_MIN_RANGE 24 //grey levels; a frame narrower than this is stretched as if it were this wide, so noise isn't blown up
+#define CONTRAST_MIN_GAMMA 0.4 //strongest brightening
+#define CONTRAST_SMOOTHING 0.1 //weight of the newest frame's black point, white point and gamma
+#define CLAHE_TILES 8 //tiles across and down
+#define CLAHE_CLIP 2.0f //a histogram bin is cut at this many times the tile's mean bin
+#define CLAHE_SAMPLE_STEP 4 //pixels and rows between the samples that tell whether a tile changed
+#define CLAHE_REUSE_DIFFERENCE 1.0f //mean grey level difference below which a tile keeps its histogram
+
+class ContrastNormalizer {
+public:
+    void setClahe(bool on) { mClahe=on; } //off: the global stretch only
+    bool getClahe() const { return mClahe; }
+
+    void apply(const cv::Mat &gray, cv::Mat &out); //8-bit. out may be gray itself (in place)
+
+    int getTiles() const { return (int)mTiles.size(); }
+    int getReused() const { return mReused; } //tiles that kept their histogram on the last apply()
+
+private:
+    struct Tile {
+        int                     x0, y0, x1, y1; //pixels, x1 y1 exclusive
+        bool                    valid = false; //histogram and samples are from an earlier frame
+        bool                    reused = false; //this frame
+        uint32_t                histogram[256];
+        std::vector<uint8_t>    samples; //what the histogram was made from, every CLAHE_SAMPLE_STEP pixels
+        uint8_t                 lut[256]; //stretch then equalization
+    };
+
+    void layout(const cv::Size &size); //tiles and the per-column blend tables for a new frame size
+    void histogram(const cv::Mat &gray, Tile &tile) const;
+    void buildStretch(); //mStretch from the summed histograms
+    void equalize(Tile &tile) const; //tile.lut from its histogram and mStretch
+
+    bool                    mClahe = true;
+    cv::Size                mSize;
+    std::vector<Tile>       mTiles; //row major
+    int                     mReused = 0;
+
+    bool                    mSmoothed = false; //mLow, mHigh, mGamma hold earlier frames
+    double                  mLow = 0, mHigh = 255, mGamma = 1;
+    uint8_t                 mStretch[256];
+
+    std::vector<int>        mColumnTile; //tile column left of each pixel column's position between tile centres
+    std::vector<int>        mColumnWeight; //0-256 weight of the tile to its right
+    std::vector<int>        mRowTile, mRowWeight; //the same down the rows
+};
+
+#endif /* Contrast_hpp */
@@ -0,0 +1,280 @@
+//
+//  CornerResponse.cpp
+//  Project2
+//
+
+#include "CornerResponse.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined( __AVX2__ )
+    #include <immintrin.h>
+    #define CORNER_PATH "AVX2"
+#elif defined( __SSE2__ )
+    #include <emmintrin.h>
+    #define CORNER_PATH "SSE2"
+#else
+    #define CORNER_PATH "scalar"
+#endif
+
+#include "cinder/Log.h"
+
+using namespace std;
+
+const char* cornerResponsePath()
+{
+    return CORNER_PATH;
+}
+
+//BORDER_REFLECT_101: -1 -> 1, len -> len-2
+static inline int reflect101(int p, int len)
+{
+    if(len==1)
+        return 0;
+    if(p<0)
+        return -p;
+    if(p>=len)
+        return 2*len-2-p;
+    return p;
+}
+
+//3x3 Sobel at one pixel, xm/xp are the (already reflected) neighbours of x
+static inline void gradientProducts(const uint8_t *r0, const uint8_t *r1, const uint8_t *r2, int xm, int x, int xp,
+                                    float &xx, float &xy, float &yy)
+{
+    int dx=(r0[xp]-r0[xm])+2*(r1[xp]-r1[xm])+(r2[xp]-r2[xm]);
+    int dy=(r2[xm]+2*r2[x]+r2[xp])-(r0[xm]+2*r0[x]+r0[xp]);
+    xx=(float)(dx*dx);
+    xy=(float)(dx*dy);
+    yy=(float)(dy*dy);
+}
+
+//gradient products for one row. the middle loop has no branches so the compiler vectorizes it
+static void gradientRow(const cv::Mat &gray, int y, float *xx, float *xy, float *yy)
+{
+    int w=gray.cols, h=gray.rows;
+    const uint8_t *r0=gray.ptr<uint8_t>(reflect101(y-1, h));
+    const uint8_t *r1=gray.ptr<uint8_t>(y);
+    const uint8_t *r2=gray.ptr<uint8_t>(reflect101(y+1, h));
+
+    gradientProducts(r0, r1, r2, reflect101(-1, w), 0, reflect101(1, w), xx[0], xy[0], yy[0]);
+    for(int x=1; x<w-1; x++){
+        int dx=(r0[x+1]-r0[x-1])+2*(r1[x+1]-r1[x-1])+(r2[x+1]-r2[x-1]);
+        int dy=(r2[x-1]+2*r2[x]+r2[x+1])-(r0[x-1]+2*r0[x]+r0[x+1]);
+        xx[x]=(float)(dx*dx);
+        xy[x]=(float)(dx*dy);
+        yy[x]=(float)(dy*dy);
+    }
+    if(w>1)
+        gradientProducts(r0, r1, r2, w-2, w-1, reflect101(w, w), xx[w-1], xy[w-1], yy[w-1]);
+}
+
+//out[i] = a[i]+b[i]+c[i] -- the vertical half of the 3x3 box sum
+static void sumRows3(const float *a, const float *b, const float *c, float *out, int n)
+{
+    int i=0;
+#if defined( __AVX2__ )
+    for(; i+8<=n; i+=8)
+        _mm256_storeu_ps(out+i, _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)), _mm256_loadu_ps(c+i)));
+#elif defined( __SSE2__ )
+    for(; i+4<=n; i+=4)
+        _mm_storeu_ps(out+i, _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), _mm_loadu_ps(c+i)));
+#endif
+    for(; i<n; i++)
+        out[i]=a[i]+b[i]+c[i];
+}
+
+//horizontal half of the box sum plus the eigenvalue. v* are padded by one on each side
+static void minEigenRow(const float *vxx, const float *vxy, const float *vyy, float *dst, int w, float scale)
+{
+    int x=0;
+#if defined( __AVX2__ )
+    const __m256 s=_mm256_set1_ps(scale*0.5f);
+    for(; x+8<=w; x+=8){
+        __m256 a=_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(vxx+x), _mm256_loadu_ps(vxx+x+1)), _mm256_loadu_ps(vxx+x+2));
+        __m256 b=_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(vxy+x), _mm256_loadu_ps(vxy+x+1)), _mm256_loadu_ps(vxy+x+2));
+        __m256 c=_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(vyy+x), _mm256_loadu_ps(vyy+x+1)), _mm256_loadu_ps(vyy+x+2));
+        __m256 d=_mm256_sub_ps(a, c);
+        __m256 b2=_mm256_add_ps(b, b);
+        __m256 root=_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(d, d), _mm256_mul_ps(b2, b2)));
+        _mm256_storeu_ps(dst+x, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(a, c), root), s));
+    }
+#elif defined( __SSE2__ )
+    const __m128 s=_mm_set1_ps(scale*0.5f);
+    for(; x+4<=w; x+=4){
+        __m128 a=_mm_add_ps(_mm_add_ps(_mm_loadu_ps(vxx+x), _mm_loadu_ps(vxx+x+1)), _mm_loadu_ps(vxx+x+2));
+        __m128 b=_mm_add_ps(_mm_add_ps(_mm_loadu_ps(vxy+x), _mm_loadu_ps(vxy+x+1)), _mm_loadu_ps(vxy+x+2));
+        __m128 c=_mm_add_ps(_mm_add_ps(_mm_loadu_ps(vyy+x), _mm_loadu_ps(vyy+x+1)), _mm_loadu_ps(vyy+x+2));
+        __m128 d=_mm_sub_ps(a, c);
+        __m128 b2=_mm_add_ps(b, b);
+        __m128 root=_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(d, d), _mm_mul_ps(b2, b2)));
+        _mm_storeu_ps(dst+x, _mm_mul_ps(_mm_sub_ps(_mm_add_ps(a, c), root), s));
+    }
+#endif
+    for(; x<w; x++){
+        float a=vxx[x]+vxx[x+1]+vxx[x+2];
+        float b=vxy[x]+vxy[x+1]+vxy[x+2];
+        float c=vyy[x]+vyy[x+1]+vyy[x+2];
+        float d=a-c;
+        dst[x]=((a+c)-sqrt(d*d+4*b*b))*scale*0.5f;
+    }
+}
+
+void cornerMinEigen(const cv::Mat &gray, cv::Mat &response)
+{
+    CV_Assert( gray.type() == CV_8UC1 );
+    int w=gray.cols, h=gray.rows;
+    response.create(h, w, CV_32FC1);
+    if(w==0 || h==0)
+        return;
+
+    //same scaling as cv::cornerMinEigenVal for 8-bit input: Sobel divided by 4*blockSize*255
+    double sobelScale=1.0/(4*3*255.0);
+    float scale=(float)(sobelScale*sobelScale);
+
+    //three rows each of xx, xy, yy (slot = row%3), then the vertically summed rows, padded by one each side
+    vector<float> buffer(9*w+3*(w+2));
+    float *ring=buffer.data();
+    float *vxx=ring+9*w;
+    float *vxy=vxx+(w+2);
+    float *vyy=vxy+(w+2);
+    int slotRow[3]={-1, -1, -1};
+
+    for(int y=0; y<h; y++){
+        int rows[3]={reflect101(y-1, h), y, reflect101(y+1, h)};
+        const float *xx[3], *xy[3], *yy[3];
+        for(int k=0; k<3; k++){
+            int slot=rows[k]%3;
+            float *base=ring+slot*3*w;
+            if(slotRow[slot]!=rows[k]){ //each product row is made exactly once
+                gradientRow(gray, rows[k], base, base+w, base+2*w);
+                slotRow[slot]=rows[k];
+            }
+            xx[k]=base;
+            xy[k]=base+w;
+            yy[k]=base+2*w;
+        }
+
+        sumRows3(xx[0], xx[1], xx[2], vxx+1, w);
+        sumRows3(xy[0], xy[1], xy[2], vxy+1, w);
+        sumRows3(yy[0], yy[1], yy[2], vyy+1, w);
+        //reflect101 padding for the horizontal sum
+        vxx[0]=vxx[1+reflect101(-1, w)]; vxx[w+1]=vxx[1+reflect101(w, w)];
+        vxy[0]=vxy[1+reflect101(-1, w)]; vxy[w+1]=vxy[1+reflect101(w, w)];
+        vyy[0]=vyy[1+reflect101(-1, w)]; vyy[w+1]=vyy[1+reflect101(w, w)];
+
+        minEigenRow(vxx, vxy, vyy, response.ptr<float>(y), w, scale);
+    }
+}
+
+void detectCorners(const cv::Mat &gray, vector<cv::Point2f> &corners, int maxCorners,
+                   double qualityLevel, double minDistance)
+{
+    corners.clear();
+    cv::Mat eig;
+    cornerMinEigen(gray, eig);
+    int w=eig.cols, h=eig.rows;
+
+    float maxVal=0;
+    for(int y=0; y<h; y++){
+        const float *row=eig.ptr<float>(y);
+        for(int x=0; x<w; x++)
+            maxVal=max(maxVal, row[x]);
+    }
+    float threshold=(float)(maxVal*qualityLevel);
+
+    //strong enough and the biggest in its 3x3 neighbourhood
+    struct Candidate { float value; int index; };
+    vector<Candidate> candidates;
+    for(int y=1; y<h-1; y++){
+        const float *r0=eig.ptr<float>(y-1);
+        const float *r1=eig.ptr<float>(y);
+        const float *r2=eig.ptr<float>(y+1);
+        for(int x=1; x<w-1; x++){
+            float v=r1[x];
+            if(v>threshold &&
+               v>=r0[x-1] && v>=r0[x] && v>=r0[x+1] &&
+               v>=r1[x-1] && v>=r1[x+1] &&
+               v>=r2[x-1] && v>=r2[x] && v>=r2[x+1]){
+                Candidate c={v, y*w+x};
+                candidates.push_back(c);
+            }
+        }
+    }
+
+    //strongest first, ties broken the way OpenCV does (later in the image first) so results line up
+    sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b){
+        return a.value>b.value || (a.value==b.value && a.index>b.index);
+    });
+
+    if(minDistance<1){
+        for(size_t i=0; i<candidates.size() && (maxCorners<=0 || (int)corners.size()<maxCorners); i++)
+            corners.push_back(cv::Point2f((float)(candidates[i].index%w), (float)(candidates[i].index/w)));
+        return;
+    }
+
+    //minDistance on a grid of minDistance sized cells, only neighbouring cells need checking
+    int cellSize=(int)lround(minDistance);
+    int gridW=(w+cellSize-1)/cellSize;
+    int gridH=(h+cellSize-1)/cellSize;
+    vector<vector<cv::Point2f>> grid(gridW*gridH);
+    float minDistance2=(float)(minDistance*minDistance);
+
+    for(const Candidate &c : candidates){
+        int x=c.index%w, y=c.index/w;
+        int cx=x/cellSize, cy=y/cellSize;
+        bool good=true;
+        for(int gy=max(0, cy-1); gy<=min(gridH-1, cy+1) && good; gy++){
+            for(int gx=max(0, cx-1); gx<=min(gridW-1, cx+1) && good; gx++){
+                for(const cv::Point2f &p : grid[gy*gridW+gx]){
+                    float dx=x-p.x, dy=y-p.y;
+                    if(dx*dx+dy*dy<minDistance2){
+                        good=false;
+                        break;
+                    }
+                }
+            }
+        }
+        if(!good)
+            continue;
+
+        cv::Point2f p((float)x, (float)y);
+        grid[cy*gridW+cx].push_back(p);
+        corners.push_back(p);
+        if(maxCorners>0 && (int)corners.size()==maxCorners)
+            break;
+    }
+}
+
+void benchmarkCorners(int width, int height, int iterations)
+{
+    cv::Mat frame(height, width, CV_8UC1);
+    cv::randu(frame, 0, 256);
+    cv::Mat ours, theirs;
+    vector<cv::Point2f> corners;
+
+    auto time=[iterations](const function<void()> &run){
+        auto start=chrono::steady_clock::now();
+        for(int k=0; k<iterations; k++)
+            run();
+        return chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/iterations;
+    };
+
+    double opencvResponse=time([&]{ cv::cornerMinEigenVal(frame, theirs, 3, 3); });
+    double fusedResponse=time([&]{ cornerMinEigen(frame, ours); });
+    double opencvDetect=time([&]{ cv::goodFeaturesToTrack(frame, corners, 300, 0.005, 3.0); });
+    double fusedDetect=time([&]{ detectCorners(frame, corners, 300, 0.005, 3.0); });
+
+    double maxError=0;
+    for(int y=0; y<height; y++)
+        for(int x=0; x<width; x++)
+            maxError=max(maxError, (double)fabs(ours.at<float>(y, x)-theirs.at<float>(y, x)));
+
+    CI_LOG_I( "corners @ " << width << "x" << height << " (" << CORNER_PATH << "): response opencv " << opencvResponse
+             << " ms, fused " << fusedResponse << " ms (" << opencvResponse/fusedResponse << "x), max difference " << maxError
+             << "; detect opencv " << opencvDetect << " ms, fused " << fusedDetect << " ms (" << opencvDetect/fusedDetect << "x)" );
+}
@@ -0,0 +1,36 @@
+//
+//  CornerResponse.hpp
+//  Project2
+//
+//  Our own version of what cv::goodFeaturesToTrack does, so the corner response is one pass
+//  instead of four. OpenCV runs Sobel x, Sobel y, a box filter over the three gradient
+//  products and the eigenvalue step as separate whole-image passes; here each row of
+//  gradient products is made as soon as its three source rows are available, kept in a
+//  three row ring, box summed and turned into the min eigenvalue straight away. The working
+//  set is a handful of rows, so it stays in cache even for 4K frames.
+//
+//  The box sum and eigenvalue loop use AVX2 or SSE2 when the build targets them, plain C++
+//  otherwise (arm64 builds get the scalar loop, which the compiler vectorizes for NEON).
+//
+
+#ifndef CornerResponse_hpp
+#define CornerResponse_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+//Shi-Tomasi response (min eigenvalue of the 3x3 summed structure tensor, 3x3 Sobel) for an
+//8-bit gray frame. same scale and borders as cv::cornerMinEigenVal(gray, response, 3, 3)
+void cornerMinEigen(const cv::Mat &gray, cv::Mat &response);
+
+//picks corners the way cv::goodFeaturesToTrack does (quality threshold, 3x3 local maximum,
+//strongest first, minDistance apart) but using cornerMinEigen for the response
+void detectCorners(const cv::Mat &gray, std::vector<cv::Point2f> &corners, int maxCorners,
+                   double qualityLevel, double minDistance);
+
+const char* cornerResponsePath(); //"AVX2", "SSE2" or "scalar" -- whichever this build uses
+
+//times cornerMinEigen and detectCorners against OpenCV on a random frame and logs the result
+void benchmarkCorners(int width, int height, int iterations);
+
+#endif /* CornerResponse_hpp */
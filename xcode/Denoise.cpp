@@ -0,0 +1,88 @@
+//
+//  Denoise.cpp
+//  Project2
+//
+
+#include "Denoise.hpp"
+
+#include <algorithm>
+
+#if defined( __SSE2__ )
+    #include <emmintrin.h>
+    #define DENOISE_PATH "SSE2"
+#else
+    #define DENOISE_PATH "scalar"
+#endif
+
+using namespace std;
+
+const char* denoisePath()
+{
+    return DENOISE_PATH;
+}
+
+//one pixel: the average in 1/8 levels, the weight in 1/16. difference*weight stays inside 16 bits
+static inline uint8_t denoisePixel(uint8_t pixel, int16_t &average)
+{
+    int difference=(pixel << 3)-average;
+    int motion=max(0, abs(difference)-DENOISE_NOISE_LEVELS*8);
+    int weight=min(16, DENOISE_MIN_WEIGHT+(motion >> 3));
+    average=(int16_t)(average+((difference*weight+8) >> 4));
+    return (uint8_t)((average+4) >> 3);
+}
+
+static void denoiseRow(const uint8_t *row, uint8_t *out, int16_t *average, int width)
+{
+    int x=0;
+#if defined( __SSE2__ )
+    const __m128i zero=_mm_setzero_si128(), minWeight=_mm_set1_epi16(DENOISE_MIN_WEIGHT), sixteen=_mm_set1_epi16(16);
+    const __m128i noise=_mm_set1_epi16(DENOISE_NOISE_LEVELS*8);
+    const __m128i eight=_mm_set1_epi16(8), four=_mm_set1_epi16(4);
+    auto step=[&](__m128i pixels, int16_t *avg){
+        __m128i a=_mm_loadu_si128((const __m128i*)avg);
+        __m128i difference=_mm_sub_epi16(_mm_slli_epi16(pixels, 3), a);
+        __m128i magnitude=_mm_max_epi16(difference, _mm_sub_epi16(zero, difference));
+        __m128i motion=_mm_subs_epu16(magnitude, noise); //magnitude is never negative, so unsigned saturation is max(0, ...)
+        __m128i weight=_mm_min_epi16(sixteen, _mm_add_epi16(minWeight, _mm_srli_epi16(motion, 3)));
+        a=_mm_add_epi16(a, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(difference, weight), eight), 4));
+        _mm_storeu_si128((__m128i*)avg, a);
+        return _mm_srai_epi16(_mm_add_epi16(a, four), 3);
+    };
+    for(; x+16<=width; x+=16){
+        __m128i pixels=_mm_loadu_si128((const __m128i*)(row+x));
+        __m128i low=step(_mm_unpacklo_epi8(pixels, zero), average+x);
+        __m128i high=step(_mm_unpackhi_epi8(pixels, zero), average+x+8);
+        _mm_storeu_si128((__m128i*)(out+x), _mm_packus_epi16(low, high));
+    }
+#endif
+    for(; x<width; x++)
+        out[x]=denoisePixel(row[x], average[x]);
+}
+
+void TemporalDenoise::apply(const cv::Mat &gray, cv::Mat &out)
+{
+    if(gray.empty() || gray.type()!=CV_8UC1)
+        return;
+
+    //nothing to average with yet: start from this frame and pass it on as it is
+    if(mAverage.empty() || gray.cols!=mSize.width || gray.rows!=mSize.height){
+        gray.copyTo(out);
+        mSize=gray.size();
+        mAverage.resize((size_t)mSize.width*mSize.height);
+        for(int y=0; y<gray.rows; y++){
+            const uint8_t *row=gray.ptr<uint8_t>(y);
+            int16_t *average=&mAverage[(size_t)y*mSize.width];
+            for(int x=0; x<gray.cols; x++)
+                average[x]=(int16_t)(row[x] << 3);
+        }
+        return;
+    }
+
+    out.create(gray.size(), CV_8UC1);
+    int bands=max(1, min(cv::getNumThreads(), gray.rows/DENOISE_MIN_ROWS));
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range){
+        for(int b=range.start; b<range.end; b++)
+            for(int y=gray.rows*b/bands; y<gray.rows*(b+1)/bands; y++)
+                denoiseRow(gray.ptr<uint8_t>(y), out.ptr<uint8_t>(y), &mAverage[(size_t)y*mSize.width], gray.cols);
+    });
+}
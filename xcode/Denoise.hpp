@@ -0,0 +1,48 @@
+//
+//  Denoise.hpp
+//  Project2
+//
+//  Temporal denoise ahead of the frame difference ('t', or --denoise). Sensor noise alone moves
+//  every pixel a few grey levels a frame, which adds up to a few thousand per grid cell -- right
+//  where CELL_THRESHOLD sits -- and gives LK specks to chase. Each pixel is filtered recursively
+//  over time:
+//
+//      average += (frame - average) * weight
+//
+//  with the weight depending on how far the new pixel is from the average: DENOISE_MIN_WEIGHT/16
+//  up to DENOISE_NOISE_LEVELS of difference (noise, averaged away over many frames), then rising by
+//  1/16 per grey level to 1 (motion, followed within a frame or two so nothing smears). The average
+//  is kept in 1/8 grey levels so slow changes aren't lost to rounding.
+//
+//  The filtered frame is for tracking only: it goes into a separate buffer, and the frame that came
+//  in -- the source's, possibly on display -- is never written.
+//
+//  All of it is 16-bit integer maths, 16 pixels per SSE2 step (a plain loop doing the same sums on
+//  other targets, with identical results), row bands in parallel.
+//
+
+#ifndef Denoise_hpp
+#define Denoise_hpp
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#define DENOISE_MIN_WEIGHT 1 //sixteenths of a new pixel that count when it is close to the average
+#define DENOISE_NOISE_LEVELS 6 //grey levels from the average that are still taken for noise
+#define DENOISE_MIN_ROWS 16 //fewest rows a parallel band gets
+
+class TemporalDenoise {
+public:
+    //gray (8-bit) filtered into out. the first frame (or a new size) only starts the average, and is copied
+    void apply(const cv::Mat &gray, cv::Mat &out);
+    void reset() { mAverage.clear(); }
+
+private:
+    cv::Size                mSize;
+    std::vector<int16_t>    mAverage; //per pixel, in 1/8 grey levels, row major
+};
+
+const char* denoisePath(); //"SSE2" or "scalar", for the overlay
+
+#endif /* Denoise_hpp */
@@ -0,0 +1,260 @@
+//
+//  FeatureTracker.cpp
+//  Project2
+//
+
+#include "FeatureTracker.hpp"
+
+#include <chrono>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "CornerResponse.hpp"
+#include "Grid.hpp"
+#include "MemoryTags.hpp"
+
+using namespace std;
+
+static double msSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+}
+
+//hardware counters around a stage, only when TrackerSettings::perfCounters is on. they count this
+//thread only, so work a stage hands to other threads (FixedPointLK's stripes) isn't included
+static void startPerf(bool on)
+{
+    if(on)
+        PerfCounters::forThisThread().start();
+}
+
+static PerfSample stopPerf(bool on)
+{
+    return on ? PerfCounters::forThisThread().stop() : PerfSample();
+}
+
+FeatureTracker::FeatureTracker()
+{
+    mGridSize=5;
+    mCellGridSize=5;
+    mFrameNumber=-1;
+    mDetectedFrame=-1;
+    mContrastMs=0;
+    mContrastReused=0;
+    mFrameDifference.allocator=memoryTagAllocator(MEMORY_FRAMES);
+}
+
+void FeatureTracker::setGridSize(int n)
+{
+    if(n>0)
+        mGridSize=n;
+}
+
+void FeatureTracker::setLens(shared_ptr<const LensCalibration> lens)
+{
+    mLens=lens;
+    mLensLut=LensLut(); //rebuilt on the next frame
+    mUndistortedPrev.clear();
+    mUndistorted.clear();
+    mCellCorners.clear();
+    mFieldCentres.clear();
+}
+
+void FeatureTracker::reset()
+{
+    mPrevFrame.release();
+    mPreprocessed.release();
+    mDenoised.release();
+    mPrevFeatures.clear();
+    mFeatures.clear();
+    mFeatureStatuses.clear();
+    mFrameDifference.release();
+    mCellSums.clear();
+    mFlowField=FlowField();
+    mUndistortedPrev.clear();
+    mUndistorted.clear();
+    mCellCorners.clear();
+    mFieldCentres.clear();
+    mDenoise.reset();
+}
+
+const cv::Mat &FeatureTracker::preprocess(const cv::Mat &frame)
+{
+    if(!mSettings.normalizeContrast)
+        return frame;
+
+    auto start=chrono::steady_clock::now();
+    mPreprocessed=cv::Mat();
+    mPreprocessed.allocator=memoryTagAllocator(MEMORY_FRAMES);
+    mContrast.setClahe(mSettings.clahe);
+    mContrast.apply(frame, mPreprocessed);
+    mContrastMs=msSince(start);
+    mContrastReused=mContrast.getReused();
+    return mPreprocessed;
+}
+
+void FeatureTracker::process(const cv::Mat &input, int frameNumber)
+{
+    mFrameNumber=frameNumber;
+    mStageTimes=StageTimes();
+    mStageTimes.contrastMs=mContrastMs;
+    mStageTimes.contrastReused=mContrastReused;
+    mContrastMs=0;
+    mContrastReused=0;
+
+    //sensor noise averaged out before anything is differenced or tracked, into a buffer of our own;
+    //input stays as it came for whoever displays or records it
+    if( mSettings.temporalDenoise ){
+        auto start = chrono::steady_clock::now();
+        mDenoised = cv::Mat();
+        mDenoised.allocator = memoryTagAllocator(MEMORY_FRAMES);
+        mDenoise.apply( input, mDenoised );
+        mStageTimes.denoiseMs = msSince(start);
+    }
+    else
+        mDenoise.reset(); //a stale average would blend an old picture in when it comes back on
+    const cv::Mat &curFrame = mSettings.temporalDenoise ? mDenoised : input;
+
+    //the fixed point tracker wants a pyramid for every frame; this one becomes mPrevPyramid at the end
+    bool perf = mSettings.perfCounters;
+    double pyramidMs = 0;
+    PerfSample pyramidPerf;
+    if( mSettings.fixedPointLK ){
+        auto start = chrono::steady_clock::now();
+        startPerf( perf );
+        mCurPyramid.build( curFrame, mSettings.maxLevel, mSettings.winSize+1 );
+        pyramidPerf = stopPerf( perf );
+        pyramidMs = msSince(start);
+    }
+
+    //if we have a previous sample, then we can actually find the optical flow.
+    if( mPrevFrame.data ) {
+
+        // pick new features once sampleWindow (SAMPLE_WINDOW_MOD) frames have passed since the last pick, or the first frame.
+        // counted from the last pick rather than frameNumber % sampleWindow, so a dropped frame can't skip a whole window; a rewound source starts over
+
+        //note: this means we are abandoning all our previous features every SAMPLE_WINDOW_MOD frames that we
+        //had updated and kept track of via our optical flow operations.
+
+        auto start = chrono::steady_clock::now();
+        if( mFeatures.empty() || frameNumber < mDetectedFrame || frameNumber - mDetectedFrame >= mSettings.sampleWindow ){
+            startPerf( perf );
+
+            /*
+             parameters for the  call to cv::goodFeaturesToTrack:
+             curFrame - img,
+             mFeatures - output of corners,
+             maxFeatures - the max # of features (MAX_FEATURES),
+             qualityLevel - quality level (percentage of best found, 0.005),
+             minDistance - min distance (3.0)
+
+             note: remember we're finding corners/edges using these functions
+             
+             detectCorners (fusedCorners) follows the same rules with its own one-pass response, so its
+             picks can differ from cv's; it is opt-in
+             */
+            if( mSettings.fusedCorners )
+                detectCorners( curFrame, mFeatures, mSettings.maxFeatures, mSettings.qualityLevel, mSettings.minDistance );
+            else
+                cv::goodFeaturesToTrack( curFrame, mFeatures, mSettings.maxFeatures, mSettings.qualityLevel, mSettings.minDistance );
+            mStageTimes.detectPerf = stopPerf( perf );
+            mStageTimes.detectMs = msSince(start);
+            mStageTimes.detected = true;
+            mDetectedFrame = frameNumber;
+        }
+
+        mPrevFeatures = mFeatures; //save our current features as previous one
+
+        //This operation will now update our mFeatures & mPrevFeatures based on calculated optical flow patterns between frames UNTIL we choose all new features again in the above operation every SAMPLE_WINDOW_MOD frames. We choose all new features every couple frames, because we lose features as they move in and out frames and become occluded, etc.
+        start = chrono::steady_clock::now();
+        startPerf( perf );
+        if( ! mFeatures.empty() ){
+            if( mSettings.fixedPointLK ){
+                LKSettings lk;
+                lk.winSize = mSettings.winSize;
+                lk.maxLevel = mSettings.maxLevel;
+                mLK.setSettings( lk );
+                mLK.track( mPrevPyramid, mCurPyramid, mPrevFeatures, mFeatures, mFeatureStatuses );
+            }
+            else
+                cv::calcOpticalFlowPyrLK( mPrevFrame, curFrame, mPrevFeatures, mFeatures, mFeatureStatuses, mErrors,
+                                          cv::Size( mSettings.winSize, mSettings.winSize ), mSettings.maxLevel );
+        }
+        mStageTimes.flowPerf = stopPerf( perf );
+        mStageTimes.flowMs = msSince(start) + pyramidMs;
+        if( mSettings.fixedPointLK )
+            mStageTimes.flowPerf.add( pyramidPerf );
+
+        //the difference between frames is what lights up the grid
+        start = chrono::steady_clock::now();
+        startPerf( perf );
+        cv::absdiff( curFrame, mPrevFrame, mFrameDifference );
+        mCellGridSize = mGridSize;
+        mCellSums.resize( mCellGridSize*mCellGridSize );
+        accumulateGrid( mFrameDifference, mCellGridSize, mCellSums.data(), mGridScratch );
+        mStageTimes.gridPerf = stopPerf( perf );
+        mStageTimes.gridMs = msSince(start);
+        
+        //with a lens, what gets measured is corrected per point -- the frame itself is tracked as it came
+        start = chrono::steady_clock::now();
+        if( mLens ){
+            if( mLensLut.empty() || mLensLut.getFrameSize().width != curFrame.cols || mLensLut.getFrameSize().height != curFrame.rows ){
+                mLensLut.build( *mLens, curFrame.size() );
+                mFieldCentres.clear(); //made again below
+            }
+            mLensLut.map( mPrevFeatures, mUndistortedPrev );
+            mLensLut.map( mFeatures, mUndistorted );
+            mCellCorners.resize( (mCellGridSize+1)*(mCellGridSize+1) );
+            for( int j=0; j<=mCellGridSize; j++ )
+                for( int i=0; i<=mCellGridSize; i++ ) //the same boundaries accumulateGrid uses
+                    mCellCorners[j*(mCellGridSize+1)+i] = mLensLut.map( (float)(i*curFrame.cols/mCellGridSize), (float)(j*curFrame.rows/mCellGridSize) );
+        }
+
+        //the sparse feature motion as one vector per cell, for anything that wants a regular field. the
+        //cells stay where the features were tracked so the field lines up with the picture; with a lens
+        //the motion is the undistorted one, undone from the LUT's shrink so it is still in pixels
+        if( mLens ){
+            float unshrink = 1.f/mLensLut.getScale();
+            mLensMotion.resize( mUndistorted.size() );
+            for( size_t i=0; i<mUndistorted.size() && i<mUndistortedPrev.size(); i++ )
+                mLensMotion[i] = (mUndistorted[i]-mUndistortedPrev[i])*unshrink;
+        }
+        buildFlowField( curFrame.size(), mPrevFeatures, mFeatures, mFeatureStatuses, mFlowField, mFlowScratch, mLens ? &mLensMotion : nullptr );
+        
+        //where the field's cells are for the stream, which works in undistorted pixels -- only changes with the LUT
+        if( mLens && mFieldCentres.size() != (size_t)(mFlowField.cols*mFlowField.rows) ){
+            mFieldCentres.resize( mFlowField.cols*mFlowField.rows );
+            for( int y=0; y<mFlowField.rows; y++ )
+                for( int x=0; x<mFlowField.cols; x++ )
+                    mFieldCentres[y*mFlowField.cols+x] = mLensLut.map( (x+0.5f)*mFlowField.cellSize, (y+0.5f)*mFlowField.cellSize );
+        }
+        mStageTimes.fieldMs = msSince(start);
+    }
+
+    //set previous frame
+    mPrevFrame = curFrame;
+    if( mSettings.fixedPointLK )
+        swap( mPrevPyramid, mCurPyramid ); //keeps both sets of buffers, nothing is reallocated next frame
+}
+
+void FeatureTracker::snapshot(TrackResult &result) const
+{
+    result.frameNumber=mFrameNumber;
+    result.epoch=mDetectedFrame;
+    result.prevFeatures=mPrevFeatures;
+    result.features=mFeatures;
+    result.undistortedPrev=mUndistortedPrev; //empty without a lens
+    result.undistorted=mUndistorted;
+    result.featureStatuses=mFeatureStatuses;
+    result.frameSize=mPrevFrame.size(); //mPrevFrame is the frame we just processed
+    result.n=mCellGridSize;
+    result.cellSums=mCellSums;
+    result.cellCorners=mCellCorners;
+    result.stages=mStageTimes;
+    packFeatureVertices(mFeatures, mPrevFeatures, mFeatureStatuses, result.vertices); //so the render thread only has to copy it
+    if(needsFeatureLod(result.vertices.features)) //too dense to draw one by one, average per tile as well
+        aggregateFeatureFlow(result.frameSize, featureLodTile(result.frameSize, mSettings.maxFeatures), result.vertices);
+    result.flow=mFlowField; //copies the field into the slot's buffers; the scratch stays here
+    result.fieldCentres=mFieldCentres; //empty without a lens
+    result.lensScale= mLens ? mLensLut.getScale() : 1.f;
+}
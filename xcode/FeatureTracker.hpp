@@ -0,0 +1,149 @@
+//
+//  FeatureTracker.hpp
+//  Project2
+//
+//  The optical flow + grid work that used to live in FeatureTrackingApp::findOpticalFlow().
+//  It only sees 8-bit gray frames, so it runs the same off a camera, a file or on a worker thread.
+//
+
+#ifndef FeatureTracker_hpp
+#define FeatureTracker_hpp
+
+#include <memory>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "Contrast.hpp"
+#include "Denoise.hpp"
+#include "FeatureVertices.hpp"
+#include "FlowField.hpp"
+#include "Grid.hpp"
+#include "Lens.hpp"
+#include "LucasKanade.hpp"
+#include "PerfCounters.hpp"
+
+#define SAMPLE_WINDOW_MOD 300 //how often we find new features -- that is 1/300 frames we will find some features
+#define MAX_FEATURES 300 //The maximum number of features to track. Experiment with changing this number
+
+//knobs for goodFeaturesToTrack and calcOpticalFlowPyrLK -- defaults are the values this app always used
+struct TrackerSettings {
+    int                          maxFeatures = MAX_FEATURES;
+    int                          sampleWindow = SAMPLE_WINDOW_MOD; //re-detect every this many frames
+    double                       qualityLevel = 0.005; //percentage of best corner found
+    double                       minDistance = 3.0; //pixels between corners
+    int                          winSize = 21; //LK search window, pixels
+    int                          maxLevel = 3; //LK pyramid levels above the frame
+    bool                         fusedCorners = false; //detectCorners (one pass, CornerResponse.hpp) instead of cv::goodFeaturesToTrack; opt-in, its picks aren't cv's
+    bool                         fixedPointLK = false; //FixedPointLK (LucasKanade.hpp) instead of cv::calcOpticalFlowPyrLK
+    bool                         perfCounters = false; //read hardware counters around each stage (PerfCounters.hpp)
+    bool                         temporalDenoise = false; //process() averages out sensor noise over frames before differencing (Denoise.hpp)
+    bool                         normalizeContrast = false; //preprocess() stretches and equalizes frames for low light (Contrast.hpp)
+    bool                         clahe = true; //with normalizeContrast: local equalization as well as the global stretch
+};
+
+//how long each part of process() took on the last frame
+struct StageTimes {
+    bool                         detected = false; //true if this frame picked new features
+    double                       denoiseMs = 0; //temporal denoise on this frame (0 when it is off)
+    double                       contrastMs = 0; //contrast normalization on this frame (0 when it is off)
+    int                          contrastReused = 0; //CLAHE tiles that kept their histogram from an earlier frame
+    double                       detectMs = 0; //goodFeaturesToTrack (0 on frames that don't re-detect)
+    double                       flowMs = 0; //calcOpticalFlowPyrLK (or pyramid + FixedPointLK)
+    double                       gridMs = 0; //frame difference + cell sums
+    double                       fieldMs = 0; //lens correction (Lens.hpp), then features splatted into the flow field (FlowField.hpp)
+    PerfSample                   detectPerf, flowPerf, gridPerf; //hardware counters, only with TrackerSettings::perfCounters
+};
+
+//everything draw() needs from one tracked frame
+struct TrackResult {
+    int                          frameNumber = -1; //which frame this came from
+    int                          epoch = -1; //frame the features were last detected in; feature indices only mean the same thing within one epoch
+    std::vector<cv::Point2f>     prevFeatures, //features in the frame before
+                                 features; //the same features in this frame, where they were tracked (lines up with the picture)
+    std::vector<cv::Point2f>     undistortedPrev, undistorted; //with a lens: prevFeatures/features through the LensLut, the space cellCorners is in. empty otherwise
+    std::vector<uint8_t>         featureStatuses; //1 if features[i] was found from prevFeatures[i]
+    cv::Size                     frameSize; //size of the frame the features and grid are in
+    int                          n = 5; //grid squares across and down
+    std::vector<int>             cellSums; //sum of the frame difference in each square, row major
+    std::vector<cv::Point2f>     cellCorners; //with a lens: the squares' corners undistorted, (n+1) x (n+1) row major, for the stream. empty otherwise
+    FeatureVertices              vertices; //features/prevFeatures/statuses packed for draw()
+    FlowField                    flow; //the same motion as a regular grid of vectors, with arrows for draw()
+    std::vector<cv::Point2f>     fieldCentres; //with a lens: flow's cell centres undistorted, row major, for the stream. empty otherwise
+    float                        lensScale = 1; //LensLut::getScale(): undistorted pixels (the features, cellCorners) per flow pixel
+    cv::Mat                      display; //this frame's luma for the grayscale display mode, empty unless asked for
+    cv::Mat                      displayBuffer; //where display is scaled into when it isn't full size
+    StageTimes                   stages; //how long this frame took, for the overlay
+};
+
+class FeatureTracker {
+public:
+    FeatureTracker();
+
+    void setSettings(const TrackerSettings &settings) { mSettings=settings; }
+    const TrackerSettings &getSettings() const { return mSettings; }
+
+    void setGridSize(int n); //takes effect on the next frame
+
+    //with a lens, results carry undistorted features and cell corners (Lens.hpp). nullptr for none
+    void setLens(std::shared_ptr<const LensCalibration> lens);
+    const std::shared_ptr<const LensCalibration> &getLens() const { return mLens; }
+    int getGridSize() const { return mGridSize; }
+
+    //with TrackerSettings::normalizeContrast, frame normalized into a buffer the tracker owns; otherwise
+    //frame itself. frame belongs to the source and may be on display, so it is never written. pass the
+    //result to process()
+    const cv::Mat &preprocess(const cv::Mat &frame);
+
+    //finds the optical flow between the last frame and curFrame (8-bit gray) and updates the grid.
+    //with TrackerSettings::temporalDenoise the tracking sees a filtered copy; curFrame isn't written
+    void process(const cv::Mat &curFrame, int frameNumber);
+
+    void snapshot(TrackResult &result) const; //copies the current state out
+    void reset(); //forgets the previous frame and features
+
+    const std::vector<cv::Point2f> &getFeatures() const { return mFeatures; }
+    const std::vector<cv::Point2f> &getPrevFeatures() const { return mPrevFeatures; }
+    const std::vector<uint8_t> &getFeatureStatuses() const { return mFeatureStatuses; }
+    const std::vector<int> &getCellSums() const { return mCellSums; }
+    const cv::Mat &getFrameDifference() const { return mFrameDifference; }
+    const StageTimes &getStageTimes() const { return mStageTimes; }
+    const FlowField &getFlowField() const { return mFlowField; }
+
+protected:
+    std::vector<cv::Point2f>   mPrevFeatures, //the features that we found in the last frame
+                               mFeatures; //the feature that we found in the current frame
+    cv::Mat                    mPrevFrame; //the last frame
+    cv::Mat                    mPreprocessed; //preprocess() output, a new buffer each frame since mPrevFrame keeps the last
+    cv::Mat                    mDenoised; //what process() tracks with temporalDenoise, a new buffer each frame too
+    std::vector<uint8_t>       mFeatureStatuses; //a map of previous features to current features
+    std::vector<float>         mErrors; //there could be errors whilst calculating optical flow
+
+    cv::Mat                    mFrameDifference; //absolute difference between the current and last frame
+    int                        mGridSize; //number of squares across and down
+    int                        mCellGridSize; //the grid size mCellSums was computed with
+    std::vector<int>           mCellSums; //sum of the frame difference in each square, row major
+    GridScratch                mGridScratch; //accumulateGrid's boundaries for sizes without a template
+    FlowField                  mFlowField; //mPrevFeatures -> mFeatures on a regular grid (lens corrected motion with a lens)
+    FlowFieldScratch           mFlowScratch; //buildFlowField's buffers, never published
+
+    std::shared_ptr<const LensCalibration> mLens;
+    LensLut                    mLensLut; //built for the first frame after setLens, and when the frame size changes
+    std::vector<cv::Point2f>   mUndistortedPrev, mUndistorted; //mPrevFeatures and mFeatures through mLensLut
+    std::vector<cv::Point2f>   mCellCorners; //grid corners through mLensLut
+    std::vector<cv::Point2f>   mFieldCentres; //mFlowField's cell centres through mLensLut
+    std::vector<cv::Point2f>   mLensMotion; //mUndistorted-mUndistortedPrev back in pixels, what the flow field splats
+    int                        mFrameNumber;
+    int                        mDetectedFrame; //frame the features were last picked in
+    TrackerSettings            mSettings;
+    StageTimes                 mStageTimes;
+
+    TemporalDenoise            mDenoise;
+    ContrastNormalizer         mContrast;
+    double                     mContrastMs; //preprocess() since the last process(), for its StageTimes
+    int                        mContrastReused;
+
+    LKPyramid                  mPrevPyramid, mCurPyramid; //only built when mSettings.fixedPointLK is set
+    FixedPointLK               mLK;
+};
+
+#endif /* FeatureTracker_hpp */
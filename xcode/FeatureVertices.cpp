@@ -0,0 +1,136 @@
+//
+//  FeatureVertices.cpp
+//  Project2
+//
+
+#include "FeatureVertices.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( __SSE2__ )
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void packFeatureVertices(const vector<cv::Point2f> &features, const vector<cv::Point2f> &prevFeatures,
+                         const vector<uint8_t> &statuses, FeatureVertices &packed)
+{
+    int count=(int)min(features.size(), prevFeatures.size());
+    int withStatus=min(count, (int)statuses.size());
+
+    packed.features=count;
+    packed.arrows=0;
+    packed.vertices.resize(4*count); //worst case, every line kept. capacity sticks, so no allocation after the first frames
+    if(count==0){
+        packed.lines=0;
+        return;
+    }
+
+    const float *cur=&features[0].x, *prev=&prevFeatures[0].x;
+    float *points=&packed.vertices[0].x, *lines=points+4*count;
+    float *line=lines;
+    int i=0;
+#if defined( __SSE2__ )
+    for(; i+2<=withStatus; i+=2){
+        __m128 c=_mm_loadu_ps(cur+2*i); //c0 c1
+        __m128 p=_mm_loadu_ps(prev+2*i); //p0 p1
+        __m128 first=_mm_movelh_ps(c, p); //c0 p0
+        __m128 second=_mm_movehl_ps(p, c); //c1 p1
+        _mm_storeu_ps(points+4*i, first);
+        _mm_storeu_ps(points+4*i+4, second);
+
+        //always store, only advance past pairs we keep -- the next store overwrites the rest
+        _mm_storeu_ps(line, first);
+        line+=4*(statuses[i]!=0);
+        _mm_storeu_ps(line, second);
+        line+=4*(statuses[i+1]!=0);
+    }
+#endif
+    for(; i<count; i++){
+        float pair[4]={cur[2*i], cur[2*i+1], prev[2*i], prev[2*i+1]};
+        copy(pair, pair+4, points+4*i);
+        if(i < withStatus){
+            copy(pair, pair+4, line);
+            line+=4*(statuses[i]!=0);
+        }
+    }
+    packed.lines=(int)((line-lines)/4);
+}
+
+int featureLodTile(const cv::Size &frameSize, int maxFeatures)
+{
+    double area=max(frameSize.area(), 1);
+    double tile=sqrt(area*LOD_DENSITY/max(maxFeatures, 1));
+    tile=max(tile, (double)LOD_MIN_TILE);
+    //the grid rounds up at the right and bottom edges, so grow until the count is really in budget
+    int side=(int)ceil(tile);
+    while(((frameSize.width+side-1)/side)*((frameSize.height+side-1)/side) > LOD_MAX_ARROWS)
+        side++;
+    return side;
+}
+
+bool needsFeatureLod(int features)
+{
+    return features >= LOD_MIN_FEATURES;
+}
+
+void aggregateFeatureFlow(const cv::Size &frameSize, int tile, FeatureVertices &packed)
+{
+    packed.arrows=0;
+    packed.tile=tile;
+    if(tile<=0)
+        return;
+    int cols=(frameSize.width+tile-1)/tile, rows=(frameSize.height+tile-1)/tile;
+    if(cols<=0 || rows<=0 || packed.lines==0)
+        return;
+
+    //sum of x, y, dx, dy and the count for each tile, from the compacted line pairs
+    auto &sums=packed.tileSums;
+    sums.assign(5*cols*rows, 0.f);
+    const cv::Point2f *line=&packed.vertices[packed.lineOffset()];
+    for(int i=0; i<packed.lines; i++){
+        const cv::Point2f &cur=line[2*i], &prev=line[2*i+1];
+        int tx=min(max((int)cur.x/tile, 0), cols-1), ty=min(max((int)cur.y/tile, 0), rows-1);
+        float *sum=&sums[5*(ty*cols+tx)];
+        sum[0]+=cur.x;
+        sum[1]+=cur.y;
+        sum[2]+=cur.x-prev.x;
+        sum[3]+=cur.y-prev.y;
+        sum[4]+=1;
+    }
+
+    size_t first=packed.arrowOffset();
+    packed.vertices.resize(max(packed.vertices.size(), first+6*cols*rows)); //lines never need the room past first
+    cv::Point2f *out=&packed.vertices[first];
+    for(int t=0; t<cols*rows; t++){
+        const float *sum=&sums[5*t];
+        if(sum[4]==0)
+            continue;
+        cv::Point2f from(sum[0]/sum[4], sum[1]/sum[4]);
+        cv::Point2f along(sum[2]/sum[4]*LOD_ARROW_SCALE, sum[3]/sum[4]*LOD_ARROW_SCALE);
+        float length=sqrt(along.x*along.x+along.y*along.y);
+        if(length < 1.f) //still, nothing to point at
+            continue;
+
+        arrowVertices(from, along, tile*0.25f, out);
+        out+=6;
+        packed.arrows++;
+    }
+}
+
+void arrowVertices(const cv::Point2f &from, const cv::Point2f &along, float headLength, cv::Point2f *out)
+{
+    //shaft, then two head strokes swept back 30 degrees either side
+    float length=sqrt(along.x*along.x+along.y*along.y);
+    cv::Point2f to=from+along;
+    cv::Point2f back=along*(-min(0.3f, length > 0 ? headLength/length : 0.f));
+    const float c=0.866f, s=0.5f;
+    out[0]=from;
+    out[1]=to;
+    out[2]=to;
+    out[3]=to+cv::Point2f(back.x*c-back.y*s, back.x*s+back.y*c);
+    out[4]=to;
+    out[5]=to+cv::Point2f(back.x*c+back.y*s, -back.x*s+back.y*c);
+}
@@ -0,0 +1,70 @@
+//
+//  FeatureVertices.hpp
+//  Project2
+//
+//  Feature positions laid out exactly the way draw() hands them to OpenGL, so getting a frame
+//  on screen is one copy into a mapped vertex buffer instead of a fromOcv() and a draw call per
+//  point. Packed on the tracking thread when the result is published.
+//
+//      vertices[0 .. 2*features)              features[i], prevFeatures[i], ... (every feature, for the circles)
+//      vertices[2*features .. +2*lines)       the same pairs, only where status is 1 (GL_LINES)
+//      vertices[.. +6*arrows)                 level of detail: one averaged arrow per tile (GL_LINES)
+//
+//  With thousands of features the circles and lines are just noise, and cost a vertex each. Once a
+//  frame has LOD_MIN_FEATURES of them -- a fixed count, since that is what the draw costs, so the
+//  default 300 never gets there whatever the frame size -- the tracker also averages the flow in each
+//  tile of the frame into one arrow. The tile is sized from the frame and maxFeatures so that a full
+//  set of features is about LOD_DENSITY per tile, and never so small that there are more than
+//  LOD_MAX_ARROWS of them, so that view costs the same whatever MAX_FEATURES is. A frame under
+//  LOD_MIN_FEATURES keeps every circle.
+//
+
+#ifndef FeatureVertices_hpp
+#define FeatureVertices_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "MemoryTags.hpp"
+
+#define LOD_DENSITY 4.0f //features per tile with all maxFeatures tracked, which sets the tile size
+#define LOD_MIN_FEATURES 2000 //features a frame needs before the arrows are made
+#define LOD_MIN_TILE 16 //frame pixels, the smallest tile
+#define LOD_MAX_ARROWS 256 //tiles at most, whatever maxFeatures is
+#define LOD_ARROW_SCALE 4.0f //arrows show this many frames of motion so slow flow is still visible
+
+struct FeatureVertices {
+    std::vector<cv::Point2f, TaggedAllocator<cv::Point2f, MEMORY_TRACKS>> vertices; //see above, 8 bytes per vertex
+    int                          features = 0; //number of current/previous pairs at the front
+    int                          lines = 0; //number of status-ok pairs after them
+    int                          arrows = 0; //tile arrows after the lines, 0 unless the features were dense
+    int                          tile = 0; //frame pixels across each arrow's tile, when there are arrows
+
+    size_t lineOffset() const { return 2*features; } //first line vertex
+    size_t arrowOffset() const { return 2*features+2*lines; } //first arrow vertex
+    size_t bytes() const { return (2*features+2*lines+6*arrows)*sizeof(cv::Point2f); }
+
+    std::vector<float, TaggedAllocator<float, MEMORY_TRACKS>> tileSums; //scratch for aggregateFeatureFlow, not drawn
+};
+
+//interleaves features/prevFeatures and compacts the status-ok pairs behind them in one pass
+//(SSE2, two features per step, branchless). statuses shorter than features count as 0
+void packFeatureVertices(const std::vector<cv::Point2f> &features, const std::vector<cv::Point2f> &prevFeatures,
+                         const std::vector<uint8_t> &statuses, FeatureVertices &packed);
+
+//the side of the square tiles that gives LOD_DENSITY features per tile with maxFeatures of them in
+//a frame this size, clamped to LOD_MIN_TILE and LOD_MAX_ARROWS
+int featureLodTile(const cv::Size &frameSize, int maxFeatures);
+
+//true if there are enough features (LOD_MIN_FEATURES) to bother with the arrows
+bool needsFeatureLod(int features);
+
+//6 vertices for GL_LINES: the shaft from..from+along, then two head strokes swept back 30 degrees,
+//at most headLength long
+void arrowVertices(const cv::Point2f &from, const cv::Point2f &along, float headLength, cv::Point2f *out);
+
+//appends one arrow per tile (tile frame pixels square): from the mean position of the tile's
+//status-ok features along their mean motion. call after packFeatureVertices
+void aggregateFeatureFlow(const cv::Size &frameSize, int tile, FeatureVertices &packed);
+
+#endif /* FeatureVertices_hpp */
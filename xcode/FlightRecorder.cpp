@@ -0,0 +1,176 @@
+//
+//  FlightRecorder.cpp
+//  Project2
+//
+
+#include "FlightRecorder.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sys/stat.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "cinder/Log.h"
+
+using namespace std;
+
+FlightRecorder::FlightRecorder(const string &directory, double latencyFactor, bool dropTrigger)
+: mDirectory(directory), mLatencyFactor(latencyFactor), mDropTrigger(dropTrigger), mStart(chrono::steady_clock::now()),
+  mSlots(FLIGHT_SECONDS*FLIGHT_MAX_RATE), mWritten(0), mLastDropped(-1), mLastDumpMs(-1e9), mMedianMs(0), mDumps(0),
+  mDumpRequested(false), mStopping(false), mDumpFrame(-1)
+{
+    for(auto &slot : mSlots){
+        slot.sequence=0;
+        slot.index=UINT64_MAX; //nothing yet
+    }
+    mLatencies.reserve(FLIGHT_MEDIAN_FRAMES);
+    mSorted.reserve(FLIGHT_MEDIAN_FRAMES);
+    mkdir(mDirectory.c_str(), 0755); //fine if it already exists
+    mDumper=thread(&FlightRecorder::dumpLoop, this);
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    stop();
+}
+
+void FlightRecorder::stop()
+{
+    mStopping=true;
+    mDumpReady.notify_all();
+    if(mDumper.joinable())
+        mDumper.join();
+}
+
+int FlightRecorder::getFrames() const
+{
+    return (int)min<uint64_t>(mWritten, mSlots.size());
+}
+
+void FlightRecorder::record(const cv::Mat &gray, int frameNumber, double latencyMs, const StageTimes &stages,
+                            const vector<uint8_t> &statuses, int features, int dropped, int inFlight)
+{
+    uint64_t index=mWritten;
+    Slot &slot=mSlots[index%mSlots.size()];
+    uint32_t sequence=slot.sequence.load(memory_order_relaxed);
+    slot.sequence.store(sequence+1, memory_order_relaxed); //odd: readers keep out
+    atomic_thread_fence(memory_order_release);
+
+    slot.index.store(index, memory_order_relaxed);
+    FlightRecord &record=slot.record;
+    record.frameNumber=frameNumber;
+    record.timeMs=chrono::duration<double, milli>(chrono::steady_clock::now()-mStart).count();
+    record.latencyMs=latencyMs;
+    record.stages=stages;
+    record.features=features;
+    record.tracked=(int)count(statuses.begin(), statuses.end(), 1);
+    record.dropped=dropped;
+    record.inFlight=inFlight;
+
+    //thumbnail straight into the slot -- resize doesn't reallocate a Mat that is already the right size
+    record.thumbWidth=FLIGHT_THUMB_WIDTH;
+    record.thumbHeight=gray.cols > 0 ? min(FLIGHT_THUMB_HEIGHT, max(1, FLIGHT_THUMB_WIDTH*gray.rows/gray.cols)) : 0;
+    if(record.thumbHeight > 0){
+        cv::Mat thumb(record.thumbHeight, record.thumbWidth, CV_8UC1, record.thumb);
+        cv::resize(gray, thumb, thumb.size(), 0, 0, cv::INTER_AREA);
+    }
+
+    slot.sequence.store(sequence+2, memory_order_release);
+    mWritten=index+1;
+
+    //median latency over the last FLIGHT_MEDIAN_FRAMES
+    if((int)mLatencies.size() < FLIGHT_MEDIAN_FRAMES)
+        mLatencies.push_back((float)latencyMs);
+    else
+        mLatencies[index%FLIGHT_MEDIAN_FRAMES]=(float)latencyMs;
+    mSorted.assign(mLatencies.begin(), mLatencies.end());
+    nth_element(mSorted.begin(), mSorted.begin()+mSorted.size()/2, mSorted.end());
+    double median=mSorted[mSorted.size()/2];
+    mMedianMs=median;
+
+    //anomalies: a slow frame (once there is enough history for a median to mean something), or new drops
+    string reason;
+    if(mLatencyFactor > 0 && (int)mLatencies.size() >= FLIGHT_MEDIAN_FRAMES/4 && latencyMs > mLatencyFactor*median)
+        reason="latency "+to_string(latencyMs)+" ms, median "+to_string(median)+" ms";
+    else if(mDropTrigger && mLastDropped >= 0 && dropped > mLastDropped) //drops from before we were attached don't count
+        reason="dropped "+to_string(dropped-mLastDropped)+" frame(s)";
+    mLastDropped=dropped;
+
+    if(!reason.empty() && record.timeMs-mLastDumpMs >= FLIGHT_COOLDOWN_SECONDS*1000 && !mDumpRequested){
+        unique_lock<mutex> lock(mDumpMutex, try_to_lock); //if the dump thread has it, skip rather than wait
+        if(lock.owns_lock()){
+            mDumpFrame=frameNumber;
+            mDumpReason=reason;
+            mDumpRequested=true;
+            mLastDumpMs=record.timeMs;
+            lock.unlock();
+            mDumpReady.notify_one();
+        }
+    }
+}
+
+bool FlightRecorder::read(uint64_t index, FlightRecord &out) const
+{
+    const Slot &slot=mSlots[index%mSlots.size()];
+    for(int attempt=0; attempt<4; attempt++){
+        uint32_t before=slot.sequence.load(memory_order_acquire);
+        if(before & 1)
+            continue;
+        uint64_t held=slot.index.load(memory_order_relaxed);
+        out=slot.record;
+        atomic_thread_fence(memory_order_acquire);
+        if(slot.sequence.load(memory_order_relaxed)==before)
+            return held==index; //a whole record, but maybe one the writer put there after lapping the ring
+
+    }
+    return false;
+}
+
+void FlightRecorder::dumpLoop()
+{
+    while(true){
+        int frame;
+        string reason;
+        {
+            unique_lock<mutex> lock(mDumpMutex);
+            mDumpReady.wait_for(lock, chrono::milliseconds(200), [this]{ return mStopping || mDumpRequested; });
+            if(!mDumpRequested){
+                if(mStopping)
+                    return;
+                continue;
+            }
+            frame=mDumpFrame;
+            reason=mDumpReason;
+        }
+        dump(frame, reason);
+        mDumpRequested=false; //stop() lands back in the wait above, which returns now nothing is asked for
+    }
+}
+
+void FlightRecorder::dump(int frameNumber, const string &reason)
+{
+    string directory=mDirectory+"/flight_"+to_string(frameNumber);
+    mkdir(directory.c_str(), 0755);
+    ofstream(directory+"/reason.txt") << reason << "\n";
+
+    ofstream csv(directory+"/records.csv");
+    csv << "frame,time_ms,latency_ms,detected,detect_ms,flow_ms,grid_ms,features,tracked,dropped,in_flight\n";
+
+    //oldest first. the writer keeps going while we read, so the oldest few may already be gone
+    uint64_t newest=mWritten, oldest=newest > mSlots.size() ? newest-mSlots.size() : 0;
+    FlightRecord record;
+    int written=0;
+    for(uint64_t i=oldest; i<newest; i++){
+        if(!read(i, record))
+            continue;
+        csv << record.frameNumber << "," << record.timeMs << "," << record.latencyMs << "," << record.stages.detected << ","
+            << record.stages.detectMs << "," << record.stages.flowMs << "," << record.stages.gridMs << "," << record.features << ","
+            << record.tracked << "," << record.dropped << "," << record.inFlight << "\n";
+        if(record.thumbHeight > 0)
+            cv::imwrite(directory+"/"+to_string(record.frameNumber)+".png", cv::Mat(record.thumbHeight, record.thumbWidth, CV_8UC1, record.thumb));
+        written++;
+    }
+    mDumps++;
+    CI_LOG_W( "flight recorder: " << reason << " at frame " << frameNumber << ", wrote " << written << " frames to " << directory );
+}
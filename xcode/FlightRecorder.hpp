@@ -0,0 +1,107 @@
+//
+//  FlightRecorder.hpp
+//  Project2
+//
+//  Keeps the last FLIGHT_SECONDS of every tracked frame -- stage times, latency, feature counts,
+//  drops and a thumbnail -- so when a frame suddenly takes 5x as long as usual, or frames start
+//  getting dropped, we can see what led up to it. When that happens the whole ring is written to
+//  <directory>/flight_<frame>/ (records.csv, reason.txt and the thumbnails as PNGs) by a
+//  background thread.
+//
+//  The tracking worker is the only writer. Each slot has a sequence number (seqlock): odd while
+//  it is being written, so the dump thread copies a slot, checks the number didn't move, and
+//  retries if it did. That only catches a copy torn by a write; a slot the writer has already
+//  lapped reads back whole but holds a newer record, so each slot also says which record it holds
+//  and the dump skips the ones that aren't the record it asked for. Recording a frame never waits
+//  on a lock or allocates.
+//
+
+#ifndef FlightRecorder_hpp
+#define FlightRecorder_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "FeatureTracker.hpp"
+#include "MemoryTags.hpp"
+
+#define FLIGHT_SECONDS 10 //history kept
+#define FLIGHT_MAX_RATE 60 //frames per second the ring is sized for
+#define FLIGHT_THUMB_WIDTH 80 //thumbnails fit in this box
+#define FLIGHT_THUMB_HEIGHT 60
+#define FLIGHT_LATENCY_FACTOR 5.0 //a frame this many times the median latency is an anomaly
+#define FLIGHT_MEDIAN_FRAMES 120 //frames the median is taken over
+#define FLIGHT_COOLDOWN_SECONDS 10.0 //at most one dump this often
+
+//one tracked frame
+struct FlightRecord {
+    int          frameNumber;
+    double       timeMs; //since the recorder started
+    double       latencyMs; //submit to publish
+    StageTimes   stages;
+    int          features, tracked; //features, and how many of them have status 1
+    int          dropped, inFlight; //pipeline counters when this frame was published
+    int          thumbWidth, thumbHeight;
+    uint8_t      thumb[FLIGHT_THUMB_WIDTH*FLIGHT_THUMB_HEIGHT]; //downscaled luma, thumbWidth x thumbHeight
+};
+
+class FlightRecorder {
+public:
+    //latencyFactor 0 turns the latency trigger off; dropTrigger turns the dropped-frame trigger on/off
+    FlightRecorder(const std::string &directory, double latencyFactor = FLIGHT_LATENCY_FACTOR, bool dropTrigger = true);
+    ~FlightRecorder(); //calls stop()
+
+    //called once per published frame, by one thread at a time. checks for an anomaly and asks for a dump
+    void record(const cv::Mat &gray, int frameNumber, double latencyMs, const StageTimes &stages,
+                const std::vector<uint8_t> &statuses, int features, int dropped, int inFlight);
+
+    void stop(); //finishes a dump in progress, writes one that was asked for and not started, and joins the dump thread
+
+    double getMedianMs() const { return mMedianMs; }
+    int getDumps() const { return mDumps; }
+    int getFrames() const; //records currently held
+
+private:
+    struct Slot {
+        std::atomic<uint32_t>   sequence; //odd while being written
+        std::atomic<uint64_t>   index; //which record (count of records before it) the slot holds
+        FlightRecord            record;
+    };
+
+    bool read(uint64_t index, FlightRecord &out) const; //false if the slot was overwritten meanwhile, or holds a later record
+    void dumpLoop();
+    void dump(int frameNumber, const std::string &reason);
+
+    std::string                 mDirectory;
+    double                      mLatencyFactor;
+    bool                        mDropTrigger;
+    std::chrono::steady_clock::time_point mStart;
+
+    std::vector<Slot, TaggedAllocator<Slot, MEMORY_RECORDINGS>> mSlots;
+    std::atomic<uint64_t>       mWritten; //records ever written; the newest is mWritten-1
+
+    //writer only
+    std::vector<float>          mLatencies, mSorted; //last FLIGHT_MEDIAN_FRAMES latencies, ring
+    int                         mLastDropped;
+    double                      mLastDumpMs;
+
+    std::atomic<double>         mMedianMs;
+    std::atomic<int>            mDumps;
+
+    //dump requests, writer -> dump thread
+    std::mutex                  mDumpMutex;
+    std::condition_variable     mDumpReady;
+    std::atomic<bool>           mDumpRequested, mStopping;
+    int                         mDumpFrame; //guarded by mDumpMutex
+    std::string                 mDumpReason;
+    std::thread                 mDumper;
+};
+
+#endif /* FlightRecorder_hpp */
@@ -0,0 +1,225 @@
+//
+//  FlowEvaluation.cpp
+//  Project2
+//
+
+#include "FlowEvaluation.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "cinder/Log.h"
+#include "FlowScene.hpp"
+
+using namespace std;
+
+struct NamedScene {
+    const char           *name;
+    FlowSceneSettings    settings;
+};
+
+static vector<NamedScene> evaluationScenes()
+{
+    vector<NamedScene> scenes(6);
+    scenes[0].name="translate";
+    scenes[0].settings.translateX=2.5f;
+    scenes[0].settings.translateY=-1.25f;
+    scenes[1].name="rotate";
+    scenes[1].settings.rotation=0.01f;
+    scenes[2].name="zoom";
+    scenes[2].settings.zoom=1.01f;
+    scenes[3].name="objects";
+    scenes[3].settings.translateX=0.5f;
+    scenes[3].settings.objects=6;
+    scenes[4].name="noise+light";
+    scenes[4].settings.translateX=1.5f;
+    scenes[4].settings.noise=6;
+    scenes[4].settings.illumination=0.2f;
+    scenes[5].name="everything";
+    scenes[5].settings.translateX=1.5f;
+    scenes[5].settings.translateY=1;
+    scenes[5].settings.rotation=0.005f;
+    scenes[5].settings.zoom=1.005f;
+    scenes[5].settings.objects=4;
+    scenes[5].settings.noise=4;
+    scenes[5].settings.illumination=0.1f;
+    return scenes;
+}
+
+static vector<FlowScore> evaluationConfigurations()
+{
+    vector<FlowScore> configs;
+    FlowScore config;
+
+    config.name="default";
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="100 features";
+    config.settings.maxFeatures=100;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="1000 features";
+    config.settings.maxFeatures=1000;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="win 11, 2 levels";
+    config.settings.winSize=11;
+    config.settings.maxLevel=2;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="win 31";
+    config.settings.winSize=31;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="quality 0.01, dist 7";
+    config.settings.qualityLevel=0.01;
+    config.settings.minDistance=7;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="fused corners";
+    config.settings.fusedCorners=true;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="fixed-point LK";
+    config.settings.fixedPointLK=true;
+    configs.push_back(config);
+
+    config=FlowScore();
+    config.name="re-detect every 30";
+    config.settings.sampleWindow=30;
+    configs.push_back(config);
+
+    return configs;
+}
+
+static bool inside(const cv::Point2f &p)
+{
+    return p.x>=0 && p.y>=0 && p.x<EVAL_WIDTH && p.y<EVAL_HEIGHT;
+}
+
+//a is dominated by b if b is at least as good on everything and better on something
+static bool dominated(const FlowScore &a, const FlowScore &b)
+{
+    bool noWorse=b.endpointError<=a.endpointError && b.survival>=a.survival && b.framesPerSecond>=a.framesPerSecond;
+    bool better=b.endpointError<a.endpointError || b.survival>a.survival || b.framesPerSecond>a.framesPerSecond;
+    return noWorse && better;
+}
+
+vector<FlowScore> evaluateFlow()
+{
+    vector<NamedScene> scenes=evaluationScenes();
+    vector<FlowScore> scores=evaluationConfigurations();
+
+    //render every scene once up front so rendering isn't part of the timing
+    vector<vector<cv::Mat>> frames(scenes.size());
+    vector<FlowScene> sceneObjects;
+    for(size_t s=0; s<scenes.size(); s++){
+        sceneObjects.push_back(FlowScene(EVAL_WIDTH, EVAL_HEIGHT, scenes[s].settings, (uint32_t)(s+1)));
+        frames[s].resize(EVAL_FRAMES);
+        for(int k=0; k<EVAL_FRAMES; k++)
+            sceneObjects[s].render(k, frames[s][k]);
+    }
+
+    for(FlowScore &score : scores){
+        double errorSum=0;
+        long errorCount=0;
+        double survivalSum=0;
+        long survivalFrames=0;
+        double seconds=0;
+        long processed=0;
+
+        for(size_t s=0; s<scenes.size(); s++){
+            FeatureTracker tracker;
+            tracker.setSettings(score.settings);
+
+            for(int k=0; k<EVAL_FRAMES; k++){
+                auto start=chrono::steady_clock::now();
+                tracker.process(frames[s][k], k);
+                seconds+=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+                processed++;
+
+                //frame 0 has nothing to compare, and on re-detect frames the new corners come from this
+                //frame rather than the last one, so there is no motion to score
+                if(k==0 || tracker.getStageTimes().detected)
+                    continue;
+
+                const vector<cv::Point2f> &prev=tracker.getPrevFeatures();
+                const vector<cv::Point2f> &cur=tracker.getFeatures();
+                const vector<uint8_t> &status=tracker.getFeatureStatuses();
+                int candidates=0, survived=0;
+                for(size_t i=0; i<prev.size() && i<cur.size() && i<status.size(); i++){
+                    cv::Point2f truth=sceneObjects[s].flow(prev[i], k);
+                    if(!inside(truth)) //it really left the frame, losing it is right
+                        continue;
+                    candidates++;
+                    if(!status[i])
+                        continue;
+                    float dx=cur[i].x-truth.x, dy=cur[i].y-truth.y;
+                    float error=sqrt(dx*dx+dy*dy);
+                    errorSum+=error;
+                    errorCount++;
+                    if(error<=EVAL_SURVIVAL_ERROR)
+                        survived++;
+                }
+                if(candidates>0){
+                    survivalSum+=(double)survived/candidates;
+                    survivalFrames++;
+                }
+            }
+        }
+
+        score.endpointError=errorCount ? errorSum/errorCount : 0;
+        score.survival=survivalFrames ? survivalSum/survivalFrames : 0;
+        score.framesPerSecond=seconds>0 ? processed/seconds : 0;
+    }
+
+    for(FlowScore &score : scores){
+        score.pareto=true;
+        for(const FlowScore &other : scores)
+            if(&other!=&score && dominated(score, other))
+                score.pareto=false;
+    }
+    return scores;
+}
+
+bool reportFlowScores(const vector<FlowScore> &scores, const string &csvPath)
+{
+    CI_LOG_I( "configuration          error(px)  survival   fps      pareto" );
+    for(const FlowScore &score : scores){
+        ostringstream line;
+        line << left << setw(23) << score.name << fixed
+             << setprecision(3) << setw(11) << score.endpointError
+             << setprecision(3) << setw(11) << score.survival
+             << setprecision(1) << setw(9) << score.framesPerSecond
+             << (score.pareto ? "*" : "");
+        CI_LOG_I( line.str() );
+    }
+
+    if(csvPath.empty())
+        return true;
+
+    ofstream out(csvPath);
+    if(!out){
+        CI_LOG_E( "can't write " << csvPath );
+        return false;
+    }
+    out << "configuration,maxFeatures,sampleWindow,qualityLevel,minDistance,winSize,maxLevel,fusedCorners,fixedPointLK,endpointError,survival,framesPerSecond,pareto\n";
+    for(const FlowScore &score : scores){
+        const TrackerSettings &s=score.settings;
+        out << "\"" << score.name << "\"," << s.maxFeatures << "," << s.sampleWindow << "," << s.qualityLevel << ","
+            << s.minDistance << "," << s.winSize << "," << s.maxLevel << "," << (s.fusedCorners ? 1 : 0) << ","
+            << (s.fixedPointLK ? 1 : 0) << "," << score.endpointError << ","
+            << score.survival << "," << score.framesPerSecond << "," << (score.pareto ? 1 : 0) << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+//
+//  FlowEvaluation.hpp
+//  Project2
+//
+//  Scores tracker settings against FlowScene ground truth so we can tell whether a faster
+//  configuration is still accurate. For each configuration it runs every scene (translate,
+//  rotate, zoom, moving discs, noise + lighting, all at once) and reports
+//
+//      endpoint error   mean distance between where LK put a feature and where it really went
+//      survival         fraction of features still tracked to within EVAL_SURVIVAL_ERROR pixels
+//      throughput       frames per second through FeatureTracker::process
+//
+//  and marks the configurations on the Pareto front (nothing else is better on all three).
+//
+//      Project2 --evaluate-flow results.csv
+//
+
+#ifndef FlowEvaluation_hpp
+#define FlowEvaluation_hpp
+
+#include <string>
+#include <vector>
+
+#include "FeatureTracker.hpp"
+
+#define EVAL_FRAMES 60 //frames per scene
+#define EVAL_WIDTH 640
+#define EVAL_HEIGHT 480
+#define EVAL_SURVIVAL_ERROR 1.0f //pixels -- further off than this and the track is counted as lost
+
+struct FlowScore {
+    std::string        name;
+    TrackerSettings    settings;
+    double             endpointError = 0; //pixels
+    double             survival = 0; //0..1
+    double             framesPerSecond = 0;
+    bool               pareto = false;
+};
+
+//runs every configuration listed in FlowEvaluation.cpp over every scene
+std::vector<FlowScore> evaluateFlow();
+
+//logs the table and, if csvPath isn't empty, writes it as CSV. returns false if the file couldn't be written
+bool reportFlowScores(const std::vector<FlowScore> &scores, const std::string &csvPath);
+
+#endif /* FlowEvaluation_hpp */
@@ -0,0 +1,112 @@
+//
+//  FlowField.cpp
+//  Project2
+//
+
+#include "FlowField.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "FeatureVertices.hpp"
+
+using namespace std;
+
+cv::Point2f FlowField::sample(float x, float y) const
+{
+    if(empty())
+        return cv::Point2f(0, 0);
+
+    //cell centres are at (i+0.5)*cellSize. same steps as the particles' SSE2 version, so both agree
+    float scale=1.f/cellSize;
+    float fx=min(max(x*scale-0.5f, 0.f), (float)(cols-1));
+    float fy=min(max(y*scale-0.5f, 0.f), (float)(rows-1));
+    int x0=(int)fx, y0=(int)fy;
+    int x1=min(x0+1, cols-1), y1=min(y0+1, rows-1);
+    float ax=fx-x0, ay=fy-y0;
+
+    const cv::Point2f &a=vectors[y0*cols+x0], &b=vectors[y0*cols+x1];
+    const cv::Point2f &c=vectors[y1*cols+x0], &d=vectors[y1*cols+x1];
+    cv::Point2f top=a+(b-a)*ax, bottom=c+(d-c)*ax;
+    return top+(bottom-top)*ay;
+}
+
+void buildFlowField(const cv::Size &frameSize, const vector<cv::Point2f> &prevFeatures,
+                    const vector<cv::Point2f> &features, const vector<uint8_t> &statuses, FlowField &field,
+                    FlowFieldScratch &scratch, const vector<cv::Point2f> *motions)
+{
+    field.cellSize=FLOW_CELL;
+    int cols=field.cols=(frameSize.width+FLOW_CELL-1)/FLOW_CELL;
+    int rows=field.rows=(frameSize.height+FLOW_CELL-1)/FLOW_CELL;
+    size_t cells=field.empty() ? 0 : (size_t)cols*rows;
+    field.vectors.assign(cells, cv::Point2f(0, 0));
+    field.weights.assign(cells, 0.f);
+    field.arrows.clear();
+    if(cells==0)
+        return;
+
+    //splat: each displacement goes to the four cell centres around where the feature is now
+    vector<cv::Point2f> &splat=scratch.splat;
+    vector<float> &weights=field.weights;
+    splat.assign(cells, cv::Point2f(0, 0));
+    float scale=1.f/FLOW_CELL;
+    size_t count=min(min(prevFeatures.size(), features.size()), statuses.size());
+    if(motions)
+        count=min(count, motions->size());
+    for(size_t i=0; i<count; i++){
+        if(!statuses[i])
+            continue;
+        const cv::Point2f &p=features[i];
+        cv::Point2f motion= motions ? (*motions)[i] : p-prevFeatures[i];
+        float fx=p.x*scale-0.5f, fy=p.y*scale-0.5f;
+        int x0=(int)floor(fx), y0=(int)floor(fy);
+        float ax=fx-x0, ay=fy-y0;
+        for(int dy=0; dy<2; dy++)
+            for(int dx=0; dx<2; dx++){
+                int cx=x0+dx, cy=y0+dy;
+                if(cx<0 || cy<0 || cx>=cols || cy>=rows) //off the edge, the cells that are there keep their share
+                    continue;
+                float w=(dx ? ax : 1-ax)*(dy ? ay : 1-ay);
+                splat[cy*cols+cx]+=motion*w;
+                weights[cy*cols+cx]+=w;
+            }
+    }
+    for(size_t c=0; c<cells; c++)
+        if(weights[c]>0)
+            splat[c]*=1.f/weights[c];
+
+    //fill: Jacobi passes, well supported cells stay at their own average, the rest lean on their neighbours
+    vector<cv::Point2f> &current=field.vectors, &next=scratch.next;
+    current=splat;
+    next.resize(cells);
+    for(int pass=0; pass<FLOW_SMOOTH_ITERATIONS; pass++){
+        for(int y=0; y<rows; y++)
+            for(int x=0; x<cols; x++){
+                int c=y*cols+x, around=0;
+                cv::Point2f sum(0, 0);
+                if(x>0){ sum+=current[c-1]; around++; }
+                if(x<cols-1){ sum+=current[c+1]; around++; }
+                if(y>0){ sum+=current[c-cols]; around++; }
+                if(y<rows-1){ sum+=current[c+cols]; around++; }
+                float support=min(1.f, weights[c]/FLOW_SUPPORT);
+                float decay= weights[c]>0 ? 1.f : FLOW_FILL_DECAY; //only cells nothing landed in fade
+                cv::Point2f filled= around>0 ? sum*(decay/around) : cv::Point2f(0, 0);
+                next[c]=splat[c]*support+filled*(1-support);
+            }
+        current.swap(next); //buffers trade places, nothing is copied or reallocated
+    }
+
+    //arrows from each cell centre, only where there is something to see
+    field.arrows.resize(6*cells);
+    int arrows=0;
+    for(int y=0; y<rows; y++)
+        for(int x=0; x<cols; x++){
+            cv::Point2f along=current[y*cols+x]*FLOW_ARROW_SCALE;
+            if(along.x*along.x+along.y*along.y < 1.f)
+                continue;
+            cv::Point2f centre((x+0.5f)*FLOW_CELL, (y+0.5f)*FLOW_CELL);
+            arrowVertices(centre, along, FLOW_CELL*0.25f, &field.arrows[6*arrows]);
+            arrows++;
+        }
+    field.arrows.resize(6*arrows); //keeps the capacity for next frame
+}
@@ -0,0 +1,62 @@
+//
+//  FlowField.hpp
+//  Project2
+//
+//  The tracked features as a regular vector field. Features sit wherever there was a corner, so
+//  their motion is sparse and uneven; this turns it into one vector per FLOW_CELL square of the
+//  frame, in pixels per tracked frame, for anything that wants "how is the picture moving here"
+//  (the particles, the 'w' arrows) without searching the features. A fraction of what dense
+//  optical flow would cost -- a few microseconds a frame -- and built as its own stage of
+//  FeatureTracker::process().
+//
+//      splat     each status-ok prevFeatures[i] -> features[i] displacement is shared between the
+//                four cell centres around features[i] with bilinear weights, and each cell
+//                averages what it got
+//      fill      FLOW_SMOOTH_ITERATIONS Jacobi passes: every cell becomes its own average, weighed
+//                by how much feature support it had, blended with the mean of its four
+//                neighbours. Empty cells are filled in from the cells around them, fading by
+//                FLOW_FILL_DECAY per cell so motion doesn't spread across the whole frame
+//
+
+#ifndef FlowField_hpp
+#define FlowField_hpp
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#define FLOW_CELL 16 //frame pixels per field cell
+#define FLOW_SMOOTH_ITERATIONS 12 //fill passes; gaps further than this from any feature stay near zero
+#define FLOW_FILL_DECAY 0.9f //a filled-in cell keeps this much of its neighbours' motion
+#define FLOW_SUPPORT 1.0f //splatted weight at which a cell ignores its neighbours (one feature on the centre)
+#define FLOW_ARROW_SCALE 4.0f //arrows show this many frames of motion, like LOD_ARROW_SCALE
+
+struct FlowField {
+    int                          cols = 0, rows = 0; //cells across and down
+    float                        cellSize = FLOW_CELL; //frame pixels per cell
+    std::vector<cv::Point2f>     vectors; //row major, cols*rows, pixels per tracked frame (lens corrected with --lens, still in pixels)
+    std::vector<float>           weights; //row major, how much feature support each cell had (0 = filled in)
+
+    std::vector<cv::Point2f>     arrows; //6 GL_LINES vertices per cell that moves, for draw()
+
+    bool empty() const { return cols==0 || rows==0; }
+
+    //bilinear between cell centres, clamped at the edges. x, y in frame pixels
+    cv::Point2f sample(float x, float y) const;
+};
+
+//buildFlowField's working buffers, kept by whoever builds the field so that copying a FlowField
+//out to the render thread copies only the field
+struct FlowFieldScratch {
+    std::vector<cv::Point2f>     splat, next;
+};
+
+//splats the status-ok prevFeatures[i] -> features[i] motion and fills the gaps (see above), then
+//packs the arrows. reuses field's and scratch's buffers, so it doesn't allocate once the frame size is settled.
+//motions, when given, is what each feature moved by instead of features[i]-prevFeatures[i] (the
+//lens corrected motion); the features still say where it goes in the field
+void buildFlowField(const cv::Size &frameSize, const std::vector<cv::Point2f> &prevFeatures,
+                    const std::vector<cv::Point2f> &features, const std::vector<uint8_t> &statuses, FlowField &field,
+                    FlowFieldScratch &scratch, const std::vector<cv::Point2f> *motions = nullptr);
+
+#endif /* FlowField_hpp */
@@ -0,0 +1,176 @@
+//
+//  FlowScene.cpp
+//  Project2
+//
+
+#include "FlowScene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#define TEXTURE_SIZE 512 //power of two so wrapping is a mask
+#define COARSE_CELL 16 //texture is two octaves of value noise, these are the cell sizes in pixels
+#define FINE_CELL 4
+#define ILLUMINATION_RATE 0.15f //radians per frame of the brightness swing
+
+using namespace std;
+
+//value noise: random values on a grid every cell pixels, bilinear in between, wraps at TEXTURE_SIZE
+static void addValueNoise(cv::Mat &texture, int cell, float amplitude, mt19937 &rng)
+{
+    int cells=TEXTURE_SIZE/cell;
+    vector<float> grid(cells*cells);
+    for(float &g : grid)
+        g=(rng()%1024)/1023.0f*amplitude;
+
+    for(int y=0; y<TEXTURE_SIZE; y++){
+        float *row=texture.ptr<float>(y);
+        int gy=y/cell;
+        float fy=(y%cell)/(float)cell;
+        for(int x=0; x<TEXTURE_SIZE; x++){
+            int gx=x/cell;
+            float fx=(x%cell)/(float)cell;
+            float a=grid[gy*cells+gx];
+            float b=grid[gy*cells+(gx+1)%cells];
+            float c=grid[((gy+1)%cells)*cells+gx];
+            float d=grid[((gy+1)%cells)*cells+(gx+1)%cells];
+            row[x]+=(a*(1-fx)+b*fx)*(1-fy)+(c*(1-fx)+d*fx)*fy;
+        }
+    }
+}
+
+//folds x back and forth into [lo, hi] -- a disc bouncing off the walls
+static float bounce(float x, float lo, float hi)
+{
+    float range=max(1.0f, hi-lo);
+    float m=fmod(x-lo, 2*range);
+    if(m<0)
+        m+=2*range;
+    return lo+(m<range ? m : 2*range-m);
+}
+
+FlowScene::FlowScene(int width, int height, const FlowSceneSettings &settings, uint32_t seed)
+{
+    mWidth=width;
+    mHeight=height;
+    mSettings=settings;
+    mSeed=seed;
+
+    mt19937 rng(seed);
+    mTexture.create(TEXTURE_SIZE, TEXTURE_SIZE, CV_32FC1);
+    for(int y=0; y<TEXTURE_SIZE; y++){
+        float *row=mTexture.ptr<float>(y);
+        for(int x=0; x<TEXTURE_SIZE; x++)
+            row[x]=30;
+    }
+    addValueNoise(mTexture, COARSE_CELL, 150, rng);
+    addValueNoise(mTexture, FINE_CELL, 45, rng);
+
+    for(int i=0; i<settings.objects; i++){
+        Disc disc;
+        disc.radius=20+rng()%30;
+        disc.start=cv::Point2f(disc.radius+rng()%max(1, (int)(width-2*disc.radius)),
+                               disc.radius+rng()%max(1, (int)(height-2*disc.radius)));
+        float angle=(rng()%3600)/3600.0f*2*(float)M_PI;
+        disc.velocity=cv::Point2f(cos(angle)*settings.objectSpeed, sin(angle)*settings.objectSpeed);
+        disc.textureOffset=cv::Point2f(rng()%TEXTURE_SIZE, rng()%TEXTURE_SIZE);
+        mDiscs.push_back(disc);
+    }
+}
+
+float FlowScene::sample(float u, float v) const
+{
+    float fu=floor(u), fv=floor(v);
+    int x0=((int)fu)&(TEXTURE_SIZE-1), y0=((int)fv)&(TEXTURE_SIZE-1);
+    int x1=(x0+1)&(TEXTURE_SIZE-1), y1=(y0+1)&(TEXTURE_SIZE-1);
+    float ax=u-fu, ay=v-fv;
+    const float *r0=mTexture.ptr<float>(y0);
+    const float *r1=mTexture.ptr<float>(y1);
+    return (r0[x0]*(1-ax)+r0[x1]*ax)*(1-ay)+(r1[x0]*(1-ax)+r1[x1]*ax)*ay;
+}
+
+cv::Point2f FlowScene::fromTexture(const cv::Point2f &u, int frameNumber) const
+{
+    float cx=mWidth*0.5f, cy=mHeight*0.5f;
+    float scale=pow(mSettings.zoom, (float)frameNumber);
+    float angle=mSettings.rotation*frameNumber;
+    float dx=u.x-cx, dy=u.y-cy;
+    return cv::Point2f(cx+scale*(cos(angle)*dx-sin(angle)*dy)+mSettings.translateX*frameNumber,
+                       cy+scale*(sin(angle)*dx+cos(angle)*dy)+mSettings.translateY*frameNumber);
+}
+
+cv::Point2f FlowScene::toTexture(const cv::Point2f &p, int frameNumber) const
+{
+    float cx=mWidth*0.5f, cy=mHeight*0.5f;
+    float scale=pow(mSettings.zoom, (float)-frameNumber);
+    float angle=-mSettings.rotation*frameNumber;
+    float dx=p.x-cx-mSettings.translateX*frameNumber;
+    float dy=p.y-cy-mSettings.translateY*frameNumber;
+    return cv::Point2f(cx+scale*(cos(angle)*dx-sin(angle)*dy),
+                       cy+scale*(sin(angle)*dx+cos(angle)*dy));
+}
+
+cv::Point2f FlowScene::discCentre(const Disc &disc, int frameNumber) const
+{
+    return cv::Point2f(bounce(disc.start.x+disc.velocity.x*frameNumber, disc.radius, mWidth-disc.radius),
+                       bounce(disc.start.y+disc.velocity.y*frameNumber, disc.radius, mHeight-disc.radius));
+}
+
+int FlowScene::topDisc(const cv::Point2f &p, int frameNumber) const
+{
+    for(int i=(int)mDiscs.size()-1; i>=0; i--){ //later discs are drawn on top
+        cv::Point2f c=discCentre(mDiscs[i], frameNumber);
+        float dx=p.x-c.x, dy=p.y-c.y;
+        if(dx*dx+dy*dy<=mDiscs[i].radius*mDiscs[i].radius)
+            return i;
+    }
+    return -1;
+}
+
+void FlowScene::render(int frameNumber, cv::Mat &gray) const
+{
+    gray.create(mHeight, mWidth, CV_8UC1);
+
+    vector<cv::Point2f> centres;
+    for(const Disc &disc : mDiscs)
+        centres.push_back(discCentre(disc, frameNumber));
+
+    float gain=1+mSettings.illumination*sin(ILLUMINATION_RATE*frameNumber);
+    int noise=(int)mSettings.noise;
+    mt19937 rng(mSeed*7919u+frameNumber); //same noise every time this frame is rendered
+
+    for(int y=0; y<mHeight; y++){
+        uint8_t *row=gray.ptr<uint8_t>(y);
+        for(int x=0; x<mWidth; x++){
+            cv::Point2f p((float)x, (float)y);
+            float value;
+            int disc=-1;
+            for(int i=(int)centres.size()-1; i>=0 && disc<0; i--){ //later discs are drawn on top
+                float dx=p.x-centres[i].x, dy=p.y-centres[i].y;
+                if(dx*dx+dy*dy<=mDiscs[i].radius*mDiscs[i].radius)
+                    disc=i;
+            }
+            if(disc>=0){
+                const Disc &d=mDiscs[disc];
+                value=sample(p.x-centres[disc].x+d.textureOffset.x, p.y-centres[disc].y+d.textureOffset.y);
+            }
+            else{
+                cv::Point2f u=toTexture(p, frameNumber);
+                value=sample(u.x, u.y);
+            }
+            value*=gain;
+            if(noise>0)
+                value+=(int)(rng()%(2*noise+1))-noise;
+            row[x]=(uint8_t)min(255.0f, max(0.0f, value+0.5f));
+        }
+    }
+}
+
+cv::Point2f FlowScene::flow(const cv::Point2f &p, int frameNumber) const
+{
+    int disc=topDisc(p, frameNumber-1);
+    if(disc>=0) //discs move rigidly
+        return p+discCentre(mDiscs[disc], frameNumber)-discCentre(mDiscs[disc], frameNumber-1);
+    return fromTexture(toTexture(p, frameNumber-1), frameNumber);
+}
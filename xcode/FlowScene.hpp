@@ -0,0 +1,61 @@
+//
+//  FlowScene.hpp
+//  Project2
+//
+//  A synthetic scene where the true motion of every pixel is known. The background is a
+//  smooth random texture under a per-frame similarity transform (translate, rotate, zoom
+//  about the centre); textured discs move over it on their own paths. Noise and a slow
+//  brightness change can be added on top. flow() says exactly where a point in frame k-1
+//  ended up in frame k, which is what FlowEvaluation scores the tracker against.
+//
+
+#ifndef FlowScene_hpp
+#define FlowScene_hpp
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+struct FlowSceneSettings {
+    float    translateX = 0, translateY = 0; //background motion, pixels per frame
+    float    rotation = 0; //background rotation about the centre, radians per frame
+    float    zoom = 1; //background scale factor per frame
+    int      objects = 0; //number of moving discs
+    float    objectSpeed = 4; //disc speed, pixels per frame
+    float    noise = 0; //uniform sensor noise, +- gray levels
+    float    illumination = 0; //brightness swings by +- this fraction
+};
+
+class FlowScene {
+public:
+    FlowScene(int width, int height, const FlowSceneSettings &settings, uint32_t seed = 1);
+
+    void render(int frameNumber, cv::Mat &gray) const; //8-bit gray frame number frameNumber
+
+    //where the point p of frame frameNumber-1 is in frame frameNumber
+    cv::Point2f flow(const cv::Point2f &p, int frameNumber) const;
+
+    int getWidth() const { return mWidth; }
+    int getHeight() const { return mHeight; }
+
+protected:
+    struct Disc {
+        cv::Point2f    start, velocity;
+        float          radius;
+        cv::Point2f    textureOffset; //where in the texture this disc's pattern comes from
+    };
+
+    cv::Point2f toTexture(const cv::Point2f &p, int frameNumber) const; //background: image -> texture
+    cv::Point2f fromTexture(const cv::Point2f &u, int frameNumber) const; //background: texture -> image
+    cv::Point2f discCentre(const Disc &disc, int frameNumber) const; //discs bounce off the frame edges
+    int topDisc(const cv::Point2f &p, int frameNumber) const; //index of the disc covering p, -1 for background
+    float sample(float u, float v) const; //bilinear, wrapping
+
+    int                  mWidth, mHeight;
+    FlowSceneSettings    mSettings;
+    uint32_t             mSeed;
+    std::vector<Disc>    mDiscs;
+    cv::Mat              mTexture; //CV_32FC1, TEXTURE_SIZE square
+};
+
+#endif /* FlowScene_hpp */
@@ -0,0 +1,185 @@
+//
+//  FluidSimulation.cpp
+//  Project2
+//
+
+#include "FluidSimulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( __SSE2__ )
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void FluidSimulation::reset(int cols, int rows)
+{
+    mCols=max(1, cols);
+    mRows=max(1, rows);
+    mStride=mCols+2;
+    size_t cells=(size_t)mStride*(mRows+2);
+    for(Grid *grid : { &mU, &mV, &mDensity, &mU0, &mV0, &mDensity0, &mPressure, &mPressure0, &mDivergence })
+        grid->assign(cells, 0.f);
+}
+
+template<class F>
+void FluidSimulation::forRows(const F &rows) const
+{
+    int bands=max(1, min(cv::getNumThreads(), mRows/FLUID_MIN_ROWS));
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range){
+        for(int b=range.start; b<range.end; b++)
+            rows(1+mRows*b/bands, 1+mRows*(b+1)/bands);
+    });
+}
+
+void FluidSimulation::addMotion(const FlowField &field, const cv::Size &frameSize, float framesPerSecond, float dt)
+{
+    if(field.empty() || frameSize.area()==0 || mCols==0)
+        return;
+
+    float toFrameX=(float)frameSize.width/mCols, toFrameY=(float)frameSize.height/mRows;
+    float toCellsX=framesPerSecond/toFrameX, toCellsY=framesPerSecond/toFrameY; //pixels per frame -> cells per second
+    float coupling=min(1.f, dt*FLUID_COUPLING), dye=dt*FLUID_DYE;
+    forRows([&](int y0, int y1){
+        for(int y=y0; y<y1; y++)
+            for(int x=1; x<=mCols; x++){
+                cv::Point2f motion=field.sample((x-0.5f)*toFrameX, (y-0.5f)*toFrameY);
+                float speed=sqrt(motion.x*motion.x+motion.y*motion.y);
+                if(speed < 0.05f) //still -- leave the fluid to itself
+                    continue;
+                int i=index(x, y);
+                float pull=coupling*min(1.f, speed); //sub-pixel motion only nudges
+                mU[i]+=(motion.x*toCellsX-mU[i])*pull;
+                mV[i]+=(motion.y*toCellsY-mV[i])*pull;
+                mDensity[i]=min(mDensity[i]+speed*dye, 1.f);
+            }
+    });
+}
+
+void FluidSimulation::step(float dt)
+{
+    if(mCols==0 || dt<=0)
+        return;
+
+    //velocity carries itself along, then is made divergence free
+    advect(mU, mU0, 1, dt);
+    advect(mV, mV0, 2, dt);
+    mU.swap(mU0);
+    mV.swap(mV0);
+    project();
+
+    //dye rides on the new velocity, and fades so the picture doesn't fill up
+    advect(mDensity, mDensity0, 0, dt);
+    mDensity.swap(mDensity0);
+    float dyeFade=1.f/(1.f+dt*FLUID_DYE_FADE), velocityFade=1.f/(1.f+dt*FLUID_VELOCITY_FADE);
+    forRows([&](int y0, int y1){
+        for(int i=index(0, y0); i<index(0, y1); i++){
+            mDensity[i]*=dyeFade;
+            mU[i]*=velocityFade;
+            mV[i]*=velocityFade;
+        }
+    });
+}
+
+void FluidSimulation::advect(const Grid &src, Grid &dst, int boundary, float dt) const
+{
+    //trace each cell centre back along the velocity and take what was there
+    float maxX=mCols+0.5f, maxY=mRows+0.5f;
+    forRows([&](int y0, int y1){
+        for(int y=y0; y<y1; y++)
+            for(int x=1; x<=mCols; x++){
+                int i=index(x, y);
+                float px=min(max(x-dt*mU[i], 0.5f), maxX);
+                float py=min(max(y-dt*mV[i], 0.5f), maxY);
+                int x0=(int)px, y0=(int)py;
+                float ax=px-x0, ay=py-y0;
+                int j=index(x0, y0);
+                float top=src[j]+(src[j+1]-src[j])*ax;
+                float bottom=src[j+mStride]+(src[j+mStride+1]-src[j+mStride])*ax;
+                dst[i]=top+(bottom-top)*ay;
+            }
+    });
+    setBoundary(boundary, dst);
+}
+
+void FluidSimulation::project()
+{
+    int s=mStride;
+    forRows([&](int y0, int y1){
+        for(int y=y0; y<y1; y++)
+            for(int x=1; x<=mCols; x++){
+                int i=index(x, y);
+                mDivergence[i]=-0.5f*(mU[i+1]-mU[i-1]+mV[i+s]-mV[i-s]);
+            }
+    });
+    setBoundary(0, mDivergence);
+
+    //Jacobi: each pass reads mPressure and writes mPressure0, then they trade places
+    for(int pass=0; pass<FLUID_JACOBI_ITERATIONS; pass++){
+        const float *p=mPressure.data(), *div=mDivergence.data();
+        float *out=mPressure0.data();
+        forRows([&](int y0, int y1){
+            for(int y=y0; y<y1; y++){
+                int x=1;
+#if defined( __SSE2__ )
+                const __m128 quarter=_mm_set1_ps(0.25f);
+                for(; x+3<=mCols; x+=4){
+                    int i=index(x, y);
+                    __m128 sum=_mm_add_ps(_mm_add_ps(_mm_loadu_ps(p+i-1), _mm_loadu_ps(p+i+1)),
+                                          _mm_add_ps(_mm_loadu_ps(p+i-s), _mm_loadu_ps(p+i+s)));
+                    _mm_storeu_ps(out+i, _mm_mul_ps(_mm_add_ps(sum, _mm_loadu_ps(div+i)), quarter));
+                }
+#endif
+                for(; x<=mCols; x++){
+                    int i=index(x, y);
+                    out[i]=((p[i-1]+p[i+1])+(p[i-s]+p[i+s])+div[i])*0.25f; //same order as the SSE2 sum
+                }
+            }
+        });
+        setBoundary(0, mPressure0);
+        mPressure.swap(mPressure0);
+    }
+
+    //take the pressure gradient off
+    forRows([&](int y0, int y1){
+        for(int y=y0; y<y1; y++)
+            for(int x=1; x<=mCols; x++){
+                int i=index(x, y);
+                mU[i]-=0.5f*(mPressure[i+1]-mPressure[i-1]);
+                mV[i]-=0.5f*(mPressure[i+s]-mPressure[i-s]);
+            }
+    });
+    setBoundary(1, mU);
+    setBoundary(2, mV);
+}
+
+void FluidSimulation::setBoundary(int boundary, Grid &grid) const
+{
+    //walls: the velocity into a wall is mirrored so it cancels there, everything else is copied out
+    for(int x=1; x<=mCols; x++){
+        grid[index(x, 0)]= boundary==2 ? -grid[index(x, 1)] : grid[index(x, 1)];
+        grid[index(x, mRows+1)]= boundary==2 ? -grid[index(x, mRows)] : grid[index(x, mRows)];
+    }
+    for(int y=1; y<=mRows; y++){
+        grid[index(0, y)]= boundary==1 ? -grid[index(1, y)] : grid[index(1, y)];
+        grid[index(mCols+1, y)]= boundary==1 ? -grid[index(mCols, y)] : grid[index(mCols, y)];
+    }
+    grid[index(0, 0)]=0.5f*(grid[index(1, 0)]+grid[index(0, 1)]);
+    grid[index(mCols+1, 0)]=0.5f*(grid[index(mCols, 0)]+grid[index(mCols+1, 1)]);
+    grid[index(0, mRows+1)]=0.5f*(grid[index(1, mRows+1)]+grid[index(0, mRows)]);
+    grid[index(mCols+1, mRows+1)]=0.5f*(grid[index(mCols, mRows+1)]+grid[index(mCols+1, mRows)]);
+}
+
+const cv::Mat &FluidSimulation::getDensityImage()
+{
+    mImage.create(mRows, mCols, CV_8UC1); //no-op after the first call at this size
+    for(int y=0; y<mRows; y++){
+        const float *src=&mDensity[index(1, y+1)];
+        uint8_t *dst=mImage.ptr<uint8_t>(y);
+        for(int x=0; x<mCols; x++)
+            dst[x]=(uint8_t)(min(src[x], 1.f)*255.f);
+    }
+    return mImage;
+}
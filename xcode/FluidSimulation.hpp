@@ -0,0 +1,71 @@
+//
+//  FluidSimulation.hpp
+//  Project2
+//
+//  Stable fluids (Stam 1999) stirred by the motion in front of the camera ('f'). Each update the
+//  flow field (FlowField.hpp) pushes velocity and dye into the grid wherever things moved, then
+//  the usual steps run:
+//
+//      advect     velocity carried along itself, semi-Lagrangian (trace back, bilinear sample)
+//      project    divergence, FLUID_JACOBI_ITERATIONS Jacobi passes for pressure, subtract its
+//                 gradient so the velocity stays incompressible. pressure is kept from the last
+//                 update as the starting guess, so few passes are enough
+//      dye        carried along the new velocity and slowly faded out
+//
+//  The grid is padded by one cell on every side for the walls. Every pass works on bands of rows
+//  run with cv::parallel_for_; the Jacobi pass, where most of the time goes, does four cells per
+//  SSE2 instruction (plain loops on other targets). Units are grid cells and seconds.
+//
+
+#ifndef FluidSimulation_hpp
+#define FluidSimulation_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "FlowField.hpp"
+
+#define FLUID_SIZE 256 //cells across by default (--fluid n); rows follow the frame's aspect
+#define FLUID_MAX_SIZE 512
+#define FLUID_JACOBI_ITERATIONS 24
+#define FLUID_COUPLING 4.0f //per second: how quickly moving areas drag the fluid along at their speed
+#define FLUID_DYE 2.0f //dye added per second per pixel-per-frame of motion (1 is full brightness)
+#define FLUID_DYE_FADE 0.5f //per second
+#define FLUID_VELOCITY_FADE 0.2f //per second
+#define FLUID_MIN_ROWS 16 //fewest rows a parallel band gets
+
+class FluidSimulation {
+public:
+    FluidSimulation() : mCols(0), mRows(0), mStride(0) {}
+
+    void reset(int cols, int rows); //still fluid, no dye
+    int getCols() const { return mCols; }
+    int getRows() const { return mRows; }
+
+    //pushes velocity and dye in where field moves. field is in pixels per tracked frame over a frame
+    //of frameSize; framesPerSecond is the tracking rate that makes that per second
+    void addMotion(const FlowField &field, const cv::Size &frameSize, float framesPerSecond, float dt);
+
+    void step(float dt); //advect, project, carry the dye
+
+    //the dye as 8-bit gray, cols x rows, for a GL_R8 texture. made on demand from the float grid
+    const cv::Mat &getDensityImage();
+
+private:
+    typedef std::vector<float> Grid; //(cols+2) x (rows+2), row major
+
+    int index(int x, int y) const { return y*mStride+x; }
+    template<class F> void forRows(const F &rows) const; //rows(y0, y1) for bands of 1..mRows
+
+    void advect(const Grid &src, Grid &dst, int boundary, float dt) const;
+    void project();
+    void setBoundary(int boundary, Grid &grid) const; //0 scalar, 1 u (mirrored at left/right), 2 v (top/bottom)
+
+    int             mCols, mRows, mStride;
+    Grid            mU, mV, mDensity; //state
+    Grid            mU0, mV0, mDensity0; //advection targets, swapped with the state
+    Grid            mPressure, mPressure0, mDivergence;
+    cv::Mat         mImage;
+};
+
+#endif /* FluidSimulation_hpp */
@@ -0,0 +1,287 @@
+//
+//  FramePipeline.cpp
+//  Project2
+//
+
+#include "FramePipeline.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "Grid.hpp"
+#include "MemoryTags.hpp"
+
+using namespace std;
+
+FramePipeline::FramePipeline(int workers, int maxInFlight)
+: mCancelled(false), mMaxInFlight(maxInFlight), mInFlight(0), mDropped(0), mNextSequence(0),
+  mNextToTrack(0), mTracking(false), mGridSize(5), mDisplayScale(0), mSettingsChanged(false)
+{
+    for(int i=0; i<workers; i++)
+        mWorkers.push_back(thread(&FramePipeline::workerLoop, this));
+}
+
+FramePipeline::~FramePipeline()
+{
+    stop();
+}
+
+void FramePipeline::stop()
+{
+    {
+        lock_guard<mutex> lock(mTaskMutex);
+        mCancelled=true;
+        for(size_t i=0; i<mTasks.size(); i++) //every queued task is a frame's luma stage
+            finish();
+        mTasks.clear(); //frames that haven't started a stage yet are just dropped
+    }
+    mTaskReady.notify_all();
+
+    for(auto &worker : mWorkers) //workers finish the stage they are in, then exit
+        if(worker.joinable())
+            worker.join();
+    mWorkers.clear();
+
+    lock_guard<mutex> lock(mTrackMutex);
+    for(size_t i=0; i<mConverted.size(); i++) //converted but never tracked
+        finish();
+    mConverted.clear();
+}
+
+void FramePipeline::post(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(mTaskMutex);
+        if(mCancelled)
+            return;
+        mTasks.push_back(move(task));
+    }
+    mTaskReady.notify_one();
+}
+
+void FramePipeline::workerLoop()
+{
+    while(true){
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mTaskMutex);
+            mTaskReady.wait(lock, [this]{ return mCancelled || !mTasks.empty(); });
+            if(mCancelled)
+                return;
+            task=move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
+
+bool FramePipeline::submit(const SourceFrame &source, int frameNumber)
+{
+    if((!source.surface && source.luma.empty()) || mCancelled)
+        return false;
+
+    mSourceRate.tick();
+    if(mInFlight >= mMaxInFlight){ //tracking is behind, skip this frame rather than queue up latency
+        mDropped++;
+        return false;
+    }
+
+    mInFlight++;
+    int sequence=mNextSequence++;
+    auto submitted=chrono::steady_clock::now();
+    post([this, source, sequence, frameNumber, submitted]{ lumaStage(source, sequence, frameNumber, submitted); });
+    return true;
+}
+
+void FramePipeline::lumaStage(SourceFrame source, int sequence, int frameNumber, chrono::steady_clock::time_point submitted)
+{
+    if(mCancelled){
+        finish();
+        return;
+    }
+
+    Frame frame;
+    frame.sequence=sequence;
+    frame.frameNumber=frameNumber;
+    frame.submitted=submitted;
+    if(!source.luma.empty())
+        frame.gray=source.luma; //the source already had luma, nothing to convert
+    else{
+        frame.gray.allocator=memoryTagAllocator(MEMORY_FRAMES);
+        extractLuma(*source.surface, frame.gray); //one pass straight from the colour surface, no Channel or ImageSource in between
+    }
+
+    {
+        lock_guard<mutex> lock(mTrackMutex);
+        mConverted[sequence]=move(frame);
+    }
+
+    //we are already on a worker, so carry straight on into tracking. if another worker is
+    //tracking it will pick this frame up when it gets to it
+    trackStage();
+}
+
+void FramePipeline::trackStage()
+{
+    {
+        lock_guard<mutex> lock(mTrackMutex);
+        if(mTracking)
+            return;
+        mTracking=true;
+    }
+
+    while(true){
+        Frame frame;
+        int gridSize, displayScale;
+        TrackerSettings settings;
+        bool settingsChanged;
+        shared_ptr<const LensCalibration> lens;
+        shared_ptr<ClipRecorder> recorder;
+        shared_ptr<FlightRecorder> flight;
+        shared_ptr<TrackSender> sender;
+        cv::Rect2f zone;
+        {
+            lock_guard<mutex> lock(mTrackMutex);
+            auto next=mConverted.find(mNextToTrack);
+            if(mCancelled || next==mConverted.end()){ //nothing ready in order -- whoever converts it will come back here
+                mTracking=false;
+                return;
+            }
+            frame=move(next->second);
+            mConverted.erase(next);
+            mNextToTrack++;
+            gridSize=mGridSize;
+            displayScale=mDisplayScale;
+            settingsChanged=mSettingsChanged;
+            if(settingsChanged)
+                settings=mSettings;
+            mSettingsChanged=false;
+            lens=mLens;
+            recorder=mRecorder;
+            zone=mZone;
+            flight=mFlight;
+            sender=mSender;
+        }
+
+        mTracker.setGridSize(gridSize);
+        if(settingsChanged)
+            mTracker.setSettings(settings);
+        if(mTracker.getLens()!=lens)
+            mTracker.setLens(lens);
+        //the source's frame is shared with its getSurface() on the main thread and never written;
+        //normalization goes into a copy the tracker owns, and that copy is what gets shown and recorded.
+        //the denoised frame stays inside process(), tracking only
+        frame.gray=mTracker.preprocess(frame.gray);
+        mTracker.process(frame.gray, frame.frameNumber);
+
+        TrackResult &result=mResults.back();
+        mTracker.snapshot(result); //reuses that slot's buffers
+
+        if(sender) //a few non-blocking sendto calls, a full socket buffer drops packets rather than waiting
+            sender->send(result);
+
+        if(recorder) //only queues it, encoding happens on the recorder's own thread
+            recorder->add(frame.gray, frame.frameNumber, anyCellFired(result.cellSums, result.n, zone));
+
+        //the luma we just tracked, for the grayscale display. frames are never written after
+        //conversion, so full size is shared rather than copied
+        if(displayScale==1)
+            result.display=frame.gray;
+        else if(displayScale>1){ //scaled into a buffer only this slot owns, never into a shared frame
+            result.displayBuffer.allocator=memoryTagAllocator(MEMORY_FRAMES);
+            cv::resize(frame.gray, result.displayBuffer, cv::Size(), 1.0/displayScale, 1.0/displayScale, cv::INTER_AREA);
+            result.display=result.displayBuffer;
+        }
+        else
+            result.display.release();
+
+        if(flight) //logs timings, counts and a thumbnail; asks for a dump in the background if this frame looks wrong
+            flight->record(frame.gray, frame.frameNumber, chrono::duration<double, milli>(chrono::steady_clock::now()-frame.submitted).count(),
+                           mTracker.getStageTimes(), result.featureStatuses, (int)result.features.size(), mDropped, mInFlight);
+        mResults.publish();
+        mTrackRate.setDeadline(1.5*mSourceRate.getIntervalMs()); //tracking keeps up if it publishes about as often as frames arrive
+        mTrackRate.tick();
+        finish();
+    }
+}
+
+void FramePipeline::finish()
+{
+    mInFlight--;
+}
+
+bool FramePipeline::poll()
+{
+    return mResults.update();
+}
+
+void FramePipeline::setGridSize(int n)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mGridSize=n;
+}
+
+void FramePipeline::setRecorder(shared_ptr<ClipRecorder> recorder, const cv::Rect2f &zone)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mRecorder=recorder;
+    mZone=zone;
+}
+
+void FramePipeline::setTrackerSettings(const TrackerSettings &settings)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mSettings=settings;
+    mSettingsChanged=true;
+}
+
+void FramePipeline::setPerfCounters(bool on)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mSettings.perfCounters=on;
+    mSettingsChanged=true;
+}
+
+void FramePipeline::setContrast(bool on)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mSettings.normalizeContrast=on;
+    mSettingsChanged=true;
+}
+
+void FramePipeline::setDenoise(bool on)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mSettings.temporalDenoise=on;
+    mSettingsChanged=true;
+}
+
+void FramePipeline::setFusedCorners(bool on)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mSettings.fusedCorners=on;
+    mSettingsChanged=true;
+}
+
+void FramePipeline::setLens(shared_ptr<const LensCalibration> lens)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mLens=lens;
+}
+
+void FramePipeline::setFlightRecorder(shared_ptr<FlightRecorder> flight)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mFlight=flight;
+}
+
+void FramePipeline::setSender(shared_ptr<TrackSender> sender)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mSender=sender;
+}
+
+void FramePipeline::setDisplayLuma(int scale)
+{
+    lock_guard<mutex> lock(mTrackMutex);
+    mDisplayScale=scale;
+}
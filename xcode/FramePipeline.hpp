@@ -0,0 +1,131 @@
+//
+//  FramePipeline.hpp
+//  Project2
+//
+//  Runs the per-frame work off the main thread as a chain of stages:
+//
+//      submit (main) -> luma (any worker) -> track (one at a time, in frame order) -> publish
+//
+//  Each stage is a task posted to a small worker pool, so no stage ever waits on another.
+//  Conversion of several frames can overlap; tracking needs the previous frame so it runs
+//  in submission order. update() only submits and polls, it never blocks on tracking.
+//
+//  Results are published through a triple buffer, so draw() can read the latest one at display
+//  rate while tracking runs at camera rate, without a lock between them.
+//
+
+#ifndef FramePipeline_hpp
+#define FramePipeline_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ClipRecorder.hpp"
+#include "FeatureTracker.hpp"
+#include "FlightRecorder.hpp"
+#include "FrameSource.hpp"
+#include "Metrics.hpp"
+#include "TrackStream.hpp"
+#include "TripleBuffer.hpp"
+
+#define PIPELINE_WORKERS 2 //worker threads
+#define PIPELINE_MAX_IN_FLIGHT 3 //frames that can be between submit and publish at once
+
+class FramePipeline {
+public:
+    FramePipeline(int workers = PIPELINE_WORKERS, int maxInFlight = PIPELINE_MAX_IN_FLIGHT);
+    ~FramePipeline(); //calls stop()
+
+    //hands a frame from a FrameSource to the pipeline. returns false (and drops the frame) if too many are in flight
+    bool submit(const SourceFrame &frame, int frameNumber);
+
+    //if a frame finished since the last call, makes it the one getResult() returns and returns true.
+    //never waits. call from one thread only (the one that reads getResult())
+    bool poll();
+    const TrackResult &getResult() const { return mResults.front(); } //valid until the next poll()
+
+    void setGridSize(int n); //picked up by the next frame that gets tracked
+    void setTrackerSettings(const TrackerSettings &settings); //all of them at once; the setters below change one each
+    void setPerfCounters(bool on); //hardware counters per stage in each result's stages (PerfCounters.hpp)
+    void setContrast(bool on); //low light normalization before tracking (Contrast.hpp)
+    void setDenoise(bool on); //temporal denoise before tracking (Denoise.hpp)
+    void setFusedCorners(bool on); //the tracker's one-pass corner detector instead of cv's (CornerResponse.hpp)
+    void setLens(std::shared_ptr<const LensCalibration> lens); //lens corrected flow, undistorted features and cell corners in results (Lens.hpp). nullptr for none
+
+    //every tracked frame also goes to recorder, and triggers it when a grid cell in zone (fractions
+    //of the frame) lights up. nullptr turns recording off
+    void setRecorder(std::shared_ptr<ClipRecorder> recorder, const cv::Rect2f &zone = cv::Rect2f(0, 0, 1, 1));
+
+    //every published frame is also logged to flight (timings, counts, thumbnail). nullptr turns it off
+    void setFlightRecorder(std::shared_ptr<FlightRecorder> flight);
+
+    //every published frame is also streamed to an aggregator (TrackStream.hpp). nullptr turns it off
+    void setSender(std::shared_ptr<TrackSender> sender);
+
+    //0: results carry no luma. 1, 2, 4...: results carry the tracked luma in display, at 1/scale size
+    void setDisplayLuma(int scale);
+
+    //cancels frames still in flight and joins the workers. safe to call more than once
+    void stop();
+
+    int getInFlight() const { return mInFlight; }
+    int getDropped() const { return mDropped; }
+    const RateMeter &getSourceRate() const { return mSourceRate; } //frames offered to submit()
+    const RateMeter &getTrackRate() const { return mTrackRate; } //frames published; missed = later than a source frame interval
+
+private:
+    struct Frame {
+        int        sequence; //order frames were submitted in
+        int        frameNumber;
+        cv::Mat    gray; //8-bit gray, filled by the luma stage
+        std::chrono::steady_clock::time_point submitted; //for the latency the flight recorder logs
+    };
+
+    void post(std::function<void()> task);
+    void workerLoop();
+
+    void lumaStage(SourceFrame source, int sequence, int frameNumber, std::chrono::steady_clock::time_point submitted);
+    void trackStage(); //tracks every converted frame that is next in order
+    void finish(); //one frame left the pipeline (tracked or cancelled)
+
+    std::vector<std::thread>            mWorkers;
+    std::deque<std::function<void()>>   mTasks;
+    std::mutex                          mTaskMutex;
+    std::condition_variable             mTaskReady;
+    std::atomic<bool>                   mCancelled;
+
+    int                                 mMaxInFlight;
+    std::atomic<int>                    mInFlight; //frames between submit and publish
+    std::atomic<int>                    mDropped; //frames refused by submit
+    int                                 mNextSequence; //only touched by submit (main thread)
+
+    //tracking stage
+    std::mutex                          mTrackMutex; //guards mConverted, mNextToTrack, mTracking, mGridSize, mDisplayScale, mRecorder, mZone, mFlight, mSender, mSettings, mSettingsChanged, mLens
+    std::map<int, Frame>                mConverted; //converted frames waiting for their turn, by sequence
+    int                                 mNextToTrack;
+    bool                                mTracking; //a worker is inside trackStage()
+    int                                 mGridSize;
+    int                                 mDisplayScale;
+    TrackerSettings                     mSettings;
+    bool                                mSettingsChanged; //mSettings hasn't reached mTracker yet
+    std::shared_ptr<const LensCalibration> mLens;
+    std::shared_ptr<ClipRecorder>       mRecorder;
+    cv::Rect2f                          mZone;
+    std::shared_ptr<FlightRecorder>     mFlight;
+    std::shared_ptr<TrackSender>        mSender;
+    FeatureTracker                      mTracker; //only used by the worker that owns mTracking
+
+    //publish
+    TripleBuffer<TrackResult>           mResults; //written by the tracking worker, read by poll()
+    RateMeter                           mSourceRate, mTrackRate;
+};
+
+#endif /* FramePipeline_hpp */
@@ -0,0 +1,150 @@
+//
+//  FrameSource.cpp
+//  Project2
+//
+
+#include "FrameSource.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "CinderOpenCV.h"
+#include "MemoryTags.hpp"
+
+using namespace ci;
+using namespace std;
+
+void extractLuma(const Surface8u &surface, cv::Mat &gray)
+{
+    int width=surface.getWidth();
+    int height=surface.getHeight();
+    gray.create(height, width, CV_8UC1);
+
+    int r=surface.getRedOffset();
+    int g=surface.getGreenOffset();
+    int b=surface.getBlueOffset();
+    int inc=surface.getPixelInc(); //3 for RGB, 4 for RGBA/BGRA
+    for(int y=0; y<height; y++){
+        const uint8_t *src=surface.getData()+y*surface.getRowBytes();
+        uint8_t *dst=gray.ptr<uint8_t>(y);
+        for(int x=0; x<width; x++, src+=inc)
+            dst[x]=(uint8_t)((77*src[r]+150*src[g]+29*src[b]+128)>>8); //0.299, 0.587, 0.114 in 8.8 fixed point
+    }
+}
+
+void lumaToSurface(const cv::Mat &gray, SurfaceRef &surface)
+{
+    if(!surface || surface->getWidth()!=gray.cols || surface->getHeight()!=gray.rows)
+        surface=Surface8u::create(gray.cols, gray.rows, false);
+
+    int r=surface->getRedOffset();
+    int g=surface->getGreenOffset();
+    int b=surface->getBlueOffset();
+    int inc=surface->getPixelInc();
+    for(int y=0; y<gray.rows; y++){
+        const uint8_t *src=gray.ptr<uint8_t>(y);
+        uint8_t *dst=surface->getData()+y*surface->getRowBytes();
+        for(int x=0; x<gray.cols; x++, dst+=inc)
+            dst[r]=dst[g]=dst[b]=src[x];
+    }
+}
+
+//camera
+
+CameraSource::CameraSource(int width, int height)
+{
+    mCapture=Capture::create(width, height);
+    mCapture->start();
+}
+
+bool CameraSource::next(SourceFrame &frame)
+{
+    if(!mCapture->checkNewFrame()) //is there a new frame????
+        return false;
+
+    mSurface=mCapture->getSurface(); //a new surface every frame, so the pipeline can keep it
+    frame.surface=mSurface;
+    frame.luma=cv::Mat(); //the pipeline makes luma from the surface on a worker
+    return true;
+}
+
+//movie file
+
+FileSource::FileSource(const string &path, bool loop)
+{
+    mLoop=loop;
+    mSurfaceStale=false;
+    mCapture.open(path);
+    //a gray frame out of the decoder saves a BGR conversion and a cvtColor back per frame. backends
+    //that don't have the mode refuse it, and next() converts what they give it
+    mGray= mCapture.isOpened() && mCapture.set(cv::CAP_PROP_MODE, cv::CAP_MODE_GRAY);
+}
+
+bool FileSource::isOpen() const
+{
+    return mCapture.isOpened();
+}
+
+bool FileSource::next(SourceFrame &frame)
+{
+    cv::Mat decoded; //fresh buffer, the pipeline keeps the luma we make from it
+    decoded.allocator=memoryTagAllocator(MEMORY_FRAMES);
+    if(!mCapture.read(decoded) || decoded.empty()){
+        if(!mLoop)
+            return false;
+        mCapture.set(cv::CAP_PROP_POS_FRAMES, 0); //back to the start
+        if(!mCapture.read(decoded) || decoded.empty())
+            return false;
+    }
+
+    mDecoded=decoded;
+    mSurfaceStale=true;
+    frame.surface.reset();
+    if(decoded.channels()==1) //mGray, or a movie that is gray anyway
+        frame.luma=decoded;
+    else{ //the fallback
+        frame.luma=cv::Mat();
+        frame.luma.allocator=memoryTagAllocator(MEMORY_FRAMES);
+        cv::cvtColor(decoded, frame.luma, cv::COLOR_BGR2GRAY);
+    }
+    return true;
+}
+
+SurfaceRef FileSource::getSurface()
+{
+    if(mSurfaceStale && !mDecoded.empty()){ //only turn it into RGB when someone is going to look at it
+        if(mDecoded.channels()==1)
+            lumaToSurface(mDecoded, mSurface);
+        else
+            mSurface=Surface8u::create(fromOcv(mDecoded)); //fromOcv takes care of BGR -> RGB
+        mSurfaceStale=false;
+    }
+    return mSurface;
+}
+
+//synthetic
+
+SyntheticFrameSource::SyntheticFrameSource(int width, int height, uint32_t seed)
+: mSource(width, height, seed)
+{
+    mSurfaceStale=false;
+}
+
+bool SyntheticFrameSource::next(SourceFrame &frame)
+{
+    frame.surface.reset();
+    frame.luma=cv::Mat(); //fresh buffer, the pipeline keeps the old one
+    frame.luma.allocator=memoryTagAllocator(MEMORY_FRAMES);
+    mSource.next(frame.luma);
+    mLuma=frame.luma;
+    mSurfaceStale=true;
+    return true;
+}
+
+SurfaceRef SyntheticFrameSource::getSurface()
+{
+    if(mSurfaceStale && !mLuma.empty()){
+        lumaToSurface(mLuma, mSurface);
+        mSurfaceStale=false;
+    }
+    return mSurface;
+}
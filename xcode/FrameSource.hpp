@@ -0,0 +1,95 @@
+//
+//  FrameSource.hpp
+//  Project2
+//
+//  Where frames come from. The tracker only wants 8-bit luma, so sources hand it over in the
+//  cheapest form they have:
+//
+//      CameraSource      Cinder's Capture only gives us a colour Surface, so the pipeline pulls
+//                        luma out of it in one pass on a worker (extractLuma)
+//      FileSource        a movie file decoded by OpenCV. The decoder is asked for gray (CAP_MODE_GRAY,
+//                        the Y plane it decoded, on AVFoundation); a backend that won't do that
+//                        decodes to BGR and next() converts it with cvtColor
+//      SyntheticSource   already gray
+//
+//  The colour Surface for the video texture is only made when getSurface() is asked for it,
+//  so with the video hidden the file and synthetic sources never make RGB at all.
+//
+
+#ifndef FrameSource_hpp
+#define FrameSource_hpp
+
+#include <memory>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "cinder/Capture.h"
+#include "cinder/Surface.h"
+#include "SyntheticSource.hpp"
+
+//one frame as the source had it -- luma if it could, otherwise the colour surface.
+//the pipeline holds on to these after next() returns, so sources give out a fresh buffer every frame
+struct SourceFrame {
+    ci::SurfaceRef    surface; //set when luma isn't
+    cv::Mat           luma; //8-bit gray
+};
+
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    virtual bool next(SourceFrame &frame) = 0; //true if there was a new frame
+    virtual ci::SurfaceRef getSurface() = 0; //colour version of the last frame, for display
+};
+
+class CameraSource : public FrameSource {
+public:
+    CameraSource(int width, int height); //first default camera. throws like ci::Capture::create
+
+    bool next(SourceFrame &frame) override;
+    ci::SurfaceRef getSurface() override { return mSurface; }
+
+protected:
+    ci::CaptureRef    mCapture;
+    ci::SurfaceRef    mSurface;
+};
+
+class FileSource : public FrameSource {
+public:
+    FileSource(const std::string &path, bool loop = true); //check isOpen() afterwards
+
+    bool isOpen() const;
+    bool next(SourceFrame &frame) override;
+    ci::SurfaceRef getSurface() override;
+
+protected:
+    cv::VideoCapture        mCapture;
+    bool                    mLoop;
+    bool                    mGray; //the backend agreed to decode straight to gray
+    cv::Mat                 mDecoded; //as decoded: gray, or BGR when mGray is false
+    ci::SurfaceRef          mSurface;
+    bool                    mSurfaceStale; //mSurface is older than mDecoded
+};
+
+class SyntheticFrameSource : public FrameSource {
+public:
+    SyntheticFrameSource(int width, int height, uint32_t seed = 1);
+
+    bool next(SourceFrame &frame) override;
+    ci::SurfaceRef getSurface() override;
+
+protected:
+    SyntheticSource         mSource;
+    cv::Mat                 mLuma; //last frame, shared with the pipeline (never written again once handed over)
+    ci::SurfaceRef          mSurface;
+    bool                    mSurfaceStale;
+};
+
+//pulls 8-bit luma (BT.601 weights) out of a colour surface in a single pass, reusing gray's buffer
+void extractLuma(const ci::Surface8u &surface, cv::Mat &gray);
+
+//copies gray into a colour surface for display, reusing surface if it is the right size
+void lumaToSurface(const cv::Mat &gray, ci::SurfaceRef &surface);
+
+#endif /* FrameSource_hpp */
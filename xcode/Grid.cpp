@@ -0,0 +1,77 @@
+//
+//  Grid.cpp
+//  Project2
+//
+
+#include "Grid.hpp"
+
+#include <chrono>
+#include "cinder/Log.h"
+
+using namespace std;
+
+void accumulateGridDynamic(const cv::Mat &diff, int n, int *sums, GridScratch &scratch)
+{
+    vector<int> &cellX=scratch.cellX, &cellY=scratch.cellY;
+    cellX.resize(n+1); //only grows when n does
+    cellY.resize(n+1);
+    for(int k=0; k<=n; k++){
+        cellX[k]=k*diff.cols/n;
+        cellY[k]=k*diff.rows/n;
+    }
+
+    for(int c=0; c<n*n; c++)
+        sums[c]=0;
+
+    for(int j=0; j<n; j++){
+        int *rowSums=sums+j*n;
+        for(int y=cellY[j]; y<cellY[j+1]; y++){
+            const uint8_t *row=diff.ptr<uint8_t>(y);
+            for(int i=0; i<n; i++)
+                rowSums[i]+=sumCellRow(row, cellX[i], cellX[i+1]);
+        }
+    }
+}
+
+void accumulateGrid(const cv::Mat &diff, int n, int *sums, GridScratch &scratch)
+{
+    switch(n){
+        case 5:  accumulateGridFixed<5>(diff, sums); break;
+        case 9:  accumulateGridFixed<9>(diff, sums); break;
+        case 24: accumulateGridFixed<24>(diff, sums); break;
+        default: accumulateGridDynamic(diff, n, sums, scratch); break;
+    }
+}
+
+bool anyCellFired(const std::vector<int> &sums, int n, const cv::Rect2f &zone)
+{
+    if((int)sums.size()!=n*n)
+        return false;
+    for(int j=0; j<n; j++)
+        for(int i=0; i<n; i++)
+            if(sums[j*n+i]>CELL_THRESHOLD && zone.contains(cv::Point2f((i+0.5f)/n, (j+0.5f)/n)))
+                return true;
+    return false;
+}
+
+void benchmarkGrid(int n, int width, int height, int iterations)
+{
+    cv::Mat frame(height, width, CV_8UC1);
+    cv::randu(frame, 0, 256); //random noise, content doesn't matter for timing
+    vector<int> sums(n*n);
+    GridScratch scratch;
+
+    auto start=chrono::steady_clock::now();
+    for(int k=0; k<iterations; k++)
+        accumulateGridDynamic(frame, n, sums.data(), scratch);
+    double dynamicMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/iterations;
+
+    start=chrono::steady_clock::now();
+    for(int k=0; k<iterations; k++)
+        accumulateGrid(frame, n, sums.data(), scratch);
+    double fixedMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/iterations;
+
+    CI_LOG_I( "grid " << n << "x" << n << " @ " << width << "x" << height
+             << ": dynamic " << dynamicMs << " ms, specialized " << fixedMs << " ms ("
+             << dynamicMs/fixedMs << "x)" );
+}
@@ -0,0 +1,218 @@
+//
+//  GroundPlane.cpp
+//  Project2
+//
+
+#include "GroundPlane.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+cv::Point2f Homography::apply(const cv::Point2f &p) const
+{
+    double w=h[6]*p.x+h[7]*p.y+h[8];
+    if(fabs(w)<1e-12) //on the horizon -- nothing sensible to return
+        return cv::Point2f(0, 0);
+    return cv::Point2f((float)((h[0]*p.x+h[1]*p.y+h[2])/w), (float)((h[3]*p.x+h[4]*p.y+h[5])/w));
+}
+
+bool loadHomographies(const string &path, map<int, Homography> &homographies)
+{
+    ifstream in(path);
+    if(!in)
+        return false;
+    string line;
+    while(getline(in, line)){
+        size_t start=line.find_first_not_of(" \t\r");
+        if(start==string::npos || line[start]=='#')
+            continue;
+        istringstream fields(line);
+        int camera;
+        Homography homography;
+        if(!(fields >> camera))
+            return false;
+        for(double &v : homography.h)
+            if(!(fields >> v))
+                return false;
+        homographies[camera]=homography;
+    }
+    return true;
+}
+
+void GroundLut::build(const Homography &homography, const cv::Size &frameSize, int step)
+{
+    PointLut::build(frameSize, step, [&](const cv::Point2f &p){ return homography.apply(p); });
+}
+
+TrackHandOff::TrackHandOff(float gate, float velocityGate)
+    : mGate(gate), mVelocityGate(velocityGate), mUpdate(0), mNextId(0), mHandOffs(0)
+{
+}
+
+int64_t TrackHandOff::cell(const cv::Point2f &p) const
+{
+    return cellKey((int64_t)floor(p.x/mGate), (int64_t)floor(p.y/mGate));
+}
+
+void TrackHandOff::update(int camera, int epoch, vector<WorldFeature> &features, double now, double frameSeconds)
+{
+    mUpdate++;
+    Tracks &live=mLive[camera];
+    float perSecond=1.f/(float)max(frameSeconds, 1e-3);
+
+    //a camera that stopped sending. its tracks all have the seen of its last update, and are older than
+    //HANDOFF_MEMORY by now, so rather than going to mLost to expire there they just go
+    for(auto other=mLive.begin(); other!=mLive.end(); )
+        if(other->first!=camera && (other->second.empty() || now-other->second.begin()->second.seen>HANDOFF_STALE))
+            other=mLive.erase(other);
+        else
+            ++other;
+
+    //tracks this camera already had
+    mNew.clear();
+    for(size_t i=0; i<features.size(); i++){
+        WorldFeature &f=features[i];
+        if(f.id==STREAM_CELL_ID || f.id==STREAM_FIELD_ID){ //cells aren't tracks
+            f.track=-1;
+            continue;
+        }
+        auto found=live.find(key(epoch, f.id));
+        if(found==live.end()){
+            f.track=-1; //until it is handed an id below
+            mNew.push_back((int)i);
+            continue;
+        }
+        Track &t=found->second;
+        t.position=f.position;
+        t.velocity=f.motion*perSecond;
+        t.seen=now;
+        t.updated=mUpdate;
+        f.track=t.global;
+    }
+
+    //the ones it didn't send are lost, and can still be handed on for a while
+    for(auto t=live.begin(); t!=live.end(); )
+        if(t->second.updated!=mUpdate){
+            mLost.push_back(t->second);
+            t=live.erase(t);
+        }
+        else
+            ++t;
+    size_t expired=0;
+    while(expired<mLost.size() && (now-mLost[expired].seen>HANDOFF_MEMORY || mLost.size()-expired>HANDOFF_MAX_LOST))
+        expired++;
+    mLost.erase(mLost.begin(), mLost.begin()+expired);
+
+    if(mNew.empty())
+        return;
+
+    //new tracks: each one's clear best candidate, then handed over cheapest first so a candidate
+    //goes to the new track nearest it rather than to whichever came first
+    buildIndex(camera, now);
+    mPairs.clear();
+    for(int i : mNew){
+        const WorldFeature &f=features[i];
+        float cost;
+        int candidate=match(f.position, f.motion*perSecond, cost);
+        if(candidate>=0)
+            mPairs.push_back({ cost, i, candidate });
+    }
+    sort(mPairs.begin(), mPairs.end());
+    for(const Pair &pair : mPairs){
+        Track *previous=mCandidates[pair.candidate].track;
+        auto at=lower_bound(mHeld.begin(), mHeld.end(), previous->global);
+        if(at!=mHeld.end() && *at==previous->global) //gone to a nearer new track already (or is live here)
+            continue;
+        mHeld.insert(at, previous->global);
+        previous->claimed=mUpdate;
+        features[pair.feature].track=previous->global;
+        mHandOffs++;
+    }
+
+    //and the rest start their own
+    for(int i : mNew){
+        WorldFeature &f=features[i];
+        Track t;
+        t.camera=camera;
+        t.position=f.position;
+        t.velocity=f.motion*perSecond;
+        t.seen=now;
+        t.updated=mUpdate;
+        t.claimed=0;
+        t.global= f.track>=0 ? f.track : (int)(mNextId++);
+        live[key(epoch, f.id)]=t;
+        f.track=t.global;
+    }
+
+    //a lost track whose id went to a new one is done
+    int update=mUpdate;
+    mLost.erase(remove_if(mLost.begin(), mLost.end(), [update](const Track &t){ return t.claimed==update; }), mLost.end());
+}
+
+void TrackHandOff::buildIndex(int camera, double now)
+{
+    //live tracks from the other cameras where they are, lost ones moved on by their velocity. the
+    //pointers stay valid until update() returns: only this camera's tracks and nothing in mLost change
+    //an id this camera already has on a live track is taken: handing it out again merges two tracks
+    mHeld.clear();
+    for(auto &t : mLive[camera])
+        mHeld.push_back(t.second.global);
+    sort(mHeld.begin(), mHeld.end());
+    auto held=[this](int global){ return binary_search(mHeld.begin(), mHeld.end(), global); };
+
+    mCandidates.clear();
+    for(auto &other : mLive)
+        if(other.first!=camera)
+            for(auto &t : other.second)
+                if(!held(t.second.global))
+                    mCandidates.push_back({ &t.second, t.second.position });
+    for(Track &t : mLost)
+        if(!held(t.global))
+            mCandidates.push_back({ &t, t.position+t.velocity*(float)(now-t.seen) });
+
+    mIndex.resize(mCandidates.size());
+    for(size_t k=0; k<mCandidates.size(); k++)
+        mIndex[k]=make_pair(cell(mCandidates[k].predicted), (int)k);
+    sort(mIndex.begin(), mIndex.end());
+}
+
+int TrackHandOff::match(const cv::Point2f &position, const cv::Point2f &velocity, float &cost) const
+{
+    int64_t cx=(int64_t)floor(position.x/mGate), cy=(int64_t)floor(position.y/mGate);
+    float gate2=mGate*mGate, velocityGate2=mVelocityGate*mVelocityGate;
+    int best=-1;
+    float bestCost=2, nextCost=2; //inside both gates is < 2
+    int looked=0;
+    for(int64_t dy=-1; dy<=1; dy++)
+        for(int64_t dx=-1; dx<=1; dx++){
+            auto range=equal_range(mIndex.begin(), mIndex.end(), make_pair(cellKey(cx+dx, cy+dy), -1),
+                                   [](const pair<int64_t, int> &a, const pair<int64_t, int> &b){ return a.first<b.first; });
+            for(auto k=range.first; k!=range.second && looked<HANDOFF_MAX_CANDIDATES; ++k, looked++){
+                const Candidate &candidate=mCandidates[k->second];
+                cv::Point2f d=position-candidate.predicted, dv=velocity-candidate.track->velocity;
+                float distance2=d.x*d.x+d.y*d.y, speed2=dv.x*dv.x+dv.y*dv.y;
+                if(distance2>=gate2 || speed2>=velocityGate2)
+                    continue;
+                //the runner up has to be another id: a live track and the same track lost by another
+                //camera can both be here, and either gives the same answer
+                float c=distance2/gate2+speed2/velocityGate2;
+                int global=candidate.track->global;
+                if(c<bestCost){
+                    if(best>=0 && mCandidates[best].track->global!=global)
+                        nextCost=bestCost;
+                    bestCost=c;
+                    best=k->second;
+                }
+                else if(c<nextCost && mCandidates[best].track->global!=global)
+                    nextCost=c;
+            }
+        }
+    if(best<0 || (nextCost<2 && bestCost>=HANDOFF_AMBIGUITY*nextCost)) //nothing, or two about as likely
+        return -1;
+    cost=bestCost;
+    return best;
+}
@@ -0,0 +1,136 @@
+//
+//  GroundPlane.hpp
+//  Project2
+//
+//  Cameras that watch neighbouring parts of the same floor, in one coordinate system. Every
+//  camera has a homography from its frame onto the ground plane (the homography file, see
+//  TrackStream.hpp); the aggregator maps each feature through a GroundLut built from it and hands
+//  the result to a TrackHandOff, which gives every track a global id that survives it moving from
+//  one camera to the next.
+//
+//      GroundLut      the homography evaluated once at every GROUND_LUT_STEP pixels of the frame
+//                     (PointLut.hpp). a point is then a bilinear lookup instead of a projective
+//                     divide, and the error over a step is far below a pixel for any sensible camera
+//      TrackHandOff   a track is (camera, epoch, feature id). a track seen for the first time is
+//                     compared with the tracks near it: live ones from the other cameras (the same
+//                     thing seen where views overlap) and ones lost in the last HANDOFF_MEMORY
+//                     seconds, moved on by their velocity (gone out of one view into the next, or
+//                     dropped when a camera re-detected). one inside both gates takes over that
+//                     track's id, otherwise it gets a new one. a camera that stops sending
+//                     leaves its live tracks frozen where they were; once it has been quiet for
+//                     HANDOFF_STALE they are dropped, so nothing inherits their ids
+//
+//  Features are corners, and a crowd of them is far denser than the gate, so matching is one to
+//  one: a candidate whose id this camera already has live is left out, each new track keeps only
+//  its best candidate and only when the next best costs at least 1/HANDOFF_AMBIGUITY as much (two
+//  candidates about as close could be either, and a wrong guess merges two tracks), and the pairs
+//  are then handed over cheapest first, each candidate once.
+//
+//  The candidates sit in a spatial hash of HANDOFF_GATE cells (a sorted array, rebuilt only on
+//  updates that bring new tracks), so a new track looks at the 3x3 cells around it and at most
+//  HANDOFF_MAX_CANDIDATES tracks. An update costs one lookup per feature plus that per new track,
+//  however many cameras there are.
+//
+//  World units are whatever the homographies map to; the gates assume metres.
+//
+
+#ifndef GroundPlane_hpp
+#define GroundPlane_hpp
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "PointLut.hpp"
+
+#define GROUND_LUT_STEP 8 //frame pixels between LUT nodes
+#define HANDOFF_GATE 0.5f //world units a new track may be from a candidate's (predicted) position
+#define HANDOFF_VELOCITY_GATE 1.0f //world units per second its velocity may differ by
+#define HANDOFF_MEMORY 1.0 //seconds a lost track can still be handed on
+#define HANDOFF_STALE 1.0 //seconds without an update before a camera's live tracks go (TrackStream's STREAM_STALE_SECONDS is this)
+#define HANDOFF_MAX_LOST 4096 //lost tracks kept at most, oldest go first
+#define HANDOFF_MAX_CANDIDATES 1024 //tracks one new track is compared with at most (a crowd 0.1 m apart has about 225 in reach)
+#define HANDOFF_AMBIGUITY 0.5f //the best candidate's cost must be under this fraction of the next best's
+
+//frame pixels -> world, for one camera
+struct Homography {
+    double  h[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 }; //row major
+
+    cv::Point2f apply(const cv::Point2f &p) const;
+};
+
+//reads a homography file (see TrackStream.hpp). false if it can't be read or a line doesn't parse
+bool loadHomographies(const std::string &path, std::map<int, Homography> &homographies);
+
+//a homography sampled on a grid over one frame size
+class GroundLut : public PointLut {
+public:
+    void build(const Homography &homography, const cv::Size &frameSize, int step = GROUND_LUT_STEP);
+};
+
+#define STREAM_CELL_ID 65535 //WorldFeature::id of a fired grid cell rather than a feature
+#define STREAM_FIELD_ID 65534 //WorldFeature::id of a flow field cell (FlowField.hpp)
+
+//a feature from some camera, in world coordinates
+struct WorldFeature {
+    int             camera;
+    int             id; //index since that camera's last detection, STREAM_CELL_ID for a fired grid cell or STREAM_FIELD_ID for a flow field cell
+    int             track; //global id from TrackHandOff, -1 for cells of either kind
+    cv::Point2f     position; //world units
+    cv::Point2f     motion; //world units per tracked frame
+};
+
+class TrackHandOff {
+public:
+    TrackHandOff(float gate = HANDOFF_GATE, float velocityGate = HANDOFF_VELOCITY_GATE);
+
+    //one complete frame from camera. features are that camera's, in the world; fills in their track.
+    //frameSeconds is how long that camera's frames are apart, to turn motion into a velocity
+    void update(int camera, int epoch, std::vector<WorldFeature> &features, double now, double frameSeconds);
+
+    long long getHandOffs() const { return mHandOffs; } //new tracks that took over an existing id
+    long long getTracks() const { return mNextId; } //ids given out
+
+private:
+    struct Track {
+        int             camera, global;
+        cv::Point2f     position, velocity; //world units, velocity per second
+        double          seen; //when it was last updated
+        int             updated; //update it was last seen in
+        int             claimed; //update that last gave its id away, so one id goes to one new track per frame
+    };
+    struct Candidate {
+        Track           *track;
+        cv::Point2f     predicted; //where it should be now
+    };
+    struct Pair {
+        float           cost;
+        int             feature, candidate; //index into features, into mCandidates
+        bool operator<(const Pair &other) const { return cost<other.cost; }
+    };
+    typedef std::unordered_map<uint64_t, Track> Tracks; //one camera's live tracks, by (epoch, feature id)
+
+    static uint64_t key(int epoch, int id) { return (uint64_t)(uint32_t)epoch << 16 | (uint16_t)id; }
+    static int64_t cellKey(int64_t x, int64_t y) { return (int64_t)((uint64_t)x << 32 ^ (uint32_t)y); }
+    int64_t cell(const cv::Point2f &p) const; //the spatial hash cell p is in
+    void buildIndex(int camera, double now);
+    //the candidate inside both gates that is clearly the closest (see above), or -1
+    int match(const cv::Point2f &position, const cv::Point2f &velocity, float &cost) const;
+
+    float                                   mGate, mVelocityGate;
+    std::map<int, Tracks>                   mLive; //by camera
+    std::vector<Track>                      mLost; //oldest first
+    std::vector<int>                        mNew; //features that started a track this update, reused
+
+    std::vector<Candidate>                  mCandidates; //what new tracks are compared with, reused
+    std::vector<std::pair<int64_t, int>>    mIndex; //(cell, candidate), sorted
+    std::vector<int>                        mHeld; //global ids live on the camera being updated, sorted
+    std::vector<Pair>                       mPairs; //new tracks and their best candidates, reused
+    int                                     mUpdate;
+    long long                               mNextId, mHandOffs;
+};
+
+#endif /* GroundPlane_hpp */
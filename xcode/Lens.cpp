@@ -0,0 +1,69 @@
+//
+//  Lens.cpp
+//  Project2
+//
+
+#include "Lens.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+cv::Point2f LensCalibration::undistort(const cv::Point2f &p) const
+{
+    //as cv::undistortPoints: guess the ideal point is the distorted one, then keep taking the
+    //distortion at the guess back off the measured point
+    double x0=(p.x-cx)/fx, y0=(p.y-cy)/fy, x=x0, y=y0;
+    for(int k=0; k<LENS_ITERATIONS; k++){
+        double r2=x*x+y*y;
+        double radial=1+((k3*r2+k2)*r2+k1)*r2;
+        double dx=2*p1*x*y+p2*(r2+2*x*x), dy=p1*(r2+2*y*y)+2*p2*x*y;
+        x=(x0-dx)/radial;
+        y=(y0-dy)/radial;
+    }
+    return cv::Point2f((float)(x*fx+cx), (float)(y*fy+cy));
+}
+
+bool loadLensCalibration(const string &path, LensCalibration &calibration)
+{
+    ifstream in(path);
+    string line;
+    while(getline(in, line)){
+        size_t start=line.find_first_not_of(" \t\r");
+        if(start==string::npos || line[start]=='#')
+            continue;
+        istringstream fields(line);
+        LensCalibration read;
+        if(!(fields >> read.fx >> read.fy >> read.cx >> read.cy >> read.k1 >> read.k2 >> read.p1 >> read.p2 >> read.k3))
+            return false;
+        calibration=read;
+        return true;
+    }
+    return false;
+}
+
+void LensLut::build(const LensCalibration &calibration, const cv::Size &frameSize, int step)
+{
+    PointLut::build(frameSize, step, [&](const cv::Point2f &p){ return calibration.undistort(p); });
+
+    //barrel distortion pushes the undistorted edges out past the frame: shrink about the principal
+    //point until the outermost node is back on the edge (all of the picture kept, like alpha 1 in
+    //cv::getOptimalNewCameraMatrix)
+    float cx=(float)calibration.cx, cy=(float)calibration.cy, w=(float)frameSize.width, h=(float)frameSize.height;
+    float scale=1;
+    for(const cv::Point2f &p : mNodes){
+        if(p.x<0 && cx>0)
+            scale=min(scale, cx/(cx-p.x));
+        if(p.x>w && w>cx)
+            scale=min(scale, (w-cx)/(p.x-cx));
+        if(p.y<0 && cy>0)
+            scale=min(scale, cy/(cy-p.y));
+        if(p.y>h && h>cy)
+            scale=min(scale, (h-cy)/(p.y-cy));
+    }
+    for(cv::Point2f &p : mNodes)
+        p=cv::Point2f(cx+(p.x-cx)*scale, cy+(p.y-cy)*scale);
+    mScale=scale;
+}
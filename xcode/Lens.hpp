@@ -0,0 +1,56 @@
+//
+//  Lens.hpp
+//  Project2
+//
+//  Lens undistortion for points only (--lens calibration.txt). Wide lenses squash motion near the
+//  edges of the frame, so the same walk reads slower there and the ground plane homographies
+//  don't hold. Remapping whole frames would fix that at a cost per pixel; instead the frame is
+//  tracked as it comes and only what gets measured is corrected: the motion that goes into the flow
+//  field, and the features and grid cells that go out on the stream. What gets drawn stays where it
+//  was tracked, so it lines up with the picture.
+//
+//  The calibration is OpenCV's model: focal lengths, principal point and k1 k2 p1 p2 k3. The
+//  inverse has no closed form, so LensLut runs the usual fixed point iteration once per node
+//  (every LENS_LUT_STEP pixels) and each point after that is a bilinear lookup (PointLut.hpp).
+//  Undistorted points are scaled about the principal point so the whole frame still fits inside
+//  frameSize; everything downstream keeps its bounds. getScale() is that shrink, so a distance
+//  between two mapped points divided by it is back in pixels at the calibration's focal length.
+//
+//  Calibration files hold the nine numbers on one line, fx fy cx cy k1 k2 p1 p2 k3, as they
+//  come out of cv::calibrateCamera. Lines starting with # are skipped.
+//
+
+#ifndef Lens_hpp
+#define Lens_hpp
+
+#include <string>
+#include <opencv2/core/core.hpp>
+
+#include "PointLut.hpp"
+
+#define LENS_LUT_STEP 8 //frame pixels between LUT nodes
+#define LENS_ITERATIONS 20 //fixed point iterations per node for the inverse
+
+struct LensCalibration {
+    double  fx = 1, fy = 1, cx = 0, cy = 0; //pixels, at the size frames are tracked at
+    double  k1 = 0, k2 = 0, p1 = 0, p2 = 0, k3 = 0;
+
+    cv::Point2f undistort(const cv::Point2f &p) const; //distorted frame pixel -> where a pinhole camera would have seen it
+};
+
+//false if path can't be read or doesn't hold nine numbers
+bool loadLensCalibration(const std::string &path, LensCalibration &calibration);
+
+//distorted frame pixels -> undistorted frame pixels, for one frame size
+class LensLut : public PointLut {
+public:
+    //calibration has to be for frames of frameSize
+    void build(const LensCalibration &calibration, const cv::Size &frameSize, int step = LENS_LUT_STEP);
+
+    float getScale() const { return mScale; } //how much the undistorted points were shrunk to fit, 1 when they weren't
+
+private:
+    float   mScale = 1;
+};
+
+#endif /* Lens_hpp */
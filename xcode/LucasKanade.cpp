@@ -0,0 +1,498 @@
+//
+//  LucasKanade.cpp
+//  Project2
+//
+
+#include "LucasKanade.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <random>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#if defined( __SSE2__ )
+    #include <emmintrin.h>
+    #define LK_PATH "SSE2"
+#else
+    #define LK_PATH "scalar"
+#endif
+
+#include "cinder/Log.h"
+#include "MemoryTags.hpp"
+#include "SyntheticSource.hpp"
+
+using namespace std;
+
+#define LK_W_BITS 14 //bilinear weights are 14 bit fixed point
+#define LK_FLT_SCALE (1.f/(1 << 20)) //undoes the x32 intensity and x32 gradient scale in the sums
+#define LK_DESCALE(x, n) (((x) + (1 << ((n)-1))) >> (n))
+#define LK_POINTS_PER_STRIPE 64 //below this a stripe isn't worth a thread
+
+const char* lucasKanadePath()
+{
+    return LK_PATH;
+}
+
+static inline void scharrRow(const uint8_t *r0, const uint8_t *r1, const uint8_t *r2, int16_t *dx, int16_t *dy, int width)
+{
+    //3x3 Scharr, unnormalised, same as OpenCV's LK uses. first and last column have no neighbours and stay 0
+    dx[0]=dy[0]=dx[width-1]=dy[width-1]=0;
+    for(int x=1; x<width-1; x++){
+        dx[x]=(int16_t)((r0[x+1]-r0[x-1]+r2[x+1]-r2[x-1])*3 + (r1[x+1]-r1[x-1])*10);
+        dy[x]=(int16_t)((r2[x-1]+r2[x+1]-r0[x-1]-r0[x+1])*3 + (r2[x]-r0[x])*10);
+    }
+}
+
+//level buffers count against MEMORY_PYRAMIDS. only matters when a level is (re)allocated
+static void tagLevels(vector<cv::Mat> &levels)
+{
+    for(cv::Mat &level : levels)
+        level.allocator=memoryTagAllocator(MEMORY_PYRAMIDS);
+}
+
+void LKPyramid::allocate(const cv::Size &size, int maxLevel, int border)
+{
+    mBorder=border;
+    mSizes.resize(maxLevel+1);
+    mImages.resize(maxLevel+1);
+    mDx.resize(maxLevel+1);
+    mDy.resize(maxLevel+1);
+    tagLevels(mImages);
+    tagLevels(mDx);
+    tagLevels(mDy);
+    for(int level=0; level<=maxLevel; level++){
+        mSizes[level]= level==0 ? size : cv::Size((mSizes[level-1].width+1)/2, (mSizes[level-1].height+1)/2); //pyrDown's default size
+        cv::Size padded(mSizes[level].width+2*border, mSizes[level].height+2*border);
+        mImages[level].create(padded, CV_8UC1); //no-ops when the frame size doesn't change
+        mDx[level].create(padded, CV_16SC1);
+        mDy[level].create(padded, CV_16SC1);
+    }
+}
+
+void LKPyramid::build(const cv::Mat &gray, int maxLevel, int border)
+{
+    CV_Assert(gray.type()==CV_8UC1 && border >= 2);
+
+    //reflecting a border in place needs every level to be taller and wider than the border
+    cv::Size top(gray.cols, gray.rows);
+    for(int level=0; level<maxLevel; level++)
+        top=cv::Size((top.width+1)/2, (top.height+1)/2);
+    if(top.width <= border || top.height <= border){
+        buildSeparate(gray, maxLevel, border);
+        return;
+    }
+
+    allocate(gray.size(), maxLevel, border);
+    mRowsWritten.assign(maxLevel+1, 0);
+    mNextDerivative.assign(maxLevel+1, -border+1);
+    mFinished.assign(maxLevel+1, false);
+
+    for(int y=0; y<gray.rows; y++){
+        memcpy(mImages[0].ptr<uint8_t>(y+border)+border, gray.ptr<uint8_t>(y), gray.cols);
+        rowWritten(0, y); //everything that can be made from this row is made now
+    }
+    for(int level=0; level<=maxLevel; level++)
+        finishLevel(level);
+}
+
+bool LKPyramid::available(int level, int y) const
+{
+    if(y < 0)
+        return -y < mRowsWritten[level]; //top border rows are copies of rows 1..border
+    if(y < mSizes[level].height)
+        return y < mRowsWritten[level];
+    return mFinished[level];
+}
+
+void LKPyramid::rowWritten(int level, int y)
+{
+    int width=mSizes[level].width, border=mBorder;
+    uint8_t *row=mImages[level].ptr<uint8_t>(y+border)+border;
+    for(int k=1; k<=border; k++){ //BORDER_REFLECT_101 left and right
+        row[-k]=row[k];
+        row[width-1+k]=row[width-1-k];
+    }
+    if(y >= 1 && y <= border) //and this row is also a top border row
+        memcpy(mImages[level].ptr<uint8_t>(border-y), row-border, width+2*border);
+    mRowsWritten[level]=y+1;
+
+    advanceDerivatives(level);
+
+    //a pyrDown row needs source rows 2y-2..2y+2
+    if(level+1 < (int)mImages.size())
+        while(mRowsWritten[level+1] < mSizes[level+1].height && 2*mRowsWritten[level+1]+2 <= y){
+            int next=mRowsWritten[level+1];
+            downsampleRow(level, next);
+            rowWritten(level+1, next);
+        }
+}
+
+void LKPyramid::finishLevel(int level)
+{
+    int height=mSizes[level].height, border=mBorder, stride=mSizes[level].width+2*border;
+    for(int k=1; k<=border; k++) //BORDER_REFLECT_101 bottom
+        memcpy(mImages[level].ptr<uint8_t>(height-1+k+border), mImages[level].ptr<uint8_t>(height-1-k+border), stride);
+    mFinished[level]=true;
+    advanceDerivatives(level);
+
+    if(level+1 < (int)mImages.size())
+        while(mRowsWritten[level+1] < mSizes[level+1].height){
+            int next=mRowsWritten[level+1];
+            downsampleRow(level, next);
+            rowWritten(level+1, next);
+        }
+}
+
+void LKPyramid::advanceDerivatives(int level)
+{
+    int border=mBorder, last=mSizes[level].height+border-2, stride=mSizes[level].width+2*border;
+    const cv::Mat &img=mImages[level];
+    int &y=mNextDerivative[level];
+    if(y==-border+1){ //outermost ring has no neighbours; windows never reach it
+        memset(mDx[level].ptr<int16_t>(0), 0, stride*sizeof(int16_t));
+        memset(mDy[level].ptr<int16_t>(0), 0, stride*sizeof(int16_t));
+        memset(mDx[level].ptr<int16_t>(img.rows-1), 0, stride*sizeof(int16_t));
+        memset(mDy[level].ptr<int16_t>(img.rows-1), 0, stride*sizeof(int16_t));
+    }
+    for(; y<=last && available(level, y-1) && available(level, y+1); y++){
+        int p=y+border;
+        scharrRow(img.ptr<uint8_t>(p-1), img.ptr<uint8_t>(p), img.ptr<uint8_t>(p+1),
+                  mDx[level].ptr<int16_t>(p), mDy[level].ptr<int16_t>(p), stride);
+    }
+}
+
+void LKPyramid::downsampleRow(int level, int y)
+{
+    //5x5 gaussian (1 4 6 4 1)^2/256, exactly what pyrDown does. the source border is already
+    //reflected, so columns -2..2w and rows 2y-2..2y+2 can be read directly
+    int width=mSizes[level+1].width, border=mBorder;
+    const uint8_t *r0=mImages[level].ptr<uint8_t>(2*y-2+border)+border, *r1=mImages[level].ptr<uint8_t>(2*y-1+border)+border,
+                  *r2=mImages[level].ptr<uint8_t>(2*y+border)+border, *r3=mImages[level].ptr<uint8_t>(2*y+1+border)+border,
+                  *r4=mImages[level].ptr<uint8_t>(2*y+2+border)+border;
+    mColumnSums.resize(2*width+3);
+    int *sums=mColumnSums.data()+2; //sums[-2..2w]
+    for(int x=-2; x<=2*width; x++)
+        sums[x]=r0[x]+r4[x]+(r1[x]+r3[x])*4+r2[x]*6;
+
+    uint8_t *dst=mImages[level+1].ptr<uint8_t>(y+border)+border;
+    for(int x=0; x<width; x++){
+        const int *s=sums+2*x;
+        dst[x]=(uint8_t)((s[-2]+s[2]+(s[-1]+s[1])*4+s[0]*6+128) >> 8);
+    }
+}
+
+void LKPyramid::buildSeparate(const cv::Mat &gray, int maxLevel, int border)
+{
+    CV_Assert(gray.type()==CV_8UC1);
+    mBorder=border;
+    mSizes.resize(maxLevel+1);
+    mImages.resize(maxLevel+1);
+    mDx.resize(maxLevel+1);
+    mDy.resize(maxLevel+1);
+    tagLevels(mImages);
+    tagLevels(mDx);
+    tagLevels(mDy);
+
+    for(int level=0; level<=maxLevel; level++){
+        if(level==0)
+            mDown=gray;
+        else{ //downsample the unpadded part of the level below
+            cv::Size below=mSizes[level-1];
+            mDown.allocator=memoryTagAllocator(MEMORY_PYRAMIDS); //not the frame's, which level 0 left here
+            cv::pyrDown(mImages[level-1](cv::Rect(border, border, below.width, below.height)), mDown);
+        }
+        mSizes[level]=mDown.size();
+        cv::copyMakeBorder(mDown, mImages[level], border, border, border, border, cv::BORDER_REFLECT_101); //reuses the buffer when the size is unchanged
+    }
+    computeDerivatives();
+}
+
+void LKPyramid::computeDerivatives()
+{
+    for(size_t level=0; level<mImages.size(); level++){
+        const cv::Mat &img=mImages[level];
+        mDx[level].create(img.size(), CV_16SC1);
+        mDy[level].create(img.size(), CV_16SC1);
+        mDx[level].row(0).setTo(0); //outermost ring has no neighbours; windows never reach it
+        mDy[level].row(0).setTo(0);
+        mDx[level].row(img.rows-1).setTo(0);
+        mDy[level].row(img.rows-1).setTo(0);
+        for(int y=1; y<img.rows-1; y++)
+            scharrRow(img.ptr<uint8_t>(y-1), img.ptr<uint8_t>(y), img.ptr<uint8_t>(y+1),
+                      mDx[level].ptr<int16_t>(y), mDy[level].ptr<int16_t>(y), img.cols);
+    }
+}
+
+//sum over one window row of (J - I)*Ix and (J - I)*Iy, with J bilinearly sampled from rows j0/j1
+static inline void mismatchRow(const uint8_t *j0, const uint8_t *j1, const int16_t *I, const int16_t *Ix,
+                               const int16_t *Iy, int width, int iw00, int iw01, int iw10, int iw11,
+                               int &b1, int &b2)
+{
+    int x=0;
+    int sum1=0, sum2=0;
+#if defined( __SSE2__ )
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i w0=_mm_set1_epi32(iw00 | (iw01 << 16)), w1=_mm_set1_epi32(iw10 | (iw11 << 16)); //(left, right) weight pairs for madd
+    const __m128i round=_mm_set1_epi32(1 << (LK_W_BITS-5-1));
+    __m128i acc1=zero, acc2=zero;
+    for(; x+8<=width; x+=8){
+        __m128i a=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(j0+x)), zero);
+        __m128i b=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(j0+x+1)), zero);
+        __m128i c=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(j1+x)), zero);
+        __m128i d=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(j1+x+1)), zero);
+
+        __m128i lo=_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), w0), _mm_madd_epi16(_mm_unpacklo_epi16(c, d), w1));
+        __m128i hi=_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), w0), _mm_madd_epi16(_mm_unpackhi_epi16(c, d), w1));
+        lo=_mm_srai_epi32(_mm_add_epi32(lo, round), LK_W_BITS-5);
+        hi=_mm_srai_epi32(_mm_add_epi32(hi, round), LK_W_BITS-5);
+
+        __m128i diff=_mm_sub_epi16(_mm_packs_epi32(lo, hi), _mm_loadu_si128((const __m128i*)(I+x)));
+        acc1=_mm_add_epi32(acc1, _mm_madd_epi16(diff, _mm_loadu_si128((const __m128i*)(Ix+x))));
+        acc2=_mm_add_epi32(acc2, _mm_madd_epi16(diff, _mm_loadu_si128((const __m128i*)(Iy+x))));
+    }
+    acc1=_mm_add_epi32(acc1, _mm_shuffle_epi32(acc1, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc1=_mm_add_epi32(acc1, _mm_shuffle_epi32(acc1, _MM_SHUFFLE(2, 3, 0, 1)));
+    acc2=_mm_add_epi32(acc2, _mm_shuffle_epi32(acc2, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc2=_mm_add_epi32(acc2, _mm_shuffle_epi32(acc2, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum1=_mm_cvtsi128_si32(acc1);
+    sum2=_mm_cvtsi128_si32(acc2);
+#endif
+    for(; x<width; x++){ //same integer maths as above, so both paths give identical results
+        int J=LK_DESCALE(j0[x]*iw00 + j0[x+1]*iw01 + j1[x]*iw10 + j1[x+1]*iw11, LK_W_BITS-5);
+        int diff=J-I[x];
+        sum1+=diff*Ix[x];
+        sum2+=diff*Iy[x];
+    }
+    b1=sum1;
+    b2=sum2;
+}
+
+static inline void bilinearWeights(float x, float y, int &iw00, int &iw01, int &iw10, int &iw11)
+{
+    float a=x-floor(x), b=y-floor(y);
+    iw00=cvRound((1.f-a)*(1.f-b)*(1 << LK_W_BITS));
+    iw01=cvRound(a*(1.f-b)*(1 << LK_W_BITS));
+    iw10=cvRound((1.f-a)*b*(1 << LK_W_BITS));
+    iw11=(1 << LK_W_BITS)-iw00-iw01-iw10;
+}
+
+void FixedPointLK::trackPoint(const LKPyramid &prev, const LKPyramid &next, const cv::Point2f &prevPt,
+                              cv::Point2f &nextPt, uint8_t &status, Scratch &scratch) const
+{
+    const int win=mSettings.winSize;
+    const float halfWin=(win-1)*0.5f;
+    const float eps2=mSettings.epsilon*mSettings.epsilon;
+    int16_t *patch=scratch.patch.data(), *gx=scratch.gx.data(), *gy=scratch.gy.data();
+
+    status=1;
+    cv::Point2f nextCentre;
+    for(int level=mSettings.maxLevel; level>=0; level--){
+        cv::Size size=prev.getSize(level);
+        cv::Point2f prevCentre=prevPt*(1.f/(1 << level));
+        nextCentre= level==mSettings.maxLevel ? prevCentre : nextCentre*2.f; //start from the coarser level's answer
+
+        //top-left corner of the window
+        float px=prevCentre.x-halfWin, py=prevCentre.y-halfWin;
+        int ipx=(int)floor(px), ipy=(int)floor(py);
+        if(ipx < -win || ipx >= size.width || ipy < -win || ipy >= size.height){
+            if(level==0)
+                status=0;
+            continue;
+        }
+
+        //sample the window and its gradients once, and build the 2x2 normal matrix
+        int iw00, iw01, iw10, iw11;
+        bilinearWeights(px, py, iw00, iw01, iw10, iw11);
+        float A11=0, A12=0, A22=0;
+        for(int y=0; y<win; y++){
+            const uint8_t *s0=prev.image(level, ipx, ipy+y), *s1=prev.image(level, ipx, ipy+y+1);
+            const int16_t *dx0=prev.dx(level, ipx, ipy+y), *dx1=prev.dx(level, ipx, ipy+y+1);
+            const int16_t *dy0=prev.dy(level, ipx, ipy+y), *dy1=prev.dy(level, ipx, ipy+y+1);
+            int16_t *I=patch+y*win, *Ix=gx+y*win, *Iy=gy+y*win;
+            int a11=0, a12=0, a22=0;
+            for(int x=0; x<win; x++){
+                I[x]=(int16_t)LK_DESCALE(s0[x]*iw00 + s0[x+1]*iw01 + s1[x]*iw10 + s1[x+1]*iw11, LK_W_BITS-5);
+                Ix[x]=(int16_t)LK_DESCALE(dx0[x]*iw00 + dx0[x+1]*iw01 + dx1[x]*iw10 + dx1[x+1]*iw11, LK_W_BITS);
+                Iy[x]=(int16_t)LK_DESCALE(dy0[x]*iw00 + dy0[x+1]*iw01 + dy1[x]*iw10 + dy1[x+1]*iw11, LK_W_BITS);
+                a11+=Ix[x]*Ix[x];
+                a12+=Ix[x]*Iy[x];
+                a22+=Iy[x]*Iy[x];
+            }
+            A11+=a11;
+            A12+=a12;
+            A22+=a22;
+        }
+        A11*=LK_FLT_SCALE;
+        A12*=LK_FLT_SCALE;
+        A22*=LK_FLT_SCALE;
+
+        float D=A11*A22-A12*A12;
+        float minEig=(A22+A11-sqrt((A11-A22)*(A11-A22)+4.f*A12*A12))/(2*win*win);
+        if(minEig < mSettings.minEigThreshold || D < FLT_EPSILON){ //flat or edge-only window
+            if(level==0)
+                status=0;
+            continue;
+        }
+        D=1.f/D;
+
+        float nx=nextCentre.x-halfWin, ny=nextCentre.y-halfWin;
+        cv::Point2f prevDelta(0, 0);
+        for(int j=0; j<mSettings.maxIterations; j++){
+            int inx=(int)floor(nx), iny=(int)floor(ny);
+            if(inx < -win || inx >= size.width || iny < -win || iny >= size.height){
+                if(level==0)
+                    status=0;
+                break;
+            }
+
+            bilinearWeights(nx, ny, iw00, iw01, iw10, iw11);
+            int64_t b1=0, b2=0;
+            for(int y=0; y<win; y++){
+                int r1, r2;
+                mismatchRow(next.image(level, inx, iny+y), next.image(level, inx, iny+y+1), patch+y*win, gx+y*win,
+                            gy+y*win, win, iw00, iw01, iw10, iw11, r1, r2);
+                b1+=r1;
+                b2+=r2;
+            }
+            float fb1=b1*LK_FLT_SCALE, fb2=b2*LK_FLT_SCALE;
+
+            cv::Point2f delta((A12*fb2-A22*fb1)*D, (A12*fb1-A11*fb2)*D);
+            nx+=delta.x;
+            ny+=delta.y;
+            if(delta.ddot(delta) <= eps2)
+                break;
+            if(j > 0 && fabs(delta.x+prevDelta.x) < 0.01f && fabs(delta.y+prevDelta.y) < 0.01f){ //bouncing between two spots, settle in the middle
+                nx-=delta.x*0.5f;
+                ny-=delta.y*0.5f;
+                break;
+            }
+            prevDelta=delta;
+        }
+        nextCentre=cv::Point2f(nx+halfWin, ny+halfWin);
+    }
+    nextPt=nextCentre;
+}
+
+void FixedPointLK::track(const LKPyramid &prev, const LKPyramid &next, const vector<cv::Point2f> &prevPts,
+                         vector<cv::Point2f> &nextPts, vector<uint8_t> &status)
+{
+    CV_Assert(mSettings.winSize >= 3 && mSettings.winSize <= 61);
+    CV_Assert(prev.getLevels() > mSettings.maxLevel && next.getLevels() > mSettings.maxLevel);
+    CV_Assert(prev.getBorder() > mSettings.winSize && next.getBorder() > mSettings.winSize);
+
+    int count=(int)prevPts.size();
+    nextPts.resize(count);
+    status.resize(count);
+    if(count==0)
+        return;
+
+    int stripes=max(1, min(cv::getNumThreads(), (count+LK_POINTS_PER_STRIPE-1)/LK_POINTS_PER_STRIPE));
+    if((int)mScratch.size() < stripes)
+        mScratch.resize(stripes);
+    size_t area=(size_t)mSettings.winSize*mSettings.winSize;
+    for(auto &scratch : mScratch){ //only allocates when the window size changes
+        scratch.patch.resize(area);
+        scratch.gx.resize(area);
+        scratch.gy.resize(area);
+    }
+
+    cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range &range){
+        for(int s=range.start; s<range.end; s++){
+            Scratch &scratch=mScratch[s];
+            int end=(int)((int64_t)count*(s+1)/stripes);
+            for(int i=(int)((int64_t)count*s/stripes); i<end; i++)
+                trackPoint(prev, next, prevPts[i], nextPts[i], status[i], scratch);
+        }
+    });
+}
+
+void benchmarkPyramid(int width, int height, int maxLevel, int iterations)
+{
+    cv::Mat frame(height, width, CV_8UC1);
+    cv::randu(frame, 0, 256);
+    int border=LKSettings().winSize+1;
+    LKPyramid fused, separate;
+
+    auto start=chrono::steady_clock::now();
+    for(int k=0; k<iterations; k++)
+        separate.buildSeparate(frame, maxLevel, border);
+    double separateMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/iterations;
+    start=chrono::steady_clock::now();
+    for(int k=0; k<iterations; k++)
+        fused.build(frame, maxLevel, border);
+    double fusedMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/iterations;
+
+    //every padded pixel and derivative should match, borders included
+    int mismatches=0;
+    for(int level=0; level<=maxLevel; level++){
+        cv::Size size=fused.getSize(level);
+        for(int y=-border; y<size.height+border; y++)
+            for(int x=-border; x<size.width+border; x++)
+                if(*fused.image(level, x, y)!=*separate.image(level, x, y) || *fused.dx(level, x, y)!=*separate.dx(level, x, y)
+                   || *fused.dy(level, x, y)!=*separate.dy(level, x, y))
+                    mismatches++;
+    }
+
+    CI_LOG_I( "pyramid @ " << width << "x" << height << ", " << maxLevel+1 << " levels: separate passes " << separateMs
+             << " ms, streaming " << fusedMs << " ms (" << separateMs/fusedMs << "x), " << mismatches << " mismatched pixels" );
+}
+
+void benchmarkLK(int width, int height)
+{
+    SyntheticSource source(width, height);
+    cv::Mat frame0, frame1;
+    source.next(frame0);
+    source.next(frame1);
+
+    LKSettings settings;
+    FixedPointLK lk;
+    lk.setSettings(settings);
+    LKPyramid pyramid0, pyramid1;
+
+    mt19937 rng(1);
+    uniform_real_distribution<float> xs(0, (float)width), ys(0, (float)height);
+
+    int counts[]={1000, 2500, 5000, 10000};
+    for(int count : counts){
+        vector<cv::Point2f> points(count);
+        for(auto &p : points)
+            p=cv::Point2f(xs(rng), ys(rng));
+
+        vector<cv::Point2f> theirs, ours;
+        vector<uint8_t> theirStatus, ourStatus;
+        vector<float> errors;
+
+        auto start=chrono::steady_clock::now();
+        cv::calcOpticalFlowPyrLK(frame0, frame1, points, theirs, theirStatus, errors,
+                                 cv::Size(settings.winSize, settings.winSize), settings.maxLevel);
+        double opencvMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+
+        start=chrono::steady_clock::now();
+        pyramid0.build(frame0, settings.maxLevel, settings.winSize+1);
+        pyramid1.build(frame1, settings.maxLevel, settings.winSize+1);
+        double pyramidMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+        start=chrono::steady_clock::now();
+        lk.track(pyramid0, pyramid1, points, ours, ourStatus);
+        double trackMs=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count();
+
+        int agree=0, both=0;
+        double difference=0;
+        for(int i=0; i<count; i++){
+            if((theirStatus[i]!=0)==(ourStatus[i]!=0))
+                agree++;
+            if(theirStatus[i] && ourStatus[i]){
+                both++;
+                difference+=cv::norm(theirs[i]-ours[i]);
+            }
+        }
+
+        CI_LOG_I( "LK " << count << " points @ " << width << "x" << height << " (" << LK_PATH << "): opencv " << opencvMs
+                 << " ms, fixed point " << pyramidMs+trackMs << " ms (pyramids " << pyramidMs << ", track " << trackMs << ", "
+                 << opencvMs/(pyramidMs+trackMs) << "x), status agreement " << 100.0*agree/count << "%, mean difference "
+                 << (both ? difference/both : 0) << " px" );
+    }
+}
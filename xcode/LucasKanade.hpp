@@ -0,0 +1,113 @@
+//
+//  LucasKanade.hpp
+//  Project2
+//
+//  Integer pyramidal Lucas-Kanade, an alternative to cv::calcOpticalFlowPyrLK.
+//
+//  Same method and the same fixed-point scaling OpenCV uses internally (14 bit bilinear
+//  weights, intensities x32, int16 Scharr gradients) so results line up, but organised for
+//  lots of points:
+//
+//      - the window patch and its gradients are sampled once per point per level
+//      - each iteration samples the next frame and multiply-accumulates diff*Ix, diff*Iy
+//        eight pixels at a time with SSE2 madd (plain loops on other targets)
+//      - iterations stop as soon as the step is below epsilon, or starts oscillating
+//      - patch buffers are allocated once per stripe and reused every frame
+//      - points are split into stripes and run with cv::parallel_for_
+//
+//  Pyramids are built once per frame and reused as the previous pyramid on the next frame.
+//  build() makes every level in one streaming pass over the frame: as each row lands in a
+//  level its border is reflected in place, its Scharr row is computed, and as soon as a level
+//  has the five rows a pyrDown row needs, that row is made and pushed into the next level. Rows
+//  are touched while they are still in cache instead of in one full pass per level per step.
+//
+
+#ifndef LucasKanade_hpp
+#define LucasKanade_hpp
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+struct LKSettings {
+    int      winSize = 21; //window is winSize x winSize, at most 61 so row sums fit in 32 bits
+    int      maxLevel = 3; //pyramid levels above the frame
+    int      maxIterations = 30;
+    float    epsilon = 0.01f; //stop when a step is smaller than this (pixels)
+    float    minEigThreshold = 1e-4f; //give up on flat windows, same meaning as in OpenCV
+};
+
+//one frame's pyramid. every level is padded by border pixels (BORDER_REFLECT_101) so windows
+//that hang off the edge can be read without bounds checks, and has int16 Scharr dx/dy
+class LKPyramid {
+public:
+    LKPyramid() : mBorder(0) {}
+
+    void build(const cv::Mat &gray, int maxLevel, int border); //streaming, see above
+    //pyrDown + copyMakeBorder + derivatives as separate full passes. build() falls back to this
+    //when a level is too small to reflect a border off; also used to check build() against
+    void buildSeparate(const cv::Mat &gray, int maxLevel, int border);
+
+    int getLevels() const { return (int)mImages.size(); }
+    int getBorder() const { return mBorder; }
+    cv::Size getSize(int level) const { return mSizes[level]; }
+
+    //pointer to pixel (x, y) of a level; x and y may be negative down to -border
+    const uint8_t* image(int level, int x, int y) const { return mImages[level].ptr<uint8_t>(y+mBorder)+x+mBorder; }
+    const int16_t* dx(int level, int x, int y) const { return mDx[level].ptr<int16_t>(y+mBorder)+x+mBorder; }
+    const int16_t* dy(int level, int x, int y) const { return mDy[level].ptr<int16_t>(y+mBorder)+x+mBorder; }
+
+private:
+    void computeDerivatives(); //fills dx/dy from the padded images
+    void allocate(const cv::Size &size, int maxLevel, int border);
+
+    //streaming build
+    bool available(int level, int y) const; //padded row y (-border..h+border-1) is filled in
+    void rowWritten(int level, int y); //reflects the row's border and pushes work down the pyramid
+    void finishLevel(int level); //bottom border, last derivative rows, last rows of the level below
+    void advanceDerivatives(int level);
+    void downsampleRow(int level, int y); //row y of level+1 from five rows of level
+
+    int                     mBorder;
+    std::vector<cv::Size>   mSizes; //unpadded size of each level
+    std::vector<cv::Mat>    mImages; //CV_8UC1, padded
+    std::vector<cv::Mat>    mDx, mDy; //CV_16SC1, padded, same layout as mImages
+    cv::Mat                 mDown; //pyrDown output before it gets its border (buildSeparate)
+
+    std::vector<int>        mRowsWritten; //per level, rows 0..n-1 are in
+    std::vector<int>        mNextDerivative; //per level, next padded row to get dx/dy
+    std::vector<bool>       mFinished; //per level, bottom border is in
+    std::vector<int>        mColumnSums; //vertical 1 4 6 4 1 sums for one pyrDown row
+};
+
+class FixedPointLK {
+public:
+    void setSettings(const LKSettings &settings) { mSettings=settings; }
+    const LKSettings &getSettings() const { return mSettings; }
+
+    //tracks prevPts from prev into next. nextPts/status are resized to match prevPts.
+    //both pyramids need at least maxLevel+1 levels and a border of at least winSize+1
+    void track(const LKPyramid &prev, const LKPyramid &next, const std::vector<cv::Point2f> &prevPts,
+               std::vector<cv::Point2f> &nextPts, std::vector<uint8_t> &status);
+
+private:
+    struct Scratch {
+        std::vector<int16_t>    patch, gx, gy; //winSize*winSize each
+    };
+
+    void trackPoint(const LKPyramid &prev, const LKPyramid &next, const cv::Point2f &prevPt,
+                    cv::Point2f &nextPt, uint8_t &status, Scratch &scratch) const;
+
+    LKSettings              mSettings;
+    std::vector<Scratch>    mScratch; //one per stripe, kept between frames
+};
+
+const char* lucasKanadePath(); //"SSE2" or "scalar"
+
+//times build() against buildSeparate() and checks they produce the same levels
+void benchmarkPyramid(int width, int height, int maxLevel, int iterations);
+
+//times FixedPointLK against cv::calcOpticalFlowPyrLK for 1k..10k points and logs speed and agreement
+void benchmarkLK(int width, int height);
+
+#endif /* LucasKanade_hpp */
@@ -0,0 +1,118 @@
+//
+//  MemoryTags.cpp
+//  Project2
+//
+
+#include "MemoryTags.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+using namespace std;
+
+namespace {
+
+struct TagCounters {
+    atomic<long long>    live{0}, peak{0}, allocations{0};
+
+    //getMemoryStats() only, for the rate
+    mutex                                   sampleMutex;
+    chrono::steady_clock::time_point        sampledAt;
+    long long                               sampledAllocations = 0;
+    bool                                    sampled = false;
+    double                                  rate = 0;
+};
+
+TagCounters sTags[MEMORY_TAGS];
+
+//cv::Mat memory for one tag. the standard allocator does the work, we count what it hands out
+//and make sure the buffer comes back through us when the last Mat lets go of it
+class TaggedMatAllocator : public cv::MatAllocator {
+public:
+    explicit TaggedMatAllocator(MemoryTag tag) : mTag(tag) {}
+
+    cv::UMatData* allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        cv::UMatData *u=cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if(u){
+            u->currAllocator=this;
+            if(!(u->flags & cv::UMatData::USER_ALLOCATED)) //wrapping someone else's data costs nothing
+                memoryAllocated(mTag, u->size);
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData *u, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(u, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *u) const override
+    {
+        if(u && !(u->flags & cv::UMatData::USER_ALLOCATED))
+            memoryFreed(mTag, u->size);
+        cv::Mat::getStdAllocator()->deallocate(u);
+    }
+
+private:
+    MemoryTag    mTag;
+};
+
+}
+
+const char* memoryTagName(MemoryTag tag)
+{
+    switch(tag){
+        case MEMORY_FRAMES: return "frames";
+        case MEMORY_PYRAMIDS: return "pyramids";
+        case MEMORY_TRACKS: return "tracks";
+        case MEMORY_RECORDINGS: return "recordings";
+        default: return "?";
+    }
+}
+
+void memoryAllocated(MemoryTag tag, size_t bytes)
+{
+    TagCounters &counters=sTags[tag];
+    counters.allocations.fetch_add(1, memory_order_relaxed);
+    long long live=counters.live.fetch_add((long long)bytes, memory_order_relaxed)+(long long)bytes;
+    long long peak=counters.peak.load(memory_order_relaxed);
+    while(live > peak && !counters.peak.compare_exchange_weak(peak, live, memory_order_relaxed))
+        ; //someone else raised it, compare again against theirs
+}
+
+void memoryFreed(MemoryTag tag, size_t bytes)
+{
+    sTags[tag].live.fetch_sub((long long)bytes, memory_order_relaxed);
+}
+
+MemoryStats getMemoryStats(MemoryTag tag)
+{
+    TagCounters &counters=sTags[tag];
+    MemoryStats stats;
+    stats.liveBytes=counters.live.load(memory_order_relaxed);
+    stats.peakBytes=counters.peak.load(memory_order_relaxed);
+    stats.allocations=counters.allocations.load(memory_order_relaxed);
+
+    lock_guard<mutex> lock(counters.sampleMutex);
+    auto now=chrono::steady_clock::now();
+    double seconds=chrono::duration<double>(now-counters.sampledAt).count();
+    if(!counters.sampled || seconds >= 0.5){ //any shorter and the rate jumps around, keep the last one
+        if(counters.sampled)
+            counters.rate=(stats.allocations-counters.sampledAllocations)/seconds;
+        counters.sampled=true;
+        counters.sampledAt=now;
+        counters.sampledAllocations=stats.allocations;
+    }
+    stats.allocationRate=counters.rate;
+    return stats;
+}
+
+cv::MatAllocator* memoryTagAllocator(MemoryTag tag)
+{
+    static TaggedMatAllocator frames(MEMORY_FRAMES), pyramids(MEMORY_PYRAMIDS), tracks(MEMORY_TRACKS), recordings(MEMORY_RECORDINGS);
+    static cv::MatAllocator *allocators[MEMORY_TAGS]={ &frames, &pyramids, &tracks, &recordings };
+    return allocators[tag];
+}
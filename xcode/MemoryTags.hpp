@@ -0,0 +1,78 @@
+//
+//  MemoryTags.hpp
+//  Project2
+//
+//  Memory accounting per subsystem. Buffers that belong to frames, pyramids, track data or
+//  recordings are allocated through allocators that carry a tag, and every allocation and free
+//  updates that tag's live bytes, peak bytes and allocation count. The overlay ('m') shows them,
+//  so it is obvious which part of the app a host's memory goes to and whether one is growing.
+//
+//      TaggedAllocator<T, tag>     for std::vector and friends
+//      memoryTagAllocator(tag)     for cv::Mat -- set mat.allocator before the mat is created
+//
+//  Counting is a few relaxed atomics per allocation, and the buffers involved are reused from
+//  frame to frame, so in a steady state the allocation rate of every tag should sit near zero.
+//
+
+#ifndef MemoryTags_hpp
+#define MemoryTags_hpp
+
+#include <cstddef>
+#include <new>
+#include <opencv2/core/core.hpp>
+
+enum MemoryTag {
+    MEMORY_FRAMES, //luma frames and display copies
+    MEMORY_PYRAMIDS, //LK pyramids and their derivatives
+    MEMORY_TRACKS, //per-frame feature data handed to draw()
+    MEMORY_RECORDINGS, //DVR ring and flight recorder history
+    MEMORY_TAGS //number of tags
+};
+
+struct MemoryStats {
+    long long    liveBytes = 0;
+    long long    peakBytes = 0;
+    long long    allocations = 0; //ever
+    double       allocationRate = 0; //per second, since the previous getMemoryStats() of this tag
+};
+
+const char* memoryTagName(MemoryTag tag); //"frames", "pyramids", ...
+
+void memoryAllocated(MemoryTag tag, size_t bytes);
+void memoryFreed(MemoryTag tag, size_t bytes);
+
+//current numbers for a tag. the rate is worked out between calls, so call it about as often as it is shown
+MemoryStats getMemoryStats(MemoryTag tag);
+
+//hands out a cv::MatAllocator that counts against tag (the same one every call)
+cv::MatAllocator* memoryTagAllocator(MemoryTag tag);
+
+//std allocator that counts against Tag. stateless, so containers with the same tag can swap buffers
+template<class T, MemoryTag Tag>
+struct TaggedAllocator {
+    typedef T value_type;
+    template<class U> struct rebind { typedef TaggedAllocator<U, Tag> other; }; //needed, Tag isn't a type
+
+    TaggedAllocator() {}
+    template<class U> TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n)
+    {
+        T *p=static_cast<T*>(::operator new(n*sizeof(T)));
+        memoryAllocated(Tag, n*sizeof(T));
+        return p;
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        memoryFreed(Tag, n*sizeof(T));
+        ::operator delete(p);
+    }
+};
+
+template<class T, class U, MemoryTag Tag>
+bool operator==(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return true; }
+template<class T, class U, MemoryTag Tag>
+bool operator!=(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return false; }
+
+#endif /* MemoryTags_hpp */
@@ -0,0 +1,39 @@
+//
+//  Metrics.cpp
+//  Project2
+//
+
+#include "Metrics.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+RateMeter::RateMeter()
+: mDeadlineMs(0), mIntervalMs(0), mTicks(0), mMissed(0)
+{
+}
+
+void RateMeter::tick()
+{
+    auto now=chrono::steady_clock::now();
+    if(mTicks > 0){
+        double interval=chrono::duration<double, milli>(now-mLast).count();
+        double average=mIntervalMs;
+        double deadline= mDeadlineMs > 0 ? (double)mDeadlineMs : 1.5*average;
+        if(mTicks > 1 && interval > deadline)
+            mMissed++;
+
+        //weight each tick so the average covers about a second whatever the rate is
+        double weight= average > 0 ? min(1.0, interval/1000.0) : 1.0;
+        mIntervalMs=average+(interval-average)*max(weight, 0.02);
+    }
+    mLast=now;
+    mTicks++;
+}
+
+double RateMeter::getRate() const
+{
+    double interval=mIntervalMs;
+    return interval > 0 ? 1000.0/interval : 0;
+}
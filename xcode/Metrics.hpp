@@ -0,0 +1,38 @@
+//
+//  Metrics.hpp
+//  Project2
+//
+//  Small counters the app shows in its overlay ('m'). Written from whichever thread does the
+//  work and read from draw(), so everything is atomic.
+//
+
+#ifndef Metrics_hpp
+#define Metrics_hpp
+
+#include <atomic>
+#include <chrono>
+
+//how often something happens, and how many times it came later than it should have
+class RateMeter {
+public:
+    RateMeter();
+
+    //a tick more than deadlineMs after the last one counts as missed. 0 means "more than 1.5x
+    //the average interval", for things that have no fixed rate of their own
+    void setDeadline(double deadlineMs) { mDeadlineMs=deadlineMs; }
+
+    void tick(); //one thing happened, now
+
+    double getRate() const; //per second, averaged over roughly the last second
+    double getIntervalMs() const { return mIntervalMs; } //average time between ticks
+    int getTicks() const { return mTicks; }
+    int getMissed() const { return mMissed; }
+
+private:
+    std::chrono::steady_clock::time_point   mLast; //only the ticking thread
+    std::atomic<double>                     mDeadlineMs;
+    std::atomic<double>                     mIntervalMs; //moving average
+    std::atomic<int>                        mTicks, mMissed;
+};
+
+#endif /* Metrics_hpp */
@@ -0,0 +1,194 @@
+//
+//  Particles.cpp
+//  Project2
+//
+
+#include "Particles.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined( __SSE2__ )
+    #include <emmintrin.h>
+    #define PARTICLE_PATH "SSE2"
+#else
+    #define PARTICLE_PATH "scalar"
+#endif
+
+#include "cinder/Log.h"
+
+using namespace std;
+
+const char* particlesPath()
+{
+    return PARTICLE_PATH;
+}
+
+static inline float random01(uint32_t &seed) //xorshift32, [0, 1)
+{
+    seed^=seed << 13;
+    seed^=seed >> 17;
+    seed^=seed << 5;
+    return (seed >> 8)*(1.f/16777216.f);
+}
+
+//what update() samples before the first result has a field, so the loops never need to check
+static const FlowField& stillField()
+{
+    static const FlowField still=[]{
+        FlowField field;
+        field.cols=field.rows=1;
+        field.vectors.assign(1, cv::Point2f(0, 0));
+        return field;
+    }();
+    return still;
+}
+
+void ParticleSystem::reset(int count, const cv::Size &bounds)
+{
+    count=max(0, min(count, PARTICLE_MAX));
+    mBounds=bounds;
+    mX.resize(count);
+    mY.resize(count);
+    mVx.assign(count, 0.f);
+    mVy.assign(count, 0.f);
+    mLife.resize(count);
+    mSeeds.resize((count+PARTICLE_CHUNK-1)/PARTICLE_CHUNK);
+    for(size_t c=0; c<mSeeds.size(); c++)
+        mSeeds[c]=2654435761u*(uint32_t)(c+1); //never 0, xorshift would stay there
+
+    for(int i=0; i<count; i++){
+        respawn(i, mSeeds[i/PARTICLE_CHUNK]);
+        mLife[i]*=random01(mSeeds[i/PARTICLE_CHUNK]); //staggered, so they don't all respawn at once
+    }
+}
+
+void ParticleSystem::respawn(int i, uint32_t &seed)
+{
+    mX[i]=random01(seed)*mBounds.width;
+    mY[i]=random01(seed)*mBounds.height;
+    mVx[i]=0;
+    mVy[i]=0;
+    mLife[i]=PARTICLE_LIFE*(0.5f+random01(seed));
+}
+
+void ParticleSystem::update(const FlowField &field, float framesPerSecond, float dt)
+{
+    int count=getCount();
+    if(count==0 || dt<=0)
+        return;
+
+    const FlowField &flow= field.empty() ? stillField() : field;
+    float response=min(1.f, dt*PARTICLE_RESPONSE);
+    int chunks=(int)mSeeds.size();
+    cv::parallel_for_(cv::Range(0, chunks), [&](const cv::Range &range){
+        for(int c=range.start; c<range.end; c++)
+            updateChunk(c, c*PARTICLE_CHUNK, min(count, (c+1)*PARTICLE_CHUNK), flow, framesPerSecond, response, dt);
+    });
+}
+
+void ParticleSystem::updateChunk(int chunk, int begin, int end, const FlowField &field, float speed, float response, float dt)
+{
+    float *x=mX.data(), *y=mY.data(), *vx=mVx.data(), *vy=mVy.data(), *life=mLife.data();
+    uint32_t &seed=mSeeds[chunk];
+    float width=(float)mBounds.width, height=(float)mBounds.height;
+    int i=begin;
+
+#if defined( __SSE2__ )
+    //four particles at a time. only the field lookups are scalar -- SSE2 has no gather
+    const cv::Point2f *vectors=field.vectors.data();
+    int cols=field.cols;
+    const __m128 scale=_mm_set1_ps(1.f/field.cellSize), half=_mm_set1_ps(0.5f), zero=_mm_setzero_ps();
+    const __m128 maxX=_mm_set1_ps((float)(field.cols-1)), maxY=_mm_set1_ps((float)(field.rows-1));
+    const __m128i lastX=_mm_set1_epi32(field.cols-1), lastY=_mm_set1_epi32(field.rows-1);
+    const __m128 vSpeed=_mm_set1_ps(speed), vResponse=_mm_set1_ps(response), vDt=_mm_set1_ps(dt);
+    const __m128 vWidth=_mm_set1_ps(width), vHeight=_mm_set1_ps(height);
+
+    for(; i+4<=end; i+=4){
+        __m128 px=_mm_loadu_ps(x+i), py=_mm_loadu_ps(y+i);
+
+        //cell and fraction, as in FlowField::sample. clamped to >= 0 first, so truncating is floor
+        __m128 fx=_mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(px, scale), half), zero), maxX);
+        __m128 fy=_mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(py, scale), half), zero), maxY);
+        __m128i ix=_mm_cvttps_epi32(fx), iy=_mm_cvttps_epi32(fy);
+        __m128 ax=_mm_sub_ps(fx, _mm_cvtepi32_ps(ix)), ay=_mm_sub_ps(fy, _mm_cvtepi32_ps(iy));
+        __m128i ix1=_mm_sub_epi32(ix, _mm_cmplt_epi32(ix, lastX)); //+1 unless it is the last column
+        __m128i iy1=_mm_sub_epi32(iy, _mm_cmplt_epi32(iy, lastY));
+
+        alignas(16) int32_t x0[4], x1[4], y0[4], y1[4];
+        _mm_store_si128((__m128i*)x0, ix);
+        _mm_store_si128((__m128i*)x1, ix1);
+        _mm_store_si128((__m128i*)y0, iy);
+        _mm_store_si128((__m128i*)y1, iy1);
+        alignas(16) float ax4[4], bx4[4], cx4[4], dx4[4], ay4[4], by4[4], cy4[4], dy4[4];
+        for(int k=0; k<4; k++){
+            const cv::Point2f &a=vectors[y0[k]*cols+x0[k]], &b=vectors[y0[k]*cols+x1[k]];
+            const cv::Point2f &c=vectors[y1[k]*cols+x0[k]], &d=vectors[y1[k]*cols+x1[k]];
+            ax4[k]=a.x; bx4[k]=b.x; cx4[k]=c.x; dx4[k]=d.x;
+            ay4[k]=a.y; by4[k]=b.y; cy4[k]=c.y; dy4[k]=d.y;
+        }
+
+        //bilinear: across the top and bottom rows, then down
+        auto lerp=[](__m128 a, __m128 b, __m128 t){ return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)); };
+        __m128 flowX=lerp(lerp(_mm_load_ps(ax4), _mm_load_ps(bx4), ax), lerp(_mm_load_ps(cx4), _mm_load_ps(dx4), ax), ay);
+        __m128 flowY=lerp(lerp(_mm_load_ps(ay4), _mm_load_ps(by4), ax), lerp(_mm_load_ps(cy4), _mm_load_ps(dy4), ax), ay);
+
+        __m128 velX=lerp(_mm_loadu_ps(vx+i), _mm_mul_ps(flowX, vSpeed), vResponse);
+        __m128 velY=lerp(_mm_loadu_ps(vy+i), _mm_mul_ps(flowY, vSpeed), vResponse);
+        px=_mm_add_ps(px, _mm_mul_ps(velX, vDt));
+        py=_mm_add_ps(py, _mm_mul_ps(velY, vDt));
+        __m128 left=_mm_sub_ps(_mm_loadu_ps(life+i), vDt);
+        _mm_storeu_ps(x+i, px);
+        _mm_storeu_ps(y+i, py);
+        _mm_storeu_ps(vx+i, velX);
+        _mm_storeu_ps(vy+i, velY);
+        _mm_storeu_ps(life+i, left);
+
+        //off the frame or out of life: start again somewhere else
+        __m128 dead=_mm_or_ps(_mm_or_ps(_mm_cmple_ps(left, zero), _mm_cmplt_ps(px, zero)),
+                              _mm_or_ps(_mm_cmpge_ps(px, vWidth), _mm_or_ps(_mm_cmplt_ps(py, zero), _mm_cmpge_ps(py, vHeight))));
+        int mask=_mm_movemask_ps(dead);
+        for(int k=0; mask; k++, mask>>=1)
+            if(mask & 1)
+                respawn(i+k, seed);
+    }
+#endif
+
+    for(; i<end; i++){
+        cv::Point2f flow=field.sample(x[i], y[i]);
+        vx[i]=vx[i]+(flow.x*speed-vx[i])*response;
+        vy[i]=vy[i]+(flow.y*speed-vy[i])*response;
+        x[i]+=vx[i]*dt;
+        y[i]+=vy[i]*dt;
+        life[i]-=dt;
+        if(life[i]<=0 || x[i]<0 || x[i]>=width || y[i]<0 || y[i]>=height)
+            respawn(i, seed);
+    }
+}
+
+void benchmarkParticles(int count, int iterations)
+{
+    //a vortex round the middle of a 640x480 frame, a couple of pixels per frame at the edge
+    cv::Size frame(640, 480);
+    FlowField field;
+    field.cols=frame.width/FLOW_CELL;
+    field.rows=frame.height/FLOW_CELL;
+    field.vectors.resize(field.cols*field.rows);
+    for(int j=0; j<field.rows; j++)
+        for(int i=0; i<field.cols; i++){
+            float dx=(i+0.5f)*FLOW_CELL-frame.width/2, dy=(j+0.5f)*FLOW_CELL-frame.height/2;
+            field.vectors[j*field.cols+i]=cv::Point2f(-dy, dx)*(2.f/frame.height);
+        }
+
+    ParticleSystem particles;
+    particles.reset(count, frame);
+    particles.update(field, 30, 1/60.f); //first touch of every page outside the timing
+
+    auto start=chrono::steady_clock::now();
+    for(int k=0; k<iterations; k++)
+        particles.update(field, 30, 1/60.f);
+    double ms=chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/iterations;
+
+    CI_LOG_I( "particles (" << PARTICLE_PATH << ", " << cv::getNumThreads() << " threads): " << particles.getCount() << " in "
+             << ms << " ms per update, " << particles.getCount()/ms/1000.0 << "M particles/s" );
+}
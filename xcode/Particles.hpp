@@ -0,0 +1,64 @@
+//
+//  Particles.hpp
+//  Project2
+//
+//  Particles carried along by the tracked motion, for installations ('s'). Up to PARTICLE_MAX of
+//  them, kept as separate arrays (x, y, vx, vy, life) so an update streams straight through
+//  memory and works on four particles per SSE2 instruction (plain loops on other targets).
+//  Particles are cut into PARTICLE_CHUNK sized chunks run with cv::parallel_for_; each chunk has
+//  its own random state for respawning, so chunks share nothing but the flow field they read.
+//
+//  Each update a particle's velocity eases towards the flow field (FlowField.hpp) at its position
+//  and it moves by that velocity. Particles that leave the frame or run out of life start again
+//  somewhere random. draw() uploads x, y and life as three ranges of one vertex buffer and draws
+//  them all with one GL_POINTS call.
+//
+
+#ifndef Particles_hpp
+#define Particles_hpp
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "FlowField.hpp"
+
+#define PARTICLE_DEFAULT 200000 //particles when --particles doesn't say
+#define PARTICLE_MAX (1 << 20)
+#define PARTICLE_CHUNK 16384 //particles per parallel_for_ task
+#define PARTICLE_RESPONSE 6.0f //per second: how quickly velocity follows the field
+#define PARTICLE_LIFE 4.0f //seconds, on average, before a particle respawns
+
+class ParticleSystem {
+public:
+    ParticleSystem() {}
+
+    //count particles (at most PARTICLE_MAX) scattered at random over a frame of size bounds
+    void reset(int count, const cv::Size &bounds);
+
+    //moves every particle on by dt seconds. field is in pixels per tracked frame; framesPerSecond
+    //is the tracking rate that turns that into pixels per second
+    void update(const FlowField &field, float framesPerSecond, float dt);
+
+    int getCount() const { return (int)mX.size(); }
+    const cv::Size &getBounds() const { return mBounds; }
+    const float* getX() const { return mX.data(); }
+    const float* getY() const { return mY.data(); }
+    const float* getLife() const { return mLife.data(); } //seconds left, for fading out
+
+private:
+    //one chunk: [begin, end) with field velocities scaled by speed, response and dt already folded in
+    void updateChunk(int chunk, int begin, int end, const FlowField &field, float speed, float response, float dt);
+    void respawn(int i, uint32_t &seed);
+
+    cv::Size                mBounds;
+    std::vector<float>      mX, mY, mVx, mVy, mLife;
+    std::vector<uint32_t>   mSeeds; //xorshift state, one per chunk
+};
+
+const char* particlesPath(); //"SSE2" or "scalar"
+
+//times update() for count particles in a swirling field and logs particles per second
+void benchmarkParticles(int count, int iterations);
+
+#endif /* Particles_hpp */
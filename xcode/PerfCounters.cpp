@@ -0,0 +1,159 @@
+//
+//  PerfCounters.cpp
+//  Project2
+//
+
+#include "PerfCounters.hpp"
+
+#include <cstring>
+#include <mutex>
+
+#if PERF_COUNTERS_SUPPORTED
+    #include <cerrno>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "cinder/Log.h"
+
+using namespace std;
+
+static mutex sStatusMutex;
+static string sStatus="not opened yet";
+
+static void setStatus(const string &status)
+{
+    lock_guard<mutex> lock(sStatusMutex);
+    if(status!=sStatus)
+        CI_LOG_I( "perf counters: " << status );
+    sStatus=status;
+}
+
+string perfCountersStatus()
+{
+    lock_guard<mutex> lock(sStatusMutex);
+    return sStatus;
+}
+
+void PerfSample::add(const PerfSample &other)
+{
+    long long *mine[]={ &cycles, &instructions, &cacheMisses, &branchMisses };
+    const long long theirs[]={ other.cycles, other.instructions, other.cacheMisses, other.branchMisses };
+    for(int c=0; c<4; c++)
+        *mine[c]= *mine[c] < 0 || theirs[c] < 0 ? -1 : *mine[c]+theirs[c];
+}
+
+PerfCounters &PerfCounters::forThisThread()
+{
+    static thread_local PerfCounters counters;
+    return counters;
+}
+
+#if PERF_COUNTERS_SUPPORTED
+
+static int openCounter(uint64_t config, int group)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=PERF_TYPE_HARDWARE;
+    attr.config=config;
+    attr.disabled= group < 0 ? 1 : 0; //the leader starts off, members follow it
+    attr.exclude_kernel=1; //works at perf_event_paranoid 2, and the kernel isn't what we are measuring
+    attr.exclude_hv=1;
+    attr.read_format=PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0); //this thread, any cpu
+}
+
+PerfCounters::PerfCounters()
+: mLeader(-1), mOpen(0)
+{
+    const uint64_t configs[COUNTERS]={ PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                       PERF_COUNT_HW_BRANCH_MISSES };
+    for(int c=0; c<COUNTERS; c++){
+        mFds[c]=-1;
+        mSlot[c]=-1;
+    }
+
+    mFds[CYCLES]=openCounter(configs[CYCLES], -1);
+    if(mFds[CYCLES] < 0){
+        bool permission= errno==EACCES || errno==EPERM;
+        setStatus(string("unavailable (")+strerror(errno)+(permission ? ", see /proc/sys/kernel/perf_event_paranoid)" : ")"));
+        return;
+    }
+    mLeader=mFds[CYCLES];
+    mSlot[CYCLES]=mOpen++;
+
+    const char *names[COUNTERS]={ "cycles", "instructions", "cache misses", "branch misses" };
+    string missing;
+    for(int c=CYCLES+1; c<COUNTERS; c++){ //a counter the cpu doesn't have just stays -1
+        mFds[c]=openCounter(configs[c], mLeader);
+        if(mFds[c] >= 0)
+            mSlot[c]=mOpen++;
+        else
+            missing+=string(missing.empty() ? "" : ", ")+names[c];
+    }
+    setStatus(missing.empty() ? "perf_event_open" : "perf_event_open, no "+missing);
+}
+
+PerfCounters::~PerfCounters()
+{
+    for(int c=0; c<COUNTERS; c++)
+        if(mFds[c] >= 0)
+            close(mFds[c]);
+}
+
+void PerfCounters::start()
+{
+    if(mLeader < 0)
+        return;
+    ioctl(mLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfSample PerfCounters::stop()
+{
+    PerfSample sample;
+    if(mLeader < 0)
+        return sample;
+    ioctl(mLeader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    uint64_t values[3+COUNTERS]; //nr, time enabled, time running, then one value per counter
+    if(read(mLeader, values, sizeof(values)) < (ssize_t)((3+mOpen)*sizeof(uint64_t)))
+        return sample;
+    double scale= values[2] > 0 ? (double)values[1]/values[2] : 1; //more counters than the pmu has: scale up
+    long long *fields[COUNTERS]={ &sample.cycles, &sample.instructions, &sample.cacheMisses, &sample.branchMisses };
+    for(int c=0; c<COUNTERS; c++)
+        if(mSlot[c] >= 0)
+            *fields[c]=(long long)(values[3+mSlot[c]]*scale);
+    return sample;
+}
+
+#else //no perf_event_open -- everything reads -1
+
+PerfCounters::PerfCounters()
+: mLeader(-1), mOpen(0)
+{
+    for(int c=0; c<COUNTERS; c++){
+        mFds[c]=-1;
+        mSlot[c]=-1;
+    }
+    setStatus("not supported on this platform");
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::start()
+{
+}
+
+PerfSample PerfCounters::stop()
+{
+    return PerfSample();
+}
+
+#endif
@@ -0,0 +1,67 @@
+//
+//  PerfCounters.hpp
+//  Project2
+//
+//  Hardware counters (cycles, instructions, cache misses, branch misses) around a stretch of
+//  code, through Linux perf_event_open. Tells us whether a stage is waiting on memory or on
+//  arithmetic, which timings alone can't.
+//
+//  Counters only count the thread that opened them, so every thread gets its own set
+//  (forThisThread). Anything that can't be opened -- perf_event_paranoid too strict, a VM without
+//  a PMU, one event the CPU doesn't have -- just reads as -1; nothing fails.
+//
+//  macOS has no public per-thread counter API (kperf needs root and is private), so there
+//  PERF_COUNTERS_SUPPORTED is 0: the class still compiles and reads -1, and the app leaves out the
+//  'p' key, --perf and the counter lines of the overlay rather than offer something that can't work.
+//
+
+#ifndef PerfCounters_hpp
+#define PerfCounters_hpp
+
+#include <string>
+
+#if defined( __linux__ )
+    #define PERF_COUNTERS_SUPPORTED 1
+#else
+    #define PERF_COUNTERS_SUPPORTED 0
+#endif
+
+//one start()/stop() worth of counts. -1 means that counter isn't available
+struct PerfSample {
+    long long    cycles = -1;
+    long long    instructions = -1;
+    long long    cacheMisses = -1; //last level cache
+    long long    branchMisses = -1;
+
+    bool valid() const { return cycles >= 0; }
+    void add(const PerfSample &other); //sums counter by counter; -1 stays -1
+    double ipc() const { return cycles > 0 && instructions >= 0 ? (double)instructions/cycles : 0; }
+};
+
+class PerfCounters {
+public:
+    static PerfCounters &forThisThread(); //opened the first time a thread asks
+
+    ~PerfCounters();
+
+    bool isAvailable() const { return mLeader >= 0; }
+    void start(); //resets and enables the counters
+    PerfSample stop(); //disables them and reads, scaled up if the kernel had to multiplex
+
+private:
+    enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTERS };
+
+    PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters &operator=(const PerfCounters&) = delete;
+
+    int     mLeader; //group leader fd (cycles), -1 if nothing could be opened
+    int     mFds[COUNTERS];
+    int     mSlot[COUNTERS]; //position of each counter in a group read, -1 if it didn't open
+    int     mOpen; //counters in the group
+};
+
+//"perf_event_open", or why counters aren't available (set once the first thread has tried)
+std::string perfCountersStatus();
+
+#endif /* PerfCounters_hpp */
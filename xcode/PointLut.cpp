@@ -0,0 +1,29 @@
+//
+//  PointLut.cpp
+//  Project2
+//
+
+#include "PointLut.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+cv::Point2f PointLut::map(float x, float y) const
+{
+    if(mNodes.empty())
+        return cv::Point2f(x, y);
+    float fx=min(max(x/mStep, 0.f), mCols-1.f), fy=min(max(y/mStep, 0.f), mRows-1.f);
+    int x0=max(0, min((int)fx, mCols-2)), y0=max(0, min((int)fy, mRows-2));
+    float ax=fx-x0, ay=fy-y0;
+    const cv::Point2f *node=&mNodes[y0*mCols+x0];
+    cv::Point2f top=node[0]+(node[1]-node[0])*ax, bottom=node[mCols]+(node[mCols+1]-node[mCols])*ax;
+    return top+(bottom-top)*ay;
+}
+
+void PointLut::map(const vector<cv::Point2f> &in, vector<cv::Point2f> &out) const
+{
+    out.resize(in.size());
+    for(size_t i=0; i<in.size(); i++)
+        out[i]=map(in[i].x, in[i].y);
+}
@@ -0,0 +1,45 @@
+//
+//  PointLut.hpp
+//  Project2
+//
+//  A mapping from frame pixels to somewhere else, evaluated once on a grid of nodes every step
+//  pixels over the frame and looked up bilinearly after that. For corrections that only points
+//  need -- feature positions, grid corners -- so they cost a lookup per point instead of a pass
+//  over every pixel, and the expensive maths (a projective divide, an iterative lens inverse) runs
+//  only when the LUT is built. GroundLut (GroundPlane.hpp) and LensLut (Lens.hpp) are built on it.
+//
+
+#ifndef PointLut_hpp
+#define PointLut_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+class PointLut {
+public:
+    bool empty() const { return mNodes.empty(); }
+    const cv::Size &getFrameSize() const { return mFrameSize; }
+
+    cv::Point2f map(float x, float y) const; //bilinear between nodes, clamped to the frame. x, y unchanged when empty
+    void map(const std::vector<cv::Point2f> &in, std::vector<cv::Point2f> &out) const; //out resized to match
+
+protected:
+    //nodes at every step pixels from the top left, the last ones on or past the right and bottom edges
+    template<class F> void build(const cv::Size &frameSize, int step, const F &mapping)
+    {
+        mFrameSize=frameSize;
+        mStep=step>1 ? step : 1;
+        mCols=(frameSize.width+mStep-1)/mStep+1;
+        mRows=(frameSize.height+mStep-1)/mStep+1;
+        mNodes.resize(mCols*mRows);
+        for(int j=0; j<mRows; j++)
+            for(int i=0; i<mCols; i++)
+                mNodes[j*mCols+i]=mapping(cv::Point2f((float)(i*mStep), (float)(j*mStep)));
+    }
+
+    cv::Size                    mFrameSize;
+    int                         mStep = 1, mCols = 0, mRows = 0; //nodes across and down
+    std::vector<cv::Point2f>    mNodes; //row major
+};
+
+#endif /* PointLut_hpp */
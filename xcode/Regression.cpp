@@ -0,0 +1,544 @@
+//
+//  Regression.cpp
+//  Project2
+//
+
+#include "Regression.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "cinder/Log.h"
+#include "FeatureTracker.hpp"
+#include "FeatureVertices.hpp"
+#include "FramePipeline.hpp"
+#include "Grid.hpp"
+#include "SyntheticSource.hpp"
+
+using namespace std;
+
+//counts every allocation in the process. a relaxed add per new and delete, cheap enough to leave
+//in the app, and it means a check run always has real numbers to hold against its budget
+static atomic<long> sAllocations(0);
+static atomic<long> sFrees(0);
+
+void* operator new(size_t size)
+{
+    sAllocations.fetch_add(1, memory_order_relaxed);
+    void *p=malloc(size ? size : 1);
+    if(!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if(p)
+        sFrees.fetch_add(1, memory_order_relaxed);
+    free(p);
+}
+
+long getAllocationCount()
+{
+    return sAllocations.load(memory_order_relaxed);
+}
+
+long getLiveAllocationCount()
+{
+    return sAllocations.load(memory_order_relaxed)-sFrees.load(memory_order_relaxed);
+}
+
+//what the tracker produced for one frame
+struct GoldenFrame {
+    int                     frameNumber;
+    vector<cv::Point2f>     features;
+    vector<uint8_t>         statuses;
+    vector<int>             cellSums;
+};
+
+//mean cost per frame of each stage
+struct Budget {
+    double detectMs = 0; //mean over the frames that re-detected
+    double flowMs = 0;
+    double gridMs = 0;
+    double allocations = 0; //allocations from submit to publish, all threads
+};
+
+static const char* configName(bool opencv)
+{
+    return opencv ? "opencv" : "own";
+}
+
+static bool parseConfig(const string &name, bool &opencv)
+{
+    opencv= name=="opencv";
+    return opencv || name=="own";
+}
+
+//where the numbers came from, written into budget files so a failure says what it was held to
+static string machineName()
+{
+    ostringstream name;
+#if defined(__APPLE__)
+    name << "macos";
+#elif defined(__linux__)
+    name << "linux";
+#else
+    name << "unknown os";
+#endif
+#if defined(__x86_64__)
+    name << " x86_64";
+#elif defined(__aarch64__) || defined(__arm64__)
+    name << " arm64";
+#endif
+    name << ", " << thread::hardware_concurrency() << " threads";
+    return name.str();
+}
+
+static bool runSequence(bool opencv, vector<GoldenFrame> &frames, Budget &measured)
+{
+    SyntheticSource source(REGRESSION_WIDTH, REGRESSION_HEIGHT, REGRESSION_SEED);
+    FramePipeline pipeline;
+    TrackerSettings settings; //opencv runs the defaults the app ships with
+    if(!opencv){
+        settings.fusedCorners=true; //the tracker's own detector and LK, see Regression.hpp
+        settings.fixedPointLK=true;
+    }
+    pipeline.setTrackerSettings(settings);
+    pipeline.setGridSize(REGRESSION_GRID);
+
+    int detectFrames=0;
+    measured=Budget();
+    frames.assign(REGRESSION_FRAMES, GoldenFrame());
+
+    for(int k=0; k<REGRESSION_FRAMES; k++){
+        SourceFrame frame;
+        source.next(frame.luma); //a new buffer each frame, the pipeline keeps the last
+
+        //one frame at a time, so the pipeline never drops one
+        long before=getAllocationCount();
+        if(!pipeline.submit(frame, k)){
+            CI_LOG_E( "regression: pipeline refused frame " << k );
+            return false;
+        }
+        while(!pipeline.poll())
+            this_thread::yield();
+        measured.allocations+=getAllocationCount()-before;
+
+        const TrackResult &result=pipeline.getResult();
+        const StageTimes &times=result.stages;
+        if(times.detected){
+            measured.detectMs+=times.detectMs;
+            detectFrames++;
+        }
+        measured.flowMs+=times.flowMs;
+        measured.gridMs+=times.gridMs;
+
+        GoldenFrame &golden=frames[k];
+        golden.frameNumber=result.frameNumber;
+        golden.features=result.features;
+        golden.statuses=result.featureStatuses;
+        golden.cellSums=result.cellSums;
+    }
+    pipeline.stop();
+
+    if(detectFrames>0)
+        measured.detectMs/=detectFrames;
+    measured.flowMs/=REGRESSION_FRAMES;
+    measured.gridMs/=REGRESSION_FRAMES;
+    measured.allocations/=REGRESSION_FRAMES;
+    return true;
+}
+
+bool recordGolden(const string &path, bool opencv)
+{
+    vector<GoldenFrame> frames;
+    Budget measured;
+    if(!runSequence(opencv, frames, measured))
+        return false;
+
+    ofstream out(path);
+    if(!out){
+        CI_LOG_E( "can't write golden file " << path );
+        return false;
+    }
+
+    out.precision(9);
+    out << "golden 2 " << configName(opencv) << "\n";
+    out << "frames " << frames.size() << "\n";
+    for(const GoldenFrame &frame : frames){
+        out << "frame " << frame.frameNumber << " " << frame.features.size() << " " << frame.statuses.size() << " " << frame.cellSums.size() << "\n";
+        for(const cv::Point2f &p : frame.features)
+            out << fixed << setprecision(3) << p.x << " " << p.y << defaultfloat << setprecision(9) << "\n"; //well inside REGRESSION_POSITION_TOLERANCE
+        for(uint8_t s : frame.statuses)
+            out << (int)s << " ";
+        out << "\n";
+        for(int c : frame.cellSums)
+            out << c << " ";
+        out << "\n";
+    }
+
+    CI_LOG_I( "recorded " << frames.size() << " golden frames (" << configName(opencv) << ") to " << path );
+    return true;
+}
+
+bool recordBudget(const string &path, bool opencv)
+{
+    vector<GoldenFrame> frames;
+    Budget measured;
+    if(!runSequence(opencv, frames, measured))
+        return false;
+
+    ofstream out(path);
+    if(!out){
+        CI_LOG_E( "can't write budget file " << path );
+        return false;
+    }
+
+    out.precision(4);
+    out << "budget 1 " << configName(opencv) << "\n";
+    out << "machine " << machineName() << "\n";
+    out << "detect " << measured.detectMs*REGRESSION_BUDGET_HEADROOM << "\n";
+    out << "flow " << measured.flowMs*REGRESSION_BUDGET_HEADROOM << "\n";
+    out << "grid " << measured.gridMs*REGRESSION_BUDGET_HEADROOM << "\n";
+    out << "allocations " << ceil(measured.allocations*REGRESSION_BUDGET_HEADROOM) << "\n";
+
+    CI_LOG_I( "recorded " << configName(opencv) << " budgets for " << machineName() << " to " << path );
+    return true;
+}
+
+static bool readGolden(const string &path, bool &opencv, vector<GoldenFrame> &frames)
+{
+    ifstream in(path);
+    string word, config;
+    int version=0;
+    if(!(in >> word >> version >> config) || word!="golden" || version!=2 || !parseConfig(config, opencv))
+        return false;
+
+    size_t count=0;
+    if(!(in >> word >> count) || word!="frames")
+        return false;
+    frames.resize(count);
+    for(GoldenFrame &frame : frames){
+        size_t features=0, statuses=0, cells=0;
+        if(!(in >> word >> frame.frameNumber >> features >> statuses >> cells) || word!="frame")
+            return false;
+        frame.features.resize(features);
+        for(cv::Point2f &p : frame.features)
+            in >> p.x >> p.y;
+        frame.statuses.resize(statuses);
+        for(uint8_t &s : frame.statuses){
+            int value;
+            in >> value;
+            s=(uint8_t)value;
+        }
+        frame.cellSums.resize(cells);
+        for(int &c : frame.cellSums)
+            in >> c;
+    }
+    return (bool)in;
+}
+
+static bool readBudget(const string &path, bool &opencv, string &machine, Budget &budget)
+{
+    ifstream in(path);
+    string word, config;
+    int version=0;
+    if(!(in >> word >> version >> config) || word!="budget" || version!=1 || !parseConfig(config, opencv))
+        return false;
+    if(!(in >> word) || word!="machine" || !getline(in, machine))
+        return false;
+    return (in >> word >> budget.detectMs) && word=="detect" &&
+           (in >> word >> budget.flowMs) && word=="flow" &&
+           (in >> word >> budget.gridMs) && word=="grid" &&
+           (in >> word >> budget.allocations) && word=="allocations";
+}
+
+//one frame against its golden. the opencv run is held loosely: cv's detector and LK move with the
+//OpenCV build, so a few statuses may flip and positions only have to be close
+static bool matchFrame(size_t k, const GoldenFrame &want, const GoldenFrame &got, bool opencv)
+{
+    if(want.features.size()!=got.features.size() || want.statuses.size()!=got.statuses.size()){
+        CI_LOG_E( "frame " << k << ": " << got.features.size() << " features, golden has " << want.features.size() );
+        return false;
+    }
+    int flipped=0;
+    for(size_t i=0; i<want.statuses.size(); i++)
+        if(want.statuses[i]!=got.statuses[i])
+            flipped++;
+    int allowed= opencv ? (int)(REGRESSION_OPENCV_STATUS_TOLERANCE*want.statuses.size()) : 0;
+    if(flipped>allowed){
+        CI_LOG_E( "frame " << k << ": " << flipped << " statuses differ from the golden, " << allowed << " allowed" );
+        return false;
+    }
+
+    float tolerance= opencv ? REGRESSION_OPENCV_POSITION_TOLERANCE : REGRESSION_POSITION_TOLERANCE;
+    for(size_t i=0; i<want.features.size(); i++){
+        if(i<want.statuses.size() && (!want.statuses[i] || !got.statuses[i])) //a lost feature's position means nothing
+            continue;
+        if(fabs(want.features[i].x-got.features[i].x)>tolerance || fabs(want.features[i].y-got.features[i].y)>tolerance){
+            CI_LOG_E( "frame " << k << ": feature " << i << " at " << got.features[i].x << "," << got.features[i].y
+                     << ", golden " << want.features[i].x << "," << want.features[i].y );
+            return false;
+        }
+    }
+
+    if(want.cellSums.size()!=got.cellSums.size()){
+        CI_LOG_E( "frame " << k << ": grid has " << got.cellSums.size() << " cells, golden has " << want.cellSums.size() );
+        return false;
+    }
+    for(size_t c=0; c<want.cellSums.size(); c++){
+        if(fabs((double)want.cellSums[c]-got.cellSums[c]) > REGRESSION_CELL_TOLERANCE*max(1, want.cellSums[c])){
+            CI_LOG_E( "frame " << k << ": cell " << c << " sum " << got.cellSums[c] << ", golden " << want.cellSums[c] );
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkGolden(const string &path, const string &budgetPath)
+{
+    vector<GoldenFrame> golden;
+    bool opencv=false;
+    if(!readGolden(path, opencv, golden)){
+        CI_LOG_E( "can't read golden file " << path );
+        return false;
+    }
+    Budget budget;
+    bool budgetOpencv=false;
+    string machine;
+    if(!readBudget(budgetPath, budgetOpencv, machine, budget)){
+        CI_LOG_E( "can't read budget file " << budgetPath );
+        return false;
+    }
+    if(budgetOpencv!=opencv){
+        CI_LOG_E( "budget " << budgetPath << " is for the " << configName(budgetOpencv) << " run, golden " << path << " is " << configName(opencv) );
+        return false;
+    }
+
+    vector<GoldenFrame> frames;
+    Budget measured;
+    if(!runSequence(opencv, frames, measured))
+        return false;
+
+    int mismatches=0;
+    if(golden.size()!=frames.size()){
+        CI_LOG_E( "golden has " << golden.size() << " frames, ran " << frames.size() );
+        mismatches++;
+    }
+    for(size_t k=0; k<golden.size() && k<frames.size(); k++)
+        if(!matchFrame(k, golden[k], frames[k], opencv))
+            mismatches++;
+
+    //a time budget of 0 is a file nobody recorded on a machine, which fails rather than passing
+    //everything. 0 allocations is a real budget
+    int overBudget=0;
+    if(!(measured.detectMs<=budget.detectMs)){
+        CI_LOG_E( "detect " << measured.detectMs << " ms over budget " << budget.detectMs << " ms" );
+        overBudget++;
+    }
+    if(!(measured.flowMs<=budget.flowMs)){
+        CI_LOG_E( "flow " << measured.flowMs << " ms over budget " << budget.flowMs << " ms" );
+        overBudget++;
+    }
+    if(!(measured.gridMs<=budget.gridMs)){
+        CI_LOG_E( "grid " << measured.gridMs << " ms over budget " << budget.gridMs << " ms" );
+        overBudget++;
+    }
+    if(budget.detectMs<=0 || budget.flowMs<=0 || budget.gridMs<=0){
+        CI_LOG_E( "budget " << budgetPath << " has a stage at 0 ms, record it with --record-budget" );
+        overBudget++;
+    }
+    if(measured.allocations>budget.allocations){
+        CI_LOG_E( measured.allocations << " allocations per frame over budget " << budget.allocations );
+        overBudget++;
+    }
+    if(overBudget>0)
+        CI_LOG_E( "budgets were recorded on" << machine << ", this is " << machineName() );
+
+    bool passed=(mismatches==0 && overBudget==0);
+    CI_LOG_I( "golden check (" << configName(opencv) << ") " << (passed ? "PASSED" : "FAILED") << ": " << mismatches << " mismatches, "
+             << overBudget << " stages over budget (detect " << measured.detectMs << " ms, flow " << measured.flowMs
+             << " ms, grid " << measured.gridMs << " ms, " << measured.allocations << " allocations per frame)" );
+    return passed;
+}
+
+//cells over CELL_THRESHOLD on frames from the warm-up on
+static int countFired(const FeatureTracker &tracker, int frame, int warmup)
+{
+    if(frame<warmup)
+        return 0;
+    int fired=0;
+    for(int sum : tracker.getCellSums())
+        if(sum>CELL_THRESHOLD)
+            fired++;
+    return fired;
+}
+
+static void setupDenoise(FeatureTracker &tracker, bool denoise, int grid)
+{
+    TrackerSettings settings=tracker.getSettings();
+    settings.temporalDenoise=denoise;
+    tracker.setSettings(settings);
+    tracker.setGridSize(grid);
+}
+
+//fired cells over a still frame with gaussian noise. the noise is the sum of 12 uniforms from
+//mt19937 (the std distributions differ between libraries), so every machine sees the same frames
+static int stillFired(double sigma, bool denoise, int grid)
+{
+    SyntheticSource source(REGRESSION_WIDTH, REGRESSION_HEIGHT, REGRESSION_SEED);
+    cv::Mat still;
+    source.next(still);
+
+    mt19937 rng(REGRESSION_SEED);
+    FeatureTracker tracker;
+    setupDenoise(tracker, denoise, grid);
+    int fired=0;
+    for(int k=0; k<DENOISE_CHECK_FRAMES; k++){
+        cv::Mat noisy(still.size(), CV_8UC1); //a new buffer each frame, the tracker keeps the last
+        for(int y=0; y<still.rows; y++)
+            for(int x=0; x<still.cols; x++){
+                double normal=-6;
+                for(int i=0; i<12; i++)
+                    normal+=rng()/4294967296.0;
+                noisy.at<uint8_t>(y, x)=(uint8_t)min(255.0, max(0.0, round(still.at<uint8_t>(y, x)+sigma*normal)));
+            }
+        tracker.process(noisy, k);
+        fired+=countFired(tracker, k, DENOISE_CHECK_WARMUP);
+    }
+    return fired;
+}
+
+//cell sums added up over the moving synthetic sequence -- the scrolling background fires every
+//cell either way, so it is how much of the motion gets through that tells
+static long long movingSum(bool denoise, int grid)
+{
+    SyntheticSource source(REGRESSION_WIDTH, REGRESSION_HEIGHT, REGRESSION_SEED);
+    FeatureTracker tracker;
+    setupDenoise(tracker, denoise, grid);
+    long long total=0;
+    for(int k=0; k<REGRESSION_FRAMES; k++){
+        cv::Mat gray; //a new buffer each frame, the tracker keeps the last
+        source.next(gray);
+        tracker.process(gray, k);
+        for(int sum : tracker.getCellSums())
+            total+=sum;
+    }
+    return total;
+}
+
+bool checkDenoise()
+{
+    bool passed=true;
+    const int grids[]={ 5, REGRESSION_GRID }; //the default grid, and the finer one the golden check uses
+    for(double sigma : DENOISE_CHECK_SIGMAS)
+        for(int grid : grids){
+            int raw=stillFired(sigma, false, grid), denoised=stillFired(sigma, true, grid);
+            CI_LOG_I( "denoise, still frame, noise " << sigma << ", grid " << grid << ": " << raw << " cells fired, " << denoised << " with the filter" );
+            if(denoised>0)
+                passed=false;
+        }
+
+    long long raw=movingSum(false, REGRESSION_GRID), denoised=movingSum(true, REGRESSION_GRID);
+    CI_LOG_I( "denoise, moving sequence: cell sums " << raw << ", " << denoised << " with the filter" );
+    if(denoised<DENOISE_CHECK_MOTION_KEPT*raw)
+        passed=false;
+
+    CI_LOG_I( "denoise check " << (passed ? "PASSED" : "FAILED") );
+    return passed;
+}
+
+//what aggregateFeatureFlow should have made for one tile, worked out from the features themselves
+struct TileMean {
+    cv::Point2f position, motion;
+    int count = 0;
+};
+
+//one run of the moving sequence; counts frames that made arrows, frames that stayed sparse and
+//frames whose arrows are wrong
+static void runLod(int maxFeatures, int &lodFrames, int &sparseFrames, int &mismatches)
+{
+    SyntheticSource source(REGRESSION_WIDTH, REGRESSION_HEIGHT, REGRESSION_SEED);
+    FeatureTracker tracker;
+    TrackerSettings settings;
+    settings.fusedCorners=true; //the tracker's own detector and LK, as in the golden run
+    settings.fixedPointLK=true;
+    settings.maxFeatures=maxFeatures;
+    tracker.setSettings(settings);
+    int tile=featureLodTile(cv::Size(REGRESSION_WIDTH, REGRESSION_HEIGHT), settings.maxFeatures);
+
+    TrackResult result;
+    for(int k=0; k<REGRESSION_FRAMES; k++){
+        cv::Mat gray; //a new buffer each frame, the tracker keeps the last
+        source.next(gray);
+        tracker.process(gray, k);
+        tracker.snapshot(result);
+        const FeatureVertices &packed=result.vertices;
+        if(!needsFeatureLod(packed.features)){
+            if(packed.features>0) //not the first frame, which has nothing tracked yet
+                sparseFrames++;
+            if(packed.arrows>0)
+                mismatches++;
+            continue;
+        }
+        lodFrames++;
+
+        map<int, TileMean> tiles;
+        int cols=(REGRESSION_WIDTH+tile-1)/tile, rows=(REGRESSION_HEIGHT+tile-1)/tile;
+        for(size_t i=0; i<result.features.size(); i++){
+            if(!result.featureStatuses[i])
+                continue;
+            const cv::Point2f &p=result.features[i];
+            int tx=min(max((int)p.x/tile, 0), cols-1), ty=min(max((int)p.y/tile, 0), rows-1);
+            TileMean &mean=tiles[ty*cols+tx];
+            mean.position+=p;
+            mean.motion+=p-result.prevFeatures[i];
+            mean.count++;
+        }
+        int expected=0;
+        for(auto &entry : tiles){
+            TileMean &mean=entry.second;
+            mean.position*=1.f/mean.count;
+            mean.motion*=LOD_ARROW_SCALE/mean.count;
+            if(cv::norm(mean.motion)>=1.f)
+                expected++;
+        }
+
+        bool wrong= packed.tile!=tile || packed.arrows!=expected || packed.arrows==0 || packed.arrows>LOD_MAX_ARROWS;
+        const cv::Point2f *arrow=&packed.vertices[packed.arrowOffset()];
+        for(int a=0; a<packed.arrows && !wrong; a++, arrow+=6){
+            int tx=min(max((int)arrow[0].x/tile, 0), cols-1), ty=min(max((int)arrow[0].y/tile, 0), rows-1);
+            auto found=tiles.find(ty*cols+tx);
+            wrong= found==tiles.end() || cv::norm(arrow[0]-found->second.position)>LOD_CHECK_TOLERANCE ||
+                   cv::norm(arrow[1]-arrow[0]-found->second.motion)>LOD_CHECK_TOLERANCE;
+        }
+        if(wrong)
+            mismatches++;
+    }
+}
+
+bool checkFeatureLod()
+{
+    int lodFrames=0, denseSparse=0, mismatches=0;
+    runLod(LOD_CHECK_DENSE_FEATURES, lodFrames, denseSparse, mismatches);
+    int defaultLod=0, sparse=0;
+    runLod(TrackerSettings().maxFeatures, defaultLod, sparse, mismatches);
+
+    int tile=featureLodTile(cv::Size(REGRESSION_WIDTH, REGRESSION_HEIGHT), LOD_CHECK_DENSE_FEATURES);
+    CI_LOG_I( "lod, " << tile << " pixel tiles: " << lodFrames << " of " << REGRESSION_FRAMES << " frames aggregated at maxFeatures "
+             << LOD_CHECK_DENSE_FEATURES << ", " << defaultLod << " at the default " << TrackerSettings().maxFeatures << " ("
+             << sparse << " kept every circle), " << mismatches << " frames wrong" );
+    bool passed= mismatches==0 && lodFrames>0 && defaultLod==0 && sparse>0;
+    CI_LOG_I( "lod check " << (passed ? "PASSED" : "FAILED") );
+    return passed;
+}
@@ -0,0 +1,77 @@
+//
+//  Regression.hpp
+//  Project2
+//
+//  Golden-output check for speed work: feeds a fixed SyntheticSource sequence through a
+//  FramePipeline -- the same worker threads, luma and track stages the app uses, one frame in
+//  flight at a time so none are dropped -- and compares features, statuses and grid sums against
+//  a golden file, within REGRESSION_POSITION_TOLERANCE and REGRESSION_CELL_TOLERANCE.
+//
+//  There are two runs. "own" uses the tracker's own detector and LK (detectCorners, FixedPointLK), so
+//  the results don't change with the OpenCV build: all that comes from OpenCV is pyrDown,
+//  copyMakeBorder and absdiff, which are exact integer maths. Its golden file is checked in as
+//  xcode/RegressionGolden.txt. "opencv" runs the default TrackerSettings, the path the app ships
+//  (cv::goodFeaturesToTrack and cv::calcOpticalFlowPyrLK). Those move with the OpenCV build, so its
+//  golden is recorded on the machine that checks it, and held at REGRESSION_OPENCV_POSITION_TOLERANCE
+//  with up to REGRESSION_OPENCV_STATUS_TOLERANCE of the statuses allowed to flip.
+//
+//  Every check is also held to a budget file: mean detect, flow and grid ms and allocations per
+//  frame. Times depend on the machine, so the file names the one it was recorded on;
+//  xcode/RegressionBudget.txt is the reference machine's for the own run. A stage with a 0 ms budget
+//  fails, and allocations are counted in every build (a relaxed add in operator new), so a check can
+//  always fail on either.
+//
+//  These runs start from the app's prepareSettings, before there is a window, and need no camera.
+//  They are app flags: the project is Xcode only and has no test target.
+//
+//      Project2 --record-golden golden.txt [opencv]    writes the golden file from this build
+//      Project2 --record-budget budget.txt [opencv]    writes this machine's budgets
+//      Project2 --check-golden golden.txt budget.txt   exits 0 if everything matches and is within budget, 1 if not
+//      Project2 --check-denoise               exits 0 if TemporalDenoise (Denoise.hpp) stops noise firing cells
+//      Project2 --check-lod                   exits 0 if dense frames get the per-tile arrows (FeatureVertices.hpp)
+//
+//  The denoise check holds the first synthetic frame still, adds gaussian noise at each of
+//  DENOISE_CHECK_SIGMAS and counts the cells over CELL_THRESHOLD with the filter off and on, at the
+//  default grid and at REGRESSION_GRID. With it on no cell may fire. It then runs the moving
+//  sequence both ways: the filter must keep at least DENOISE_CHECK_MOTION_KEPT of the cell sums.
+//
+//  The LOD check runs the moving sequence through the tracker at LOD_CHECK_DENSE_FEATURES. Frames with
+//  LOD_MIN_FEATURES must come out with arrows, no more than LOD_MAX_ARROWS, each one the mean of its
+//  tile's status-ok features worked out again from the result. It runs again at the default
+//  maxFeatures, which is what the app draws: no frame of that run may get arrows.
+//
+
+#ifndef Regression_hpp
+#define Regression_hpp
+
+#include <string>
+
+#define REGRESSION_FRAMES 120 //length of the synthetic sequence
+#define REGRESSION_WIDTH 640
+#define REGRESSION_HEIGHT 480
+#define REGRESSION_SEED 1
+#define REGRESSION_GRID 9
+#define REGRESSION_POSITION_TOLERANCE 0.05f //pixels a feature may move from its golden position
+#define REGRESSION_CELL_TOLERANCE 0.01 //fraction a cell sum may differ from its golden value
+#define REGRESSION_OPENCV_POSITION_TOLERANCE 0.25f //the same for the opencv run
+#define REGRESSION_OPENCV_STATUS_TOLERANCE 0.02 //fraction of a frame's statuses the opencv run may flip
+#define REGRESSION_BUDGET_HEADROOM 1.5 //recorded budgets are the measured mean times this
+
+#define DENOISE_CHECK_SIGMAS { 1.0, 2.0, 3.0 } //noise levels, grey levels
+#define DENOISE_CHECK_FRAMES 40 //noisy still frames per level
+#define DENOISE_CHECK_WARMUP 10 //of those, frames the average gets to settle before cells are counted
+#define DENOISE_CHECK_MOTION_KEPT 0.9 //fraction of real motion's cell sums that must get through
+
+#define LOD_CHECK_DENSE_FEATURES 5000 //maxFeatures for the dense run, which finds well over LOD_MIN_FEATURES
+#define LOD_CHECK_TOLERANCE 0.01f //pixels an arrow may be from the tile mean worked out again
+
+bool recordGolden(const std::string &path, bool opencv = false);
+bool recordBudget(const std::string &path, bool opencv = false);
+bool checkGolden(const std::string &path, const std::string &budgetPath);
+bool checkDenoise();
+bool checkFeatureLod();
+
+long getAllocationCount(); //allocations since startup, all threads
+long getLiveAllocationCount(); //allocations not yet freed
+
+#endif /* Regression_hpp */
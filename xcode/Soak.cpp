@@ -0,0 +1,195 @@
+//
+//  Soak.cpp
+//  Project2
+//
+
+#include "Soak.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#if defined( __APPLE__ )
+    #include <mach/mach.h>
+#elif defined( __linux__ )
+    #include <unistd.h>
+#endif
+
+#include "cinder/Log.h"
+#include "FramePipeline.hpp"
+#include "MemoryTags.hpp"
+#include "Regression.hpp"
+#include "SyntheticSource.hpp"
+
+#define SOAK_WIDTH 640
+#define SOAK_HEIGHT 480
+#define FRAME_NUMBER_WRAP 2100000000LL //a multiple of every sample window we use, so wrapping doesn't shift re-detection
+#define SOAK_LATENCY_RING 64 //submit times kept by frame number; more than the pipeline ever has in flight, divides FRAME_NUMBER_WRAP
+
+using namespace std;
+
+size_t getResidentBytes()
+{
+#if defined( __APPLE__ )
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if( task_info( mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count ) != KERN_SUCCESS )
+        return 0;
+    return info.resident_size;
+#elif defined( __linux__ )
+    ifstream statm( "/proc/self/statm" );
+    size_t pages=0, resident=0;
+    if( !(statm >> pages >> resident) )
+        return 0;
+    return resident*sysconf( _SC_PAGESIZE );
+#else
+    return 0;
+#endif
+}
+
+//one row of the soak log
+struct SoakSample {
+    long long   frames; //frames run so far
+    double      seconds; //wall time so far
+    size_t      residentBytes;
+    long        liveAllocations;
+    long long   tagBytes[MEMORY_TAGS]; //live bytes per memory tag
+    double      p50Ms, p99Ms, maxMs; //submit to publish over the last window
+    double      meanFeatures; //features tracked per frame over the last window
+};
+
+static double percentile(vector<float> &values, double fraction)
+{
+    if(values.empty())
+        return 0;
+    size_t k=min(values.size()-1, (size_t)(fraction*values.size()));
+    nth_element(values.begin(), values.begin()+k, values.end());
+    return values[k];
+}
+
+bool runSoak(long long frames, const string &csvPath)
+{
+    //render the clip once -- the soak measures the tracker, not the renderer
+    SyntheticSource source(SOAK_WIDTH, SOAK_HEIGHT);
+    vector<cv::Mat> clip(SOAK_CLIP_FRAMES);
+    for(cv::Mat &frame : clip)
+        source.next(frame);
+
+    ofstream csv;
+    if(!csvPath.empty()){
+        csv.open(csvPath);
+        if(!csv){
+            CI_LOG_E( "can't write " << csvPath );
+            return false;
+        }
+        csv << "frames,seconds,residentBytes,liveAllocations,p50Ms,p99Ms,maxMs,meanFeatures";
+        for(int tag=0; tag<MEMORY_TAGS; tag++)
+            csv << "," << memoryTagName((MemoryTag)tag) << "Bytes";
+        csv << "\n";
+    }
+
+    //frames go through the app's pipeline, so its queues, slots and buffers soak too. the clip only
+    //moves on when a frame is taken, so a full pipeline holds the source back rather than skipping frames
+    FramePipeline pipeline;
+    vector<chrono::steady_clock::time_point> submitted(SOAK_LATENCY_RING);
+    vector<float> frameMs;
+    frameMs.reserve(SOAK_SAMPLE_FRAMES); //reserved once so the window itself doesn't allocate
+    double featureSum=0;
+    int samples=0;
+    SoakSample baseline = SoakSample();
+    bool failed=false;
+    long long offered=0, tracked=0;
+    auto start=chrono::steady_clock::now();
+
+    while((frames<=0 || tracked<frames) && !failed){
+        SourceFrame frame;
+        frame.luma=clip[offered%SOAK_CLIP_FRAMES];
+        int number=(int)(offered%FRAME_NUMBER_WRAP);
+        submitted[number%SOAK_LATENCY_RING]=chrono::steady_clock::now();
+        if(pipeline.submit(frame, number))
+            offered++;
+        if(!pipeline.poll()){
+            this_thread::yield();
+            continue;
+        }
+        const TrackResult &result=pipeline.getResult();
+        frameMs.push_back(chrono::duration<float, milli>(chrono::steady_clock::now()-submitted[result.frameNumber%SOAK_LATENCY_RING]).count());
+        featureSum+=result.features.size();
+        tracked++;
+
+        if(frameMs.size()<SOAK_SAMPLE_FRAMES)
+            continue;
+
+        SoakSample sample;
+        sample.frames=tracked;
+        sample.seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        sample.residentBytes=getResidentBytes();
+        sample.liveAllocations=getLiveAllocationCount();
+        for(int tag=0; tag<MEMORY_TAGS; tag++)
+            sample.tagBytes[tag]=getMemoryStats((MemoryTag)tag).liveBytes;
+        sample.maxMs=*max_element(frameMs.begin(), frameMs.end());
+        sample.p99Ms=percentile(frameMs, 0.99);
+        sample.p50Ms=percentile(frameMs, 0.5);
+        sample.meanFeatures=featureSum/frameMs.size();
+        frameMs.clear();
+        featureSum=0;
+        samples++;
+
+        if(csv){
+            csv << sample.frames << "," << sample.seconds << "," << sample.residentBytes << "," << sample.liveAllocations << ","
+                << sample.p50Ms << "," << sample.p99Ms << "," << sample.maxMs << "," << sample.meanFeatures;
+            for(int tag=0; tag<MEMORY_TAGS; tag++)
+                csv << "," << sample.tagBytes[tag];
+            csv << endl; //flushed so a crash still leaves the log
+        }
+
+        if(samples==SOAK_WARMUP_SAMPLES+1){
+            baseline=sample;
+            CI_LOG_I( "soak baseline at " << sample.frames << " frames: " << sample.residentBytes/1024 << " KB resident, "
+                     << sample.liveAllocations << " live allocations, " << sample.meanFeatures << " features, p99 " << sample.p99Ms << " ms" );
+            continue;
+        }
+        if(samples<=SOAK_WARMUP_SAMPLES)
+            continue;
+
+        if(baseline.residentBytes>0 && sample.residentBytes>baseline.residentBytes*(1+SOAK_MAX_RSS_GROWTH)){
+            CI_LOG_E( "soak: resident memory " << sample.residentBytes/1024 << " KB, baseline " << baseline.residentBytes/1024 << " KB" );
+            failed=true;
+        }
+        if(sample.liveAllocations>baseline.liveAllocations*(1+SOAK_MAX_LIVE_GROWTH)){
+            CI_LOG_E( "soak: " << sample.liveAllocations << " live allocations, baseline " << baseline.liveAllocations );
+            failed=true;
+        }
+        for(int tag=0; tag<MEMORY_TAGS; tag++)
+            if(sample.tagBytes[tag]>baseline.tagBytes[tag]*(1+SOAK_MAX_TAG_GROWTH)+SOAK_TAG_SLACK_BYTES){
+                CI_LOG_E( "soak: " << memoryTagName((MemoryTag)tag) << " " << sample.tagBytes[tag]/1024 << " KB live, baseline "
+                         << baseline.tagBytes[tag]/1024 << " KB" );
+                failed=true;
+            }
+        if(fabs(sample.meanFeatures-baseline.meanFeatures)>baseline.meanFeatures*SOAK_MAX_FEATURE_DRIFT){
+            CI_LOG_E( "soak: " << sample.meanFeatures << " features per frame, baseline " << baseline.meanFeatures );
+            failed=true;
+        }
+        if(sample.p99Ms>baseline.p99Ms*SOAK_MAX_LATENCY_GROWTH){
+            CI_LOG_E( "soak: p99 frame time " << sample.p99Ms << " ms, baseline " << baseline.p99Ms << " ms" );
+            failed=true;
+        }
+        if(failed)
+            CI_LOG_E( "soak failed after " << sample.frames << " frames (" << sample.seconds << " s)" );
+        else
+            CI_LOG_I( "soak " << sample.frames << " frames, " << sample.frames/sample.seconds << " fps, "
+                     << sample.residentBytes/1024 << " KB, p50 " << sample.p50Ms << " ms, p99 " << sample.p99Ms << " ms" );
+    }
+
+    pipeline.stop();
+    if(!failed && pipeline.getInFlight()!=0){
+        CI_LOG_E( "soak: " << pipeline.getInFlight() << " frames still counted in flight after stop()" );
+        failed=true;
+    }
+    if(!failed)
+        CI_LOG_I( "soak passed, " << pipeline.getDropped() << " submits refused while the pipeline was full" );
+    return !failed;
+}
@@ -0,0 +1,37 @@
+//
+//  Soak.hpp
+//  Project2
+//
+//  Long-run check for leaks and slow drift. Loops a pre-rendered synthetic clip through a
+//  FramePipeline -- the app's worker threads, queues and result slots -- as fast as it will go (no
+//  camera, no window, no vsync), and every SOAK_SAMPLE_FRAMES tracked frames samples resident
+//  memory, live allocations (counted in every build, see Regression.hpp), submit-to-publish latency
+//  percentiles, the mean feature count and live bytes per memory tag (MemoryTags.hpp). Once past
+//  warm-up, the first sample is the baseline; the run fails as soon as any later sample drifts past
+//  the limits below, or if frames are still counted in flight after the pipeline stops.
+//
+//      Project2 --soak 1000000000 soak.csv    frames to run, then a CSV of every sample
+//
+
+#ifndef Soak_hpp
+#define Soak_hpp
+
+#include <cstddef>
+#include <string>
+
+#define SOAK_CLIP_FRAMES 240 //length of the clip that gets looped
+#define SOAK_SAMPLE_FRAMES 20000 //frames between samples
+#define SOAK_WARMUP_SAMPLES 2 //samples skipped before the baseline is taken
+#define SOAK_MAX_RSS_GROWTH 0.25 //fraction resident memory may grow over the baseline
+#define SOAK_MAX_LIVE_GROWTH 0.10 //fraction live allocations may grow over the baseline
+#define SOAK_MAX_TAG_GROWTH 0.10 //fraction a memory tag's live bytes may grow over the baseline
+#define SOAK_TAG_SLACK_BYTES (256*1024) //on top of that, so a tag that starts near 0 can't fail on a buffer resize
+#define SOAK_MAX_FEATURE_DRIFT 0.10 //fraction the mean feature count may move either way from the baseline
+#define SOAK_MAX_LATENCY_GROWTH 1.5 //p99 latency may be at most this times the baseline p99
+
+//runs until frames frames are tracked (0 = until it fails). writes a CSV row per sample to csvPath if it isn't empty
+bool runSoak(long long frames, const std::string &csvPath);
+
+size_t getResidentBytes(); //resident set size of this process, 0 if it can't be read
+
+#endif /* Soak_hpp */
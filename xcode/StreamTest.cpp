@@ -0,0 +1,188 @@
+//
+//  StreamTest.cpp
+//  Project2
+//
+
+#include "StreamTest.hpp"
+
+#include <chrono>
+#include <random>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+
+#include "cinder/Log.h"
+#include "FeatureTracker.hpp"
+#include "SyntheticSource.hpp"
+#include "TrackStream.hpp"
+
+extern char **environ;
+
+using namespace std;
+
+bool runStreamTest(const string &executable, int hosts, double seconds)
+{
+    //side by side on the floor: camera k's frame covers world x in [k*strip, (k+1)*strip)
+    map<int, Homography> homographies;
+    double strip=STREAM_TEST_WIDTH*STREAM_TEST_METRES_PER_PIXEL;
+    for(int k=0; k<hosts; k++){
+        homographies[k].h[0]=homographies[k].h[4]=STREAM_TEST_METRES_PER_PIXEL;
+        homographies[k].h[2]=k*strip;
+    }
+
+    TrackAggregator aggregator(STREAM_PORT, homographies);
+    if(!aggregator.isOpen())
+        return false;
+
+    string address="127.0.0.1:"+to_string(STREAM_PORT), duration=to_string(seconds);
+    vector<pid_t> children;
+    for(int k=0; k<hosts; k++){
+        string camera=to_string(k);
+        const char *argv[]={ executable.c_str(), "--stream-host", address.c_str(), camera.c_str(), duration.c_str(), nullptr };
+        pid_t pid;
+        if(posix_spawn(&pid, executable.c_str(), nullptr, nullptr, (char* const*)argv, environ)!=0){
+            CI_LOG_E( "can't start " << executable );
+            continue;
+        }
+        children.push_back(pid);
+    }
+
+    bool failed= (int)children.size()<hosts;
+    for(pid_t pid : children){
+        int status=0;
+        waitpid(pid, &status, 0);
+        if(!WIFEXITED(status) || WEXITSTATUS(status)!=0)
+            failed=true;
+    }
+    this_thread::sleep_for(chrono::milliseconds(200)); //the last packets are still in the socket buffer
+
+    //every camera's last frame should sit in its own strip
+    vector<WorldFeature> world;
+    aggregator.snapshot(world);
+    int outside=0;
+    for(const WorldFeature &f : world)
+        if(f.position.x<f.camera*strip-1e-3 || f.position.x>(f.camera+1)*strip+1e-3)
+            outside++;
+    long long tracks=aggregator.getTracks(), handOffs=aggregator.getHandOffs();
+    aggregator.stop();
+
+    map<int, TrackAggregator::CameraStats> stats=aggregator.getStats();
+    for(int k=0; k<hosts; k++){
+        const TrackAggregator::CameraStats &camera=stats[k];
+        double loss= camera.frames+camera.lost>0 ? camera.lost/(double)(camera.frames+camera.lost) : 1;
+        CI_LOG_I( "aggregator, camera " << k << ": " << camera.frames/seconds << " frames/s, " << camera.packets/seconds << " packets/s, "
+                 << camera.bytes/1024.0/seconds << " KB/s, " << camera.lost << " frames lost (" << loss*100 << "%)" );
+        if(loss>STREAM_TEST_MAX_LOSS)
+            failed=true;
+    }
+    if(outside>0){
+        CI_LOG_E( "stream test: " << outside << " of " << world.size() << " world features outside their camera's strip" );
+        failed=true;
+    }
+
+    CI_LOG_I( "stream test " << (failed ? "failed" : "passed") << ": " << hosts << " hosts, " << world.size() << " features in the merged frame, "
+             << tracks << " tracks, " << handOffs << " handed on" );
+    return !failed;
+}
+
+bool runStreamHost(const string &address, int camera, double seconds)
+{
+    TrackSender sender(address, camera);
+    if(!sender.isOpen())
+        return false;
+
+    //render the clip once, the host measures tracking and sending
+    SyntheticSource source(STREAM_TEST_WIDTH, STREAM_TEST_HEIGHT, 1+camera);
+    vector<cv::Mat> clip(STREAM_TEST_CLIP_FRAMES);
+    for(cv::Mat &frame : clip)
+        source.next(frame);
+
+    FeatureTracker tracker;
+    TrackResult result;
+    auto start=chrono::steady_clock::now();
+    double elapsed=0;
+    for(int frame=0; elapsed<seconds; frame++){
+        tracker.process(clip[frame%STREAM_TEST_CLIP_FRAMES], frame);
+        tracker.snapshot(result);
+        sender.send(result);
+        elapsed=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    }
+
+    CI_LOG_I( "host, camera " << camera << ": " << sender.getFrames()/elapsed << " frames/s, " << sender.getPackets()/elapsed << " packets/s, "
+             << sender.getBytes()/1024.0/elapsed << " KB/s, " << sender.getDropped() << " packets dropped" );
+    return true;
+}
+
+bool checkHandOff()
+{
+    const int points=HANDOFF_CHECK_COLS*HANDOFF_CHECK_ROWS, frames=150;
+    const double frameSeconds=1/30.0;
+    const float strip=STREAM_TEST_WIDTH*STREAM_TEST_METRES_PER_PIXEL, overlap=0.2f; //camera 1 starts overlap before camera 0 ends
+    mt19937 rng(1);
+    auto noise=[&rng](){ return ((float)(rng()/4294967296.0)*2-1)*HANDOFF_CHECK_NOISE; };
+
+    TrackHandOff handOff;
+    vector<int> truth(points, -1); //the id camera 0 gave each point
+    vector<WorldFeature> seen0, seen1;
+    long long checked=0, wrong=0, merged=0;
+    for(int frame=0; frame<frames; frame++){
+        double now=frame*frameSeconds;
+        float step=HANDOFF_CHECK_SPEED*(float)frameSeconds;
+        seen0.clear();
+        seen1.clear();
+        for(int p=0; p<points; p++){
+            cv::Point2f at(strip-2.5f+(p%HANDOFF_CHECK_COLS)*HANDOFF_CHECK_SPACING+frame*step, (p/HANDOFF_CHECK_COLS)*HANDOFF_CHECK_SPACING);
+            if(at.x<strip)
+                seen0.push_back({ 0, p, -1, at, cv::Point2f(step, 0) });
+            if(at.x>=strip-overlap)
+                seen1.push_back({ 1, p, -1, at+cv::Point2f(noise(), noise()), cv::Point2f(step+noise()*0.1f, noise()*0.1f) });
+        }
+        handOff.update(0, 0, seen0, now, frameSeconds);
+        for(const WorldFeature &f : seen0)
+            if(truth[f.id]<0)
+                truth[f.id]=f.track;
+        handOff.update(1, frame/HANDOFF_CHECK_EPOCH, seen1, now, frameSeconds);
+
+        vector<int> ids;
+        for(const WorldFeature &f : seen1){
+            checked++;
+            if(f.track!=truth[f.id])
+                wrong++;
+            ids.push_back(f.track);
+        }
+        sort(ids.begin(), ids.end());
+        merged+=ids.end()-unique(ids.begin(), ids.end());
+    }
+
+    //a fresh floor: camera 0 tracks the crowd for a few frames and goes quiet with them live. camera 1,
+    //HANDOFF_CHECK_STALE later, starts a track on each of them, moving the same way: camera 0's are long
+    //stale, so none may inherit
+    TrackHandOff quiet;
+    vector<WorldFeature> frozen;
+    for(int frame=0; frame<5; frame++){
+        float step=HANDOFF_CHECK_SPEED*(float)frameSeconds;
+        frozen.clear();
+        for(int p=0; p<points; p++)
+            frozen.push_back({ 0, p, -1, cv::Point2f((p%HANDOFF_CHECK_COLS)*HANDOFF_CHECK_SPACING+frame*step, (p/HANDOFF_CHECK_COLS)*HANDOFF_CHECK_SPACING), cv::Point2f(step, 0) });
+        quiet.update(0, 0, frozen, frame*frameSeconds, frameSeconds);
+    }
+    vector<int> stale(points);
+    for(WorldFeature &f : frozen){
+        stale[f.id]=f.track;
+        f.camera=1;
+        f.track=-1;
+    }
+    quiet.update(1, 0, frozen, 4*frameSeconds+HANDOFF_CHECK_STALE, frameSeconds);
+    long long inherited=0;
+    for(const WorldFeature &f : frozen)
+        if(f.track==stale[f.id])
+            inherited++;
+
+    bool passed= checked>0 && merged==0 && wrong<=HANDOFF_CHECK_WRONG*checked && !frozen.empty() && inherited==0;
+    CI_LOG_I( "hand-off, " << points << " points " << HANDOFF_CHECK_SPACING << " m apart: " << wrong << " of " << checked
+             << " camera 1 tracks with the wrong id, " << merged << " sharing one, " << handOff.getHandOffs() << " hand-offs; "
+             << inherited << " of " << frozen.size() << " took a stale camera's id" );
+    CI_LOG_I( "hand-off check " << (passed ? "PASSED" : "FAILED") );
+    return passed;
+}
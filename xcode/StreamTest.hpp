@@ -0,0 +1,55 @@
+//
+//  StreamTest.hpp
+//  Project2
+//
+//  The multi-host setup from TrackStream.hpp on one machine. Starts an aggregator on loopback
+//  with the cameras laid side by side on the floor (camera k shifted k frame widths right), then
+//  launches hosts copies of this executable as separate processes. Each one tracks its own
+//  synthetic clip flat out and streams every frame to the aggregator. Afterwards the per-host
+//  throughput is logged from both ends; the run fails if any camera lost more than
+//  STREAM_TEST_MAX_LOSS of its frames or a feature landed outside its camera's strip of the world.
+//
+//      Project2 --stream-test 4 10                 4 hosts for 10 seconds
+//      Project2 --stream-host 127.0.0.1:7400 2 10  one host on its own: camera 2, 10 seconds
+//      Project2 --check-handoff                    TrackHandOff on a crowd, no network
+//
+//  The hand-off check walks a crowd of HANDOFF_CHECK_COLS x HANDOFF_CHECK_ROWS points, much closer
+//  together than HANDOFF_GATE, from camera 0's strip of the floor into camera 1's at walking pace.
+//  Camera 1 sees them with a little noise and re-detects every HANDOFF_CHECK_EPOCH frames, so each
+//  point is handed on once across the cameras and again at every re-detection. Every track camera
+//  1 reports must carry the id camera 0 gave that point (at most HANDOFF_CHECK_WRONG of them may
+//  not), and no two of one frame's tracks may share an id. Camera 0 then stops sending, and
+//  HANDOFF_CHECK_STALE seconds later camera 1 starts new tracks right where camera 0's froze: none may
+//  take one of camera 0's ids.
+//
+
+#ifndef StreamTest_hpp
+#define StreamTest_hpp
+
+#include <string>
+
+#define STREAM_TEST_WIDTH 640
+#define STREAM_TEST_HEIGHT 480
+#define STREAM_TEST_METRES_PER_PIXEL 0.01 //scale of the test's ground plane, so the hand-off gates mean what they usually do
+#define STREAM_TEST_CLIP_FRAMES 120 //length of each host's looped clip
+#define STREAM_TEST_MAX_LOSS 0.01 //fraction of frames a camera may lose
+
+#define HANDOFF_CHECK_COLS 20
+#define HANDOFF_CHECK_ROWS 15
+#define HANDOFF_CHECK_SPACING 0.1f //metres between the crowd's points
+#define HANDOFF_CHECK_SPEED 1.0f //metres per second
+#define HANDOFF_CHECK_NOISE 0.01f //metres of position noise in camera 1's view
+#define HANDOFF_CHECK_EPOCH 30 //camera 1 re-detects this often, frames
+#define HANDOFF_CHECK_WRONG 0.01 //fraction of camera 1's tracks that may have the wrong id
+#define HANDOFF_CHECK_STALE 2.0 //seconds camera 0 is quiet before camera 1 starts tracks on its frozen ones
+
+//executable is this program (argv[0]), started again with --stream-host for every host
+bool runStreamTest(const std::string &executable, int hosts, double seconds);
+
+//one host: tracks a synthetic clip seeded by camera and streams it to address (host:port) for seconds
+bool runStreamHost(const std::string &address, int camera, double seconds);
+
+//the crowd above through a TrackHandOff
+bool checkHandOff();
+
+#endif /* StreamTest_hpp */
@@ -0,0 +1,67 @@
+//
+//  SyntheticSource.cpp
+//  Project2
+//
+
+#include "SyntheticSource.hpp"
+
+#include <algorithm>
+#include <random>
+
+#define TEXTURE_BLOCK 8 //size of each flat block in the background -- the block edges are the corners we track
+#define SCROLL_X 1 //background motion in pixels per frame
+#define SCROLL_Y 1
+#define SQUARE_SIZE 48
+#define SQUARE_STEP_X 3 //square motion in pixels per frame
+#define SQUARE_STEP_Y 2
+
+SyntheticSource::SyntheticSource(int width, int height, uint32_t seed)
+{
+    mWidth=width;
+    mHeight=height;
+    mFrameNumber=0;
+
+    //std::mt19937 gives the same numbers everywhere (the std distributions don't, so we don't use them)
+    std::mt19937 rng(seed);
+    mTexture.create(height, width, CV_8UC1);
+    int blocksX=(width+TEXTURE_BLOCK-1)/TEXTURE_BLOCK;
+    int blocksY=(height+TEXTURE_BLOCK-1)/TEXTURE_BLOCK;
+    for(int by=0; by<blocksY; by++){
+        for(int bx=0; bx<blocksX; bx++){
+            uint8_t value=(uint8_t)(40+rng()%160); //stay off black and white so the square stands out
+            for(int y=by*TEXTURE_BLOCK; y<std::min(height, (by+1)*TEXTURE_BLOCK); y++)
+                for(int x=bx*TEXTURE_BLOCK; x<std::min(width, (bx+1)*TEXTURE_BLOCK); x++)
+                    mTexture.at<uint8_t>(y, x)=value;
+        }
+    }
+}
+
+void SyntheticSource::next(cv::Mat &gray)
+{
+    gray.create(mHeight, mWidth, CV_8UC1);
+
+    //scrolled background, wrapping around the texture
+    int offsetX=(mFrameNumber*SCROLL_X)%mWidth;
+    int offsetY=(mFrameNumber*SCROLL_Y)%mHeight;
+    for(int y=0; y<mHeight; y++){
+        const uint8_t *src=mTexture.ptr<uint8_t>((y+offsetY)%mHeight);
+        uint8_t *dst=gray.ptr<uint8_t>(y);
+        for(int x=0; x<mWidth; x++)
+            dst[x]=src[(x+offsetX)%mWidth];
+    }
+
+    //the square bounces back and forth across the frame
+    int rangeX=std::max(1, mWidth-SQUARE_SIZE);
+    int rangeY=std::max(1, mHeight-SQUARE_SIZE);
+    int sx=(mFrameNumber*SQUARE_STEP_X)%(2*rangeX);
+    int sy=(mFrameNumber*SQUARE_STEP_Y)%(2*rangeY);
+    if(sx>=rangeX) sx=2*rangeX-sx;
+    if(sy>=rangeY) sy=2*rangeY-sy;
+    for(int y=sy; y<std::min(mHeight, sy+SQUARE_SIZE); y++){
+        uint8_t *dst=gray.ptr<uint8_t>(y);
+        for(int x=sx; x<std::min(mWidth, sx+SQUARE_SIZE); x++)
+            dst[x]=250;
+    }
+
+    mFrameNumber++;
+}
@@ -0,0 +1,33 @@
+//
+//  SyntheticSource.hpp
+//  Project2
+//
+//  Makes 8-bit gray frames without a camera: a blocky random texture scrolling at a fixed
+//  speed with a bright square moving across it. Everything comes from the seed, so the same
+//  seed always gives the same frames on every machine.
+//
+
+#ifndef SyntheticSource_hpp
+#define SyntheticSource_hpp
+
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+
+class SyntheticSource {
+public:
+    SyntheticSource(int width, int height, uint32_t seed = 1);
+
+    void next(cv::Mat &gray); //renders the next frame into gray (reallocated only if the size is wrong)
+    void rewind() { mFrameNumber=0; }
+
+    int getFrameNumber() const { return mFrameNumber; } //frames rendered so far
+    int getWidth() const { return mWidth; }
+    int getHeight() const { return mHeight; }
+
+protected:
+    int        mWidth, mHeight;
+    int        mFrameNumber;
+    cv::Mat    mTexture; //background, tiles so it can scroll forever
+};
+
+#endif /* SyntheticSource_hpp */
@@ -0,0 +1,500 @@
+//
+//  TrackStream.cpp
+//  Project2
+//
+
+#include "TrackStream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "cinder/Log.h"
+#include "Grid.hpp"
+
+#define CAMERA_HEADER_BYTES 32
+#define CAMERA_FEATURE_BYTES 10
+#define WORLD_HEADER_BYTES 12
+#define WORLD_FEATURE_BYTES 24
+#define FRAME_SECONDS_SMOOTHING 0.1 //weight of the newest interval in Camera::frameSeconds
+#define RECEIVE_TIMEOUT_MS 100 //how often the receiver looks at mStopping
+#define SOCKET_BUFFER_BYTES (4 << 20) //room for a few frames from every camera while the receiver is busy
+#define AGGREGATOR_LOG_SECONDS 5
+
+using namespace std;
+
+//the wire is little-endian, and so is every host this runs on (x86, Apple silicon), so fields are copied as they are
+template<class T> static void put(uint8_t *&p, T value)
+{
+    memcpy(p, &value, sizeof(T));
+    p+=sizeof(T);
+}
+
+template<class T> static T get(const uint8_t *&p)
+{
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p+=sizeof(T);
+    return value;
+}
+
+static int16_t toFixed(float v)
+{
+    return (int16_t)max(-32768.f, min(32767.f, roundf(v*STREAM_FIXED_POINT)));
+}
+
+static uint16_t toFixedPosition(float v)
+{
+    return (uint16_t)max(0.f, min(65535.f, roundf(v*STREAM_FIXED_POINT)));
+}
+
+//host:port -> sockaddr_in. false if the host doesn't resolve or there is no port
+static bool parseAddress(const string &address, sockaddr_in &out)
+{
+    size_t colon=address.rfind(':');
+    if(colon==string::npos || colon+1==address.size())
+        return false;
+    string host=address.substr(0, colon), port=address.substr(colon+1);
+
+    addrinfo hints, *found=nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family=AF_INET;
+    hints.ai_socktype=SOCK_DGRAM;
+    if(getaddrinfo(host.empty() ? "127.0.0.1" : host.c_str(), port.c_str(), &hints, &found)!=0 || !found)
+        return false;
+    memcpy(&out, found->ai_addr, sizeof(out));
+    freeaddrinfo(found);
+    return true;
+}
+
+static int openSender()
+{
+    int s=socket(AF_INET, SOCK_DGRAM, 0);
+    if(s<0)
+        return -1;
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    int size=SOCKET_BUFFER_BYTES;
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    return s;
+}
+
+TrackSender::TrackSender(const string &address, int camera, bool field)
+    : mSocket(-1), mAddress(sizeof(sockaddr_in)), mCamera(camera), mField(field), mSequence(0), mFrames(0), mPackets(0), mBytes(0), mDropped(0)
+{
+    mSession=random_device()() ^ (uint32_t)chrono::steady_clock::now().time_since_epoch().count();
+    if(!parseAddress(address, *(sockaddr_in*)mAddress.data())){
+        CI_LOG_E( "can't resolve " << address << ", expected host:port" );
+        return;
+    }
+    mSocket=openSender();
+    mPacket.resize(STREAM_MAX_PACKET);
+}
+
+TrackSender::~TrackSender()
+{
+    if(mSocket>=0)
+        close(mSocket);
+}
+
+void TrackSender::send(const TrackResult &result)
+{
+    if(mSocket<0)
+        return;
+
+    //with a lens the features and the cells both go out undistorted, so one homography holds for both
+    bool lens= !result.undistorted.empty() && result.undistorted.size()==result.features.size() &&
+               result.undistortedPrev.size()==result.prevFeatures.size();
+    const vector<cv::Point2f> &features= lens ? result.undistorted : result.features;
+    const vector<cv::Point2f> &prevFeatures= lens ? result.undistortedPrev : result.prevFeatures;
+
+    mSend.clear();
+    for(size_t i=0; i<features.size() && i<result.featureStatuses.size(); i++)
+        if(result.featureStatuses[i])
+            mSend.push_back((int)i);
+
+    //the grid only goes if its bitmask leaves room for features in the first packet. a bent grid has
+    //no centres the aggregator could work out, so its fired cells go as entries at their undistorted
+    //centres instead, with id STREAM_CELL_ID
+    int n= result.n*result.n==(int)result.cellSums.size() && result.n<256 ? result.n : 0;
+    mCells.clear();
+    if(n>0 && result.cellCorners.size()==(size_t)((n+1)*(n+1))){
+        for(int c=0; c<n*n; c++)
+            if(result.cellSums[c]>CELL_THRESHOLD){
+                int i=c%n, j=c/n;
+                const cv::Point2f *top=&result.cellCorners[j*(n+1)+i], *bottom=top+n+1;
+                mCells.push_back((top[0]+top[1]+bottom[0]+bottom[1])*0.25f);
+            }
+        n=0;
+    }
+    int maskBytes=(n*n+7)/8;
+    if(maskBytes > (STREAM_MAX_PACKET-CAMERA_HEADER_BYTES)/2){
+        n=0;
+        maskBytes=0;
+    }
+
+    int firstCapacity=(STREAM_MAX_PACKET-CAMERA_HEADER_BYTES-maskBytes)/CAMERA_FEATURE_BYTES;
+    int capacity=(STREAM_MAX_PACKET-CAMERA_HEADER_BYTES)/CAMERA_FEATURE_BYTES;
+    //the field cells that move at least one wire step, at their centres in the same space as the
+    //features, with their motion scaled into it too
+    mFieldAt.clear();
+    mFieldMotion.clear();
+    const FlowField &flow=result.flow;
+    bool placed= !lens || result.fieldCentres.size()==flow.vectors.size(); //with a lens the centres have to be there
+    if(mField && placed && flow.vectors.size()==(size_t)(flow.cols*flow.rows)){
+        for(int cell=0; cell<flow.cols*flow.rows; cell++){
+            cv::Point2f motion=flow.vectors[cell]*(lens ? result.lensScale : 1.f);
+            if(toFixed(motion.x)==0 && toFixed(motion.y)==0)
+                continue;
+            mFieldAt.push_back(lens ? result.fieldCentres[cell] : cv::Point2f(((cell%flow.cols)+0.5f)*flow.cellSize, ((cell/flow.cols)+0.5f)*flow.cellSize));
+            mFieldMotion.push_back(motion);
+        }
+    }
+
+    int count=(int)(mCells.size()+mSend.size()+mFieldAt.size());
+    int parts= count<=firstCapacity ? 1 : 1+(count-firstCapacity+capacity-1)/capacity;
+    parts=min(parts, 255); //a frame that needs more than this is cut short
+    uint32_t sequence=mSequence++;
+
+    int next=0;
+    for(int part=0; part<parts; part++){
+        int take=min(count-next, part==0 ? firstCapacity : capacity);
+        uint8_t *p=mPacket.data();
+        memcpy(p, "TRK2", 4);
+        p+=4;
+        put<uint16_t>(p, (uint16_t)mCamera);
+        put<uint8_t>(p, (uint8_t)part);
+        put<uint8_t>(p, (uint8_t)parts);
+        put<uint32_t>(p, mSession);
+        put<uint32_t>(p, sequence);
+        put<int32_t>(p, result.frameNumber);
+        put<int32_t>(p, result.epoch);
+        put<uint16_t>(p, (uint16_t)result.frameSize.width);
+        put<uint16_t>(p, (uint16_t)result.frameSize.height);
+        put<uint8_t>(p, (uint8_t)(part==0 ? n : 0));
+        put<uint8_t>(p, 0);
+        put<uint16_t>(p, (uint16_t)take);
+
+        if(part==0 && n>0){
+            memset(p, 0, maskBytes);
+            for(int c=0; c<n*n; c++)
+                if(result.cellSums[c]>CELL_THRESHOLD)
+                    p[c/8]|=1 << (c%8);
+            p+=maskBytes;
+        }
+
+        //cells, then features, then field cells
+        for(int k=0; k<take; k++, next++){
+            int id;
+            cv::Point2f at, motion;
+            int feature=next-(int)mCells.size(), field=feature-(int)mSend.size();
+            if(feature<0){
+                id=STREAM_CELL_ID;
+                at=mCells[next];
+            }
+            else if(field<0){
+                id=mSend[feature];
+                at=features[id];
+                motion=at-prevFeatures[id];
+            }
+            else{
+                id=STREAM_FIELD_ID;
+                at=mFieldAt[field];
+                motion=mFieldMotion[field];
+            }
+            put<uint16_t>(p, (uint16_t)id);
+            put<uint16_t>(p, toFixedPosition(at.x));
+            put<uint16_t>(p, toFixedPosition(at.y));
+            put<int16_t>(p, toFixed(motion.x));
+            put<int16_t>(p, toFixed(motion.y));
+        }
+
+        size_t size=p-mPacket.data();
+        if(sendto(mSocket, mPacket.data(), size, 0, (const sockaddr*)mAddress.data(), sizeof(sockaddr_in))<0)
+            mDropped++; //EAGAIN: the socket buffer is full and we don't wait for it
+        else{
+            mPackets++;
+            mBytes+=size;
+        }
+    }
+    mFrames++;
+}
+
+TrackAggregator::TrackAggregator(int port, const map<int, Homography> &homographies, const string &publishAddress)
+    : mSocket(-1), mPublishSocket(-1), mHomographies(homographies), mStarted(chrono::steady_clock::now()), mStopping(false), mPublished(0)
+{
+    int s=socket(AF_INET, SOCK_DGRAM, 0);
+    if(s<0)
+        return;
+    int size=SOCKET_BUFFER_BYTES, reuse=1;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    timeval timeout={ 0, RECEIVE_TIMEOUT_MS*1000 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family=AF_INET;
+    local.sin_addr.s_addr=htonl(INADDR_ANY);
+    local.sin_port=htons((uint16_t)port);
+    if(::bind(s, (const sockaddr*)&local, sizeof(local))<0){
+        CI_LOG_E( "can't listen on port " << port << ": " << strerror(errno) );
+        close(s);
+        return;
+    }
+    mSocket=s;
+
+    if(!publishAddress.empty()){
+        mPublishAddress.resize(sizeof(sockaddr_in));
+        if(parseAddress(publishAddress, *(sockaddr_in*)mPublishAddress.data()))
+            mPublishSocket=openSender();
+        else
+            CI_LOG_E( "can't resolve " << publishAddress << ", not republishing" );
+    }
+
+    mReceiver=thread(&TrackAggregator::receiveLoop, this);
+    if(mPublishSocket>=0)
+        mPublisher=thread(&TrackAggregator::publishLoop, this);
+}
+
+TrackAggregator::~TrackAggregator()
+{
+    stop();
+}
+
+void TrackAggregator::stop()
+{
+    mStopping=true;
+    if(mReceiver.joinable())
+        mReceiver.join();
+    if(mPublisher.joinable())
+        mPublisher.join();
+    if(mSocket>=0)
+        close(mSocket);
+    if(mPublishSocket>=0)
+        close(mPublishSocket);
+    mSocket=mPublishSocket=-1;
+}
+
+map<int, TrackAggregator::CameraStats> TrackAggregator::getStats() const
+{
+    lock_guard<mutex> lock(mMutex);
+    map<int, CameraStats> stats;
+    for(const auto &camera : mCameras)
+        stats[camera.first]=camera.second.stats;
+    return stats;
+}
+
+void TrackAggregator::snapshot(vector<WorldFeature> &features) const
+{
+    lock_guard<mutex> lock(mMutex);
+    features.clear();
+    auto now=chrono::steady_clock::now();
+    for(const auto &camera : mCameras)
+        if(camera.second.stats.frames>0 && chrono::duration<double>(now-camera.second.completed).count()<STREAM_STALE_SECONDS)
+            features.insert(features.end(), camera.second.latest.begin(), camera.second.latest.end());
+}
+
+long long TrackAggregator::getHandOffs() const
+{
+    lock_guard<mutex> lock(mMutex);
+    return mHandOff.getHandOffs();
+}
+
+long long TrackAggregator::getTracks() const
+{
+    lock_guard<mutex> lock(mMutex);
+    return mHandOff.getTracks();
+}
+
+void TrackAggregator::receiveLoop()
+{
+    vector<uint8_t> buffer(65536);
+    while(!mStopping){
+        ssize_t size=recv(mSocket, buffer.data(), buffer.size(), 0);
+        if(size>0)
+            receive(buffer.data(), size); //timeouts and errors just go round again
+    }
+}
+
+void TrackAggregator::receive(const uint8_t *data, size_t size)
+{
+    if(size<CAMERA_HEADER_BYTES || memcmp(data, "TRK2", 4)!=0)
+        return;
+    const uint8_t *p=data+4;
+    int camera=get<uint16_t>(p);
+    int part=get<uint8_t>(p), parts=get<uint8_t>(p);
+    uint32_t session=get<uint32_t>(p);
+    long long sequence=get<uint32_t>(p);
+    int frameNumber=get<int32_t>(p), epoch=get<int32_t>(p);
+    int width=get<uint16_t>(p), height=get<uint16_t>(p);
+    int n=get<uint8_t>(p);
+    get<uint8_t>(p);
+    int count=get<uint16_t>(p);
+    int maskBytes=(n*n+7)/8;
+    if(part>=parts || CAMERA_HEADER_BYTES+maskBytes+(size_t)count*CAMERA_FEATURE_BYTES>size)
+        return;
+
+    lock_guard<mutex> lock(mMutex);
+    Camera &c=mCameras[camera];
+    c.stats.packets++;
+    c.stats.bytes+=size;
+
+    //the ground plane LUT, built the first time this camera's frame size is seen
+    cv::Size frameSize(width, height);
+    if(c.lut.getFrameSize().width!=width || c.lut.getFrameSize().height!=height){
+        auto found=mHomographies.find(camera);
+        c.lut.build(found!=mHomographies.end() ? found->second : Homography(), frameSize);
+    }
+
+    //a new session is the sender starting over from sequence 0: forget where the old one had got to
+    if(!c.started || session!=c.session){
+        if(c.started){
+            c.stats.restarts++;
+            if(c.assembling>=0 && c.partsSeen<c.parts)
+                c.stats.lost++;
+        }
+        c.started=true;
+        c.session=session;
+        c.assembling=-1;
+        c.stats.lastSequence=-1;
+        c.partsSeen=c.parts=0;
+        c.partial.clear();
+    }
+
+    if(sequence!=c.assembling){
+        long long last=max(c.stats.lastSequence, c.assembling);
+        if(sequence<last) //late, its frame has already been given up on
+            return;
+        if(c.assembling>=0 && c.partsSeen<c.parts) //the frame before never completed
+            c.stats.lost++;
+        if(last>=0)
+            c.stats.lost+=sequence-last-1; //frames that never showed up at all
+        c.assembling=sequence;
+        c.partsSeen=0;
+        c.parts=parts;
+        c.partsReceived.reset();
+        c.partial.clear();
+    }
+    if(c.partsReceived[part]) //a duplicate (or a part of a frame that already completed)
+        return;
+    c.partsReceived[part]=true;
+
+    //fired cells as their world centres
+    for(int cell=0; cell<n*n; cell++)
+        if(p[cell/8] & (1 << (cell%8))){
+            cv::Point2f centre(((cell%n)+0.5f)*width/n, ((cell/n)+0.5f)*height/n);
+            c.partial.push_back({ camera, STREAM_CELL_ID, -1, c.lut.map(centre.x, centre.y), cv::Point2f(0, 0) });
+        }
+    p+=maskBytes;
+
+    //features: the world motion is the difference of both ends, so it follows the perspective. an
+    //entry with id STREAM_CELL_ID is a fired cell sent by its centre (a sender with a lens), one
+    //with STREAM_FIELD_ID a flow field cell, which goes through like a feature
+    for(int k=0; k<count; k++){
+        int id=get<uint16_t>(p);
+        float x=get<uint16_t>(p)/STREAM_FIXED_POINT, y=get<uint16_t>(p)/STREAM_FIXED_POINT;
+        float dx=get<int16_t>(p)/STREAM_FIXED_POINT, dy=get<int16_t>(p)/STREAM_FIXED_POINT;
+        if(id==STREAM_CELL_ID){
+            c.partial.push_back({ camera, STREAM_CELL_ID, -1, c.lut.map(x, y), cv::Point2f(0, 0) });
+            continue;
+        }
+        cv::Point2f at=c.lut.map(x, y), from=c.lut.map(x-dx, y-dy);
+        c.partial.push_back({ camera, id, -1, at, at-from });
+    }
+
+    if(++c.partsSeen==c.parts){
+        auto now=chrono::steady_clock::now();
+        if(c.stats.frames>0)
+            c.frameSeconds+=(chrono::duration<double>(now-c.completed).count()-c.frameSeconds)*FRAME_SECONDS_SMOOTHING;
+        c.completed=now;
+        mHandOff.update(camera, epoch, c.partial, chrono::duration<double>(now-mStarted).count(), c.frameSeconds);
+        c.latest.swap(c.partial);
+        c.stats.frames++;
+        c.stats.lastFrame=frameNumber;
+        c.stats.lastSequence=sequence;
+        c.stats.epoch=epoch;
+        c.stats.features=(int)count_if(c.latest.begin(), c.latest.end(), [](const WorldFeature &f){ return f.id!=STREAM_CELL_ID && f.id!=STREAM_FIELD_ID; });
+    }
+}
+
+void TrackAggregator::publishLoop()
+{
+    vector<WorldFeature> features;
+    vector<uint8_t> packet(STREAM_MAX_PACKET);
+    uint32_t sequence=0;
+    auto interval=chrono::microseconds(1000000/STREAM_PUBLISH_RATE);
+    auto next=chrono::steady_clock::now();
+    int capacity=(STREAM_MAX_PACKET-WORLD_HEADER_BYTES)/WORLD_FEATURE_BYTES;
+
+    while(!mStopping){
+        next+=interval;
+        this_thread::sleep_until(next);
+        snapshot(features);
+
+        int count=(int)features.size();
+        int parts=min(255, max(1, (count+capacity-1)/capacity));
+        int sent=0;
+        for(int part=0; part<parts; part++){
+            int take=min(count-sent, capacity);
+            uint8_t *p=packet.data();
+            memcpy(p, "WRL2", 4);
+            p+=4;
+            put<uint8_t>(p, (uint8_t)part);
+            put<uint8_t>(p, (uint8_t)parts);
+            put<uint32_t>(p, sequence);
+            put<uint16_t>(p, (uint16_t)take);
+            for(int k=0; k<take; k++){
+                const WorldFeature &f=features[sent++];
+                put<uint16_t>(p, (uint16_t)f.camera); //as wide as in the camera packets
+                put<uint16_t>(p, (uint16_t)f.id);
+                put<int32_t>(p, f.track);
+                put<float>(p, f.position.x);
+                put<float>(p, f.position.y);
+                put<float>(p, f.motion.x);
+                put<float>(p, f.motion.y);
+            }
+            if(sendto(mPublishSocket, packet.data(), p-packet.data(), 0, (const sockaddr*)mPublishAddress.data(), sizeof(sockaddr_in))>=0)
+                mPublished++;
+        }
+        sequence++;
+    }
+}
+
+bool runAggregator(int port, const string &homographyPath, const string &publishAddress)
+{
+    map<int, Homography> homographies;
+    if(!homographyPath.empty() && !loadHomographies(homographyPath, homographies)){
+        CI_LOG_E( "can't read homographies from " << homographyPath );
+        return false;
+    }
+    TrackAggregator aggregator(port, homographies, publishAddress);
+    if(!aggregator.isOpen())
+        return false;
+    CI_LOG_I( "aggregating on port " << port << ", " << homographies.size() << " homographies"
+             << (publishAddress.empty() ? "" : ", republishing to "+publishAddress) );
+
+    map<int, TrackAggregator::CameraStats> before;
+    while(true){
+        this_thread::sleep_for(chrono::seconds(AGGREGATOR_LOG_SECONDS));
+        map<int, TrackAggregator::CameraStats> stats=aggregator.getStats();
+        for(const auto &camera : stats){
+            const TrackAggregator::CameraStats &now=camera.second, &then=before[camera.first];
+            CI_LOG_I( "camera " << camera.first << ": " << (now.frames-then.frames)/(double)AGGREGATOR_LOG_SECONDS << " frames/s, "
+                     << (now.packets-then.packets)/(double)AGGREGATOR_LOG_SECONDS << " packets/s, "
+                     << (now.bytes-then.bytes)/1024.0/AGGREGATOR_LOG_SECONDS << " KB/s, "
+                     << now.lost-then.lost << " lost, " << now.restarts-then.restarts << " restarts, " << now.features << " features" );
+        }
+        CI_LOG_I( aggregator.getTracks() << " tracks, " << aggregator.getHandOffs() << " handed on" );
+        before=stats;
+    }
+}
@@ -0,0 +1,158 @@
+//
+//  TrackStream.hpp
+//  Project2
+//
+//  Tracks from several hosts merged into one picture. Each instance of the app (one camera each)
+//  sends every tracked frame as compact UDP packets to an aggregator; the aggregator maps them
+//  through a homography per camera into one world coordinate frame and republishes the merged
+//  set at STREAM_PUBLISH_RATE. A camera that has sent no complete frame for STREAM_STALE_SECONDS
+//  drops out of the merged set.
+//
+//      Project2 --send host:port camera                    this instance streams to an aggregator
+//      Project2 --aggregate port homographies.txt [host:port]
+//                                                          runs an aggregator until killed, optionally
+//                                                          republishing the merged stream
+//
+//  Camera packets ("TRK2") hold a frame's status-ok features -- id, position and motion in 1/8
+//  pixel steps, 10 bytes each -- and, in the first packet, the fired grid cells as a bitmask. A
+//  frame that doesn't fit in STREAM_MAX_PACKET bytes goes out as several packets, and a sequence
+//  number per frame lets the aggregator count what went missing. Each sender also picks a random
+//  session id when it starts: a sender that restarts begins its sequence again at 0, and the new
+//  session tells the aggregator to start counting over rather than take its frames for late ones.
+//  A feature's id is its index since the features were last detected (epoch); ids start over with
+//  each epoch. A sender with a lens (Lens.hpp) sends its features undistorted, and its fired cells
+//  as entries with id STREAM_CELL_ID at their undistorted centres in place of the bitmask, so both
+//  are in the space its homography is for. With --send-field the flow field (FlowField.hpp) goes
+//  too, after the features: an entry with id STREAM_FIELD_ID for each cell that moves at least one
+//  wire step, at the cell's centre (undistorted with a lens) with the cell's vector as its motion.
+//
+//  The aggregator maps features onto the ground plane through a LUT per camera and gives each
+//  track a global id that is kept when it moves from one camera to another (GroundPlane.hpp).
+//  World packets ("WRL2") hold camera (16 bits, as in the camera packets), id, global track id,
+//  world position and world motion per entry, the last four as floats, 24 bytes each, split the
+//  same way. Fired grid cells come
+//  through as entries with id STREAM_CELL_ID and track -1 at the cell's world centre, flow field
+//  cells as entries with id STREAM_FIELD_ID and track -1 with their world motion. Everything on the
+//  wire is little-endian.
+//
+//  Homography files have one camera per line: the camera number, then the 3x3 matrix row by row
+//  (frame pixels -> ground plane; undistorted frame pixels for a camera sending with --lens). Lines
+//  starting with # are skipped.
+//
+
+#ifndef TrackStream_hpp
+#define TrackStream_hpp
+
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "FeatureTracker.hpp"
+#include "GroundPlane.hpp"
+
+#define STREAM_PORT 7400 //default aggregator port
+#define STREAM_MAX_PACKET 1400 //bytes of payload, so a packet fits an ethernet frame without fragmenting
+#define STREAM_PUBLISH_RATE 30 //merged world packets per second
+#define STREAM_FIXED_POINT 8.0f //camera packets carry pixels in 1/8 steps
+#define STREAM_STALE_SECONDS HANDOFF_STALE //a camera's last frame leaves the merged set when nothing newer completes for this long, and its tracks leave the hand-off
+
+//one camera's frames out to an aggregator. send() never blocks: a full socket buffer drops the packet
+class TrackSender {
+public:
+    TrackSender(const std::string &address, int camera, bool field = false); //address is host:port. field sends the flow field too
+    ~TrackSender();
+
+    bool isOpen() const { return mSocket >= 0; }
+    void send(const TrackResult &result);
+
+    int getCamera() const { return mCamera; }
+    long long getFrames() const { return mFrames; }
+    long long getPackets() const { return mPackets; }
+    long long getBytes() const { return mBytes; }
+    long long getDropped() const { return mDropped; } //packets the socket wouldn't take
+
+private:
+    int                         mSocket;
+    std::vector<uint8_t>        mAddress; //sockaddr_in, kept opaque so this header needs no socket headers
+    int                         mCamera;
+    std::vector<uint8_t>        mPacket; //packet being filled, reused
+    std::vector<int>            mSend; //indices of the status-ok features, reused
+    std::vector<cv::Point2f>    mCells; //with a lens, the fired cells' undistorted centres, sent ahead of the features
+    bool                        mField;
+    std::vector<cv::Point2f>    mFieldAt, mFieldMotion; //the field cells that move, sent after the features
+    uint32_t                    mSession; //random, so the aggregator can tell a restarted sender from a late packet
+    uint32_t                    mSequence; //frames sent
+    std::atomic<long long>      mFrames, mPackets, mBytes, mDropped;
+};
+
+//receives camera packets, maps them into the world and republishes the merged set
+class TrackAggregator {
+public:
+    struct CameraStats {
+        long long   frames = 0; //complete frames received
+        long long   lost = 0; //frames missing or incomplete (sequence gaps, missing packets)
+        long long   restarts = 0; //new sender sessions after the first
+        long long   packets = 0;
+        long long   bytes = 0;
+        int         lastFrame = -1; //the sender's frame number
+        long long   lastSequence = -1;
+        int         epoch = -1;
+        int         features = 0; //in the last complete frame
+    };
+
+    //publishAddress (host:port) may be empty to only merge. cameras without a homography are left in frame pixels
+    TrackAggregator(int port, const std::map<int, Homography> &homographies, const std::string &publishAddress = "");
+    ~TrackAggregator(); //calls stop()
+
+    bool isOpen() const { return mSocket >= 0; }
+    void stop();
+
+    std::map<int, CameraStats> getStats() const;
+    void snapshot(std::vector<WorldFeature> &features) const; //the latest complete frame of every camera that isn't stale
+    long long getPublished() const { return mPublished; } //world packets sent
+    long long getHandOffs() const; //new tracks that kept an existing global id
+    long long getTracks() const; //global ids given out
+
+private:
+    struct Camera {
+        CameraStats                 stats;
+        bool                        started = false; //session is set
+        uint32_t                    session = 0;
+        long long                   assembling = -1; //sequence of the frame whose packets are arriving
+        int                         partsSeen = 0, parts = 0;
+        std::bitset<256>            partsReceived; //of the frame being assembled, so a duplicate isn't counted twice
+        std::vector<WorldFeature>   partial, latest; //features and fired cells, in the world
+        GroundLut                   lut; //rebuilt when the frame size changes
+        std::chrono::steady_clock::time_point completed; //when the last frame completed
+        double                      frameSeconds = 1/30.0; //smoothed time between complete frames
+    };
+
+    void receiveLoop();
+    void publishLoop();
+    void receive(const uint8_t *data, size_t size);
+
+    int                             mSocket, mPublishSocket;
+    std::vector<uint8_t>            mPublishAddress;
+    std::map<int, Homography>       mHomographies;
+
+    mutable std::mutex              mMutex; //guards mCameras, mHandOff
+    std::map<int, Camera>           mCameras;
+    TrackHandOff                    mHandOff;
+    std::chrono::steady_clock::time_point mStarted;
+
+    std::atomic<bool>               mStopping;
+    std::atomic<long long>          mPublished;
+    std::thread                     mReceiver, mPublisher;
+};
+
+//--aggregate: runs an aggregator until the process is killed, logging per-camera stats every few seconds
+bool runAggregator(int port, const std::string &homographyPath, const std::string &publishAddress);
+
+#endif /* TrackStream_hpp */
@@ -0,0 +1,45 @@
+//
+//  TripleBuffer.hpp
+//  Project2
+//
+//  Hands the latest value from one writer thread to one reader thread without either ever
+//  waiting. There are three slots: the writer fills its back slot and swaps it into the middle,
+//  the reader swaps the middle out to its front slot when something new is there. Each side only
+//  touches its own slot, so the tracker can publish at camera rate while draw() reads at display
+//  rate, and neither holds up the other.
+//
+
+#ifndef TripleBuffer_hpp
+#define TripleBuffer_hpp
+
+#include <atomic>
+
+template<class T>
+class TripleBuffer {
+public:
+    TripleBuffer() : mBack(0), mMiddle(1), mFront(2) {}
+
+    //writer side
+    T &back() { return mSlots[mBack]; }
+    void publish() { mBack=mMiddle.exchange(mBack | NEW) & SLOT; } //whatever was in the middle is ours to overwrite
+
+    //reader side. returns true if front() changed
+    bool update()
+    {
+        if(!(mMiddle.load() & NEW))
+            return false;
+        mFront=mMiddle.exchange(mFront) & SLOT;
+        return true;
+    }
+    const T &front() const { return mSlots[mFront]; }
+
+private:
+    enum { SLOT = 3, NEW = 4 }; //middle holds a slot index plus a flag for "not read yet"
+
+    T                   mSlots[3];
+    int                 mBack; //only the writer
+    std::atomic<int>    mMiddle;
+    int                 mFront; //only the reader
+};
+
+#endif /* TripleBuffer_hpp */